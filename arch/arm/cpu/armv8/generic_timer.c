@@ -7,6 +7,10 @@
 
 #include <common.h>
 #include <command.h>
+#include <errno.h>
+#include <profile.h>
+#include <asm/gic.h>
+#include <asm/io.h>
 #include <asm/system.h>
 
 /*
@@ -29,3 +33,112 @@ unsigned long timer_read_counter(void)
 	asm volatile("mrs %0, cntpct_el0" : "=r" (cntpct));
 	return cntpct;
 }
+
+#ifdef CONFIG_SAMPLE_PROFILE
+/* Non-secure EL1 physical timer interrupt, a PPI */
+#define PROFILE_TIMER_IRQ	30
+
+#define HCR_EL2_IMO		(1 << 4)
+#define SCR_EL3_IRQ		(1 << 1)
+
+static unsigned long profile_tval;
+static unsigned long profile_route;	/* routing bit we had to set */
+
+static void profile_timer_arm(void)
+{
+	asm volatile("msr cntp_tval_el0, %0" : : "r" (profile_tval));
+	/* ENABLE, interrupt not masked */
+	asm volatile("msr cntp_ctl_el0, %0" : : "r" (1UL));
+	isb();
+}
+
+/*
+ * Sample from the EL1 physical timer, which can be used at any EL. Its
+ * interrupt has to be taken to the EL we run at rather than to EL1.
+ */
+int profile_timer_start(unsigned int hz)
+{
+	unsigned long val;
+	u32 prio;
+
+	profile_tval = get_tbclk() / hz;
+	if (!profile_tval)
+		return -EINVAL;
+
+	profile_route = 0;
+	if (current_el() == 3) {
+		asm volatile("mrs %0, scr_el3" : "=r" (val));
+		if (!(val & SCR_EL3_IRQ)) {
+			profile_route = SCR_EL3_IRQ;
+			asm volatile("msr scr_el3, %0" : : "r"
+				     (val | SCR_EL3_IRQ));
+		}
+	} else if (current_el() == 2) {
+		asm volatile("mrs %0, hcr_el2" : "=r" (val));
+		if (!(val & HCR_EL2_IMO)) {
+			profile_route = HCR_EL2_IMO;
+			asm volatile("msr hcr_el2, %0" : : "r"
+				     (val | HCR_EL2_IMO));
+		}
+	}
+	isb();
+
+	/* Lowest priority that still gets past the priority mask */
+	prio = readl(GICD_BASE + GICD_IPRIORITYRn + (PROFILE_TIMER_IRQ & ~3));
+	prio &= ~(0xff << (PROFILE_TIMER_IRQ & 3) * 8);
+	prio |= 0xa0 << (PROFILE_TIMER_IRQ & 3) * 8;
+	writel(prio, GICD_BASE + GICD_IPRIORITYRn + (PROFILE_TIMER_IRQ & ~3));
+	writel(1 << PROFILE_TIMER_IRQ, GICD_BASE + GICD_ISENABLERn);
+	writel(0xf0, GICC_BASE + GICC_PMR);
+	writel(readl(GICC_BASE + GICC_CTLR) | 1, GICC_BASE + GICC_CTLR);
+
+	profile_timer_arm();
+	asm volatile("msr daifclr, #2" : : : "memory");
+
+	return 0;
+}
+
+void profile_timer_stop(void)
+{
+	unsigned long val;
+
+	asm volatile("msr daifset, #2" : : : "memory");
+	asm volatile("msr cntp_ctl_el0, %0" : : "r" (0UL));
+	writel(1 << PROFILE_TIMER_IRQ, GICD_BASE + GICD_ICENABLERn);
+
+	if (profile_route == SCR_EL3_IRQ) {
+		asm volatile("mrs %0, scr_el3" : "=r" (val));
+		asm volatile("msr scr_el3, %0" : : "r" (val & ~SCR_EL3_IRQ));
+	} else if (profile_route == HCR_EL2_IMO) {
+		asm volatile("mrs %0, hcr_el2" : "=r" (val));
+		asm volatile("msr hcr_el2, %0" : : "r" (val & ~HCR_EL2_IMO));
+	}
+	profile_route = 0;
+	isb();
+}
+
+/*
+ * Handle the interrupt if it is ours, returning 0. The timer is armed
+ * again from here, so the period does not include the time spent
+ * handling it.
+ */
+int profile_timer_irq(struct pt_regs *regs)
+{
+	u32 iar, irq;
+
+	iar = readl(GICC_BASE + GICC_IAR);
+	irq = iar & 0x3ff;
+	if (irq == 1023)
+		return 0;		/* spurious, nothing to do */
+	if (irq != PROFILE_TIMER_IRQ) {
+		writel(iar, GICC_BASE + GICC_EOIR);
+		return -ENOENT;
+	}
+
+	profile_sample(regs->elr, regs->regs[29], (ulong)(regs + 1));
+	profile_timer_arm();
+	writel(iar, GICC_BASE + GICC_EOIR);
+
+	return 0;
+}
+#endif
@@ -49,6 +49,10 @@
 /* Generic Timer Definitions */
 #define COUNTER_FREQUENCY		(0x1800000)	/* 24MHz */
 
+/* GIC-400 */
+#define GICD_BASE			(0xffc01000)
+#define GICC_BASE			(0xffc02000)
+
 /* support early init */
 #define CONFIG_BOARD_EARLY_INIT_F
 /* support board late init */
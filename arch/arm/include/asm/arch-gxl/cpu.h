@@ -49,6 +49,10 @@
 /* Generic Timer Definitions */
 #define COUNTER_FREQUENCY		(0x1800000)	/* 24MHz */
 
+/* GIC-400 */
+#define GICD_BASE			(0xc4301000)
+#define GICC_BASE			(0xc4302000)
+
 /* support board late init */
 #define CONFIG_BOARD_LATE_INIT
 /* use "hush" command parser */
@@ -84,6 +84,7 @@ static void announce_and_cleanup(int fake)
 #ifdef CONFIG_USB_DEVICE
 	udc_disconnect();
 #endif
+	console_flush();
 	cleanup_before_linux();
 }
 
@@ -279,6 +280,7 @@ static void boot_jump_linux(bootm_headers_t *images, int flag)
 		do_nonsec_virt_switch();
 		gd->flags &= ~GD_FLG_SILENT;
 		printf("uboot time: %u us\n", get_time());
+		console_flush();
 		kernel_entry(images->ft_addr, NULL, NULL, NULL);
 	}
 #else
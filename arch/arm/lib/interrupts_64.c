@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <profile.h>
 #include <linux/compiler.h>
 
 
@@ -91,6 +92,10 @@ void do_sync(struct pt_regs *pt_regs, unsigned int esr)
  */
 void do_irq(struct pt_regs *pt_regs, unsigned int esr)
 {
+#ifdef CONFIG_SAMPLE_PROFILE
+	if (!profile_timer_irq(pt_regs))
+		return;
+#endif
 	printf("\"Irq\" handler, esr 0x%08x\n", esr);
 	show_regs(pt_regs);
 	panic("Resetting CPU ...\n");
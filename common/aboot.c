@@ -37,6 +37,7 @@
 #include <config.h>
 #include <common.h>
 #include <aboot.h>
+#include <fb_command.h>
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
@@ -151,6 +152,7 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 			bytes_written += blkcnt * info->blksz;
 			total_blocks += chunk_header->chunk_sz;
 			data += chunk_data_sz;
+			fb_progress("writing");
 			break;
 
 			case CHUNK_TYPE_FILL:
@@ -205,6 +207,7 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 			total_blocks += chunk_data_sz / sparse_header->blk_sz;
 
 			free(fill_buf);
+			fb_progress("writing");
 			break;
 
 			case CHUNK_TYPE_DONT_CARE:
@@ -2,6 +2,7 @@
 #include <bootm.h>
 #include <command.h>
 #include <image.h>
+#include <libfdt.h>
 #include <malloc.h>
 #include <asm/arch/io.h>
 #include <asm/arch/secure_apb.h>
@@ -59,6 +60,38 @@ int is_dtb_encrypt(unsigned char *buffer)
 #endif//#if 0
 }
 
+/*
+ * The names in a multi-dtb header entry are padded with spaces, or ended
+ * by a 0, and stored as big-endian words. Returns true if a name matches.
+ */
+static int aml_dt_match_id(unsigned long addr, unsigned int length,
+	const char *token)
+{
+	unsigned int len = strlen(token);
+	unsigned int y;
+	unsigned char c;
+
+	if (len > length)
+		return 0;
+	for (y = 0; y < length; y++) {
+		c = readl(addr + (y & ~3)) >> (24 - 8 * (y & 3));
+		if (y == len)
+			return c == ' ' || c == '\0';
+		if (c != (unsigned char)token[y])
+			return 0;
+	}
+	return 1;
+}
+
+/* Bytes of a dtb to copy out of the GZIP buffer */
+static unsigned long aml_dt_size(unsigned long addr)
+{
+	if (!fdt_check_header((void *)addr) &&
+		fdt_totalsize((void *)addr) < DTB_MAX_SIZE)
+		return fdt_totalsize((void *)addr);
+	return DTB_MAX_SIZE;
+}
+
 unsigned long __attribute__((unused))
 	get_multi_dt_entry(unsigned long fdt_addr){
 	unsigned int dt_magic = readl(fdt_addr);
@@ -75,7 +108,6 @@ unsigned long __attribute__((unused))
 	if (gzip_format) {
 		printf("      GZIP format, decompress...\n");
 		gzip_buf = malloc(GUNZIP_BUF_SIZE);
-		memset(gzip_buf, 0, GUNZIP_BUF_SIZE);
 		unsigned long unzip_size = GUNZIP_BUF_SIZE;
 		gunzip(gzip_buf, GUNZIP_BUF_SIZE, (void *)fdt_addr, &unzip_size);
 		dbg_printf("      DBG: unzip_size: 0x%x\n", (unsigned int)unzip_size);
@@ -94,7 +126,8 @@ unsigned long __attribute__((unused))
 	if (dt_magic == DT_HEADER_MAGIC) {/*normal dtb*/
 		printf("      Single dtb detected\n");
 		if (gzip_format) {
-			memcpy((void *)dt_entry, (void *)fdt_addr, DTB_MAX_SIZE);
+			memcpy((void *)dt_entry, (void *)fdt_addr,
+				aml_dt_size(fdt_addr));
 			fdt_addr = dt_entry;
 			if (gzip_buf)
 				free(gzip_buf);
@@ -105,9 +138,8 @@ unsigned long __attribute__((unused))
 		printf("      Multi dtb detected\n");
 		/* check and set aml_dt */
 		int i = 0;
-		char *aml_dt_buf;
-		aml_dt_buf = (char *)malloc(sizeof(char)*64);
-		memset(aml_dt_buf, 0, sizeof(aml_dt_buf));
+		char aml_dt_buf[64] = {0};
+		char *aml_dt_ptr = aml_dt_buf;
 
 		/* update 2016.07.27, checkhw and setenv everytime,
 		or else aml_dt will set only once if it is reserved */
@@ -122,11 +154,9 @@ unsigned long __attribute__((unused))
 			memcpy(aml_dt_buf, aml_dt, (strlen(aml_dt)>64?64:(strlen(aml_dt)+1)));
 #endif
 
-		unsigned int aml_dt_len = aml_dt_buf ? strlen(aml_dt_buf) : 0;
+		unsigned int aml_dt_len = strlen(aml_dt_buf);
 		if (aml_dt_len <= 0) {
 			printf("      Get env aml_dt failed!\n");
-			if (aml_dt_buf)
-				free(aml_dt_buf);
 			return fdt_addr;
 		}
 
@@ -151,67 +181,33 @@ unsigned long __attribute__((unused))
 		/* split aml_dt to 3 strings */
 		char *tokens[3] = {NULL, NULL, NULL};
 		for (i = 0; i < AML_DT_ID_VARI_TOTAL; i++) {
-			tokens[i] = strsep(&aml_dt_buf, "_");
+			tokens[i] = strsep(&aml_dt_ptr, "_");
+			if (!tokens[i])
+				tokens[i] = "";
 		}
-		if (aml_dt_buf)
-			free(aml_dt_buf);
 		printf("        aml_dt soc: %s platform: %s variant: %s\n", tokens[0], tokens[1], tokens[2]);
 
-		/*match and print result*/
-		char **dt_info;
-		dt_info = (char **)malloc(sizeof(char *)*AML_DT_ID_VARI_TOTAL);
-		for (i = 0; i < AML_DT_ID_VARI_TOTAL; i++)
-			dt_info[i] = (char *)malloc(sizeof(char)*aml_each_id_length);
+		/*
+		 * Entries are at fixed offsets in the header, so compare each
+		 * one in place. The last match is used, so start at the end.
+		 */
 		unsigned int dtb_match_num = 0xffff;
-		unsigned int x = 0, y = 0, z = 0; //loop counter
-		unsigned int read_data;
-		for (i = 0; i < dt_total; i++) {
+		unsigned int x = 0;
+		unsigned long entry;
+		for (i = dt_total - 1; i >= 0; i--) {
+			entry = fdt_addr + AML_DT_FIRST_DTB_OFFSET +
+				i * aml_dtb_header_size + AML_DT_DTB_DT_INFO_OFFSET;
 			for (x = 0; x < AML_DT_ID_VARI_TOTAL; x++) {
-				for (y = 0; y < aml_each_id_length; y+=4) {
-					read_data = readl(fdt_addr + AML_DT_FIRST_DTB_OFFSET + \
-						 i * aml_dtb_header_size + AML_DT_DTB_DT_INFO_OFFSET + \
-						 (x * aml_each_id_length) + y);
-					dt_info[x][y+0] = (read_data >> 24) & 0xff;
-					dt_info[x][y+1] = (read_data >> 16) & 0xff;
-					dt_info[x][y+2] = (read_data >> 8) & 0xff;
-					dt_info[x][y+3] = (read_data >> 0) & 0xff;
-				}
-				for (z=0; z<aml_each_id_length; z++) {
-					/*fix string with \0*/
-					if (0x20 == (uint)dt_info[x][z]) {
-						dt_info[x][z] = '\0';
-					}
-				}
-				//printf("dt_info[x]: %s\n", dt_info[x]);
-				//printf("strlen(dt_info[x]): %d\n", strlen(dt_info[x]));
-			}
-			if (dt_tool_version == 1)
-				printf("        dtb %d soc: %.4s   plat: %.4s   vari: %.4s\n", i, (char *)(dt_info[0]), (char *)(dt_info[1]), (char *)(dt_info[2]));
-			else if(dt_tool_version == 2)
-				printf("        dtb %d soc: %.16s   plat: %.16s   vari: %.16s\n", i, (char *)(dt_info[0]), (char *)(dt_info[1]), (char *)(dt_info[2]));
-			uint match_str_counter = 0;
-			for (z=0; z<AML_DT_ID_VARI_TOTAL; z++) {
 				/*must match 3 strings*/
-				if (!strncmp(tokens[z], (char *)(dt_info[z]), strlen(tokens[z])) && \
-					(strlen(tokens[z]) == strlen(dt_info[z])))
-					match_str_counter++;
+				if (!aml_dt_match_id(entry + x * aml_each_id_length,
+					aml_each_id_length, tokens[x]))
+					break;
 			}
-			if (match_str_counter == AML_DT_ID_VARI_TOTAL) {
-				//printf("Find match dtb\n");
+			if (x == AML_DT_ID_VARI_TOTAL) {
 				dtb_match_num = i;
+				break;
 			}
-			for (z=0; z<AML_DT_ID_VARI_TOTAL; z++) {
-				/*clear data for next loop*/
-				memset(dt_info[z], 0, sizeof(aml_each_id_length));
-			}
-		}
-		/*clean malloc memory*/
-		for (i = 0; i < AML_DT_ID_VARI_TOTAL; i++) {
-			if (dt_info[i])
-				free(dt_info[i]);
 		}
-		if (dt_info)
-			free(dt_info);
 
 		/*if find match dtb, return address, or else return main entrance address*/
 		if (0xffff != dtb_match_num) {
@@ -220,7 +216,8 @@ unsigned long __attribute__((unused))
 			fdt_addr = (fdt_addr + readl(fdt_addr + AML_DT_FIRST_DTB_OFFSET + \
 				dtb_match_num * aml_dtb_header_size + aml_dtb_offset_offset));
 			if (gzip_format) {
-				memcpy((void *)dt_entry, (void *)fdt_addr, DTB_MAX_SIZE);
+				memcpy((void *)dt_entry, (void *)fdt_addr,
+					aml_dt_size(fdt_addr));
 				fdt_addr = dt_entry;
 				if (gzip_buf)
 					free(gzip_buf);
@@ -16,6 +16,7 @@
 #include <environment.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fs.h>
 #if defined(CONFIG_CMD_IDE)
 #include <ide.h>
@@ -801,6 +802,16 @@ static int initf_malloc(void)
 	return 0;
 }
 
+#if defined(CONFIG_OF_CONTROL) && defined(CONFIG_FDT_INDEX)
+static int initf_fdt_index(void)
+{
+	/* Not fatal, lookups just walk the tree */
+	fdt_index_build(gd->fdt_blob);
+
+	return 0;
+}
+#endif
+
 static int initf_dm(void)
 {
 #if defined(CONFIG_DM) && defined(CONFIG_SYS_MALLOC_F_LEN)
@@ -832,6 +843,9 @@ static init_fnc_t init_sequence_f[] = {
 	mark_bootstage,
 #ifdef CONFIG_OF_CONTROL
 	fdtdec_check_fdt,
+#ifdef CONFIG_FDT_INDEX
+	initf_fdt_index,
+#endif
 #endif
 	initf_dm,
 #if defined(CONFIG_BOARD_EARLY_INIT_F)
@@ -21,6 +21,7 @@
 #include <dm.h>
 #include <environment.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #if defined(CONFIG_CMD_IDE)
 #include <ide.h>
 #endif
@@ -39,6 +40,7 @@
 #include <mmc.h>
 #include <nand.h>
 #include <onenand_uboot.h>
+#include <profile.h>
 #include <scsi.h>
 #include <serial.h>
 #include <spi.h>
@@ -97,6 +99,17 @@ static int initr_trace(void)
 	return 0;
 }
 
+#ifdef CONFIG_SAMPLE_PROFILE_BOOT
+static int initr_profile(void)
+{
+	/* Not fatal, the board still boots */
+	if (profile_start(CONFIG_SAMPLE_PROFILE_HZ, PROFILE_MAX_DEPTH))
+		printf("Cannot start profiling\n");
+
+	return 0;
+}
+#endif
+
 static int initr_reloc(void)
 {
 	/* tell others: relocation done */
@@ -265,6 +278,16 @@ static int initr_malloc(void)
 	return 0;
 }
 
+#if defined(CONFIG_OF_CONTROL) && defined(CONFIG_FDT_INDEX)
+static int initr_fdt_index(void)
+{
+	/* The device tree has moved, and early memory is gone */
+	fdt_index_build(gd->fdt_blob);
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_SYS_NONCACHED_MEMORY
 static int initr_noncached(void)
 {
@@ -695,11 +718,17 @@ init_fnc_t init_sequence_r[] = {
 #endif
 	initr_barrier,
 	initr_malloc,
+#if defined(CONFIG_OF_CONTROL) && defined(CONFIG_FDT_INDEX)
+	initr_fdt_index,
+#endif
 	console_init_m,
 #ifdef CONFIG_SYS_NONCACHED_MEMORY
 	initr_noncached,
 #endif
 	bootstage_relocate,
+#ifdef CONFIG_SAMPLE_PROFILE_BOOT
+	initr_profile,
+#endif
 #ifdef CONFIG_DM
 	initr_dm,
 #endif
@@ -873,6 +902,9 @@ init_fnc_t init_sequence_r[] = {
 #endif
 #ifdef CONFIG_PS2KBD
 	initr_kbd,
+#endif
+#ifdef CONFIG_INITCALL_ASYNC
+	initcall_async_wait_all,
 #endif
 	run_main_loop,
 };
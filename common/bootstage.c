@@ -25,24 +25,17 @@ struct bootstage_record {
 	const char *name;
 	int flags;		/* see enum bootstage_flags */
 	enum bootstage_id id;
+	const char *group;	/* Subsystem of a span, or NULL */
+	ulong addr;		/* Code address, shown if there is no name */
 };
 
 static struct bootstage_record record[BOOTSTAGE_ID_COUNT] = { {1} };
 static int next_id = BOOTSTAGE_ID_USER;
 
 enum {
-	BOOTSTAGE_VERSION	= 0,
-	BOOTSTAGE_MAGIC		= 0xb00757a3,
 	BOOTSTAGE_DIGITS	= 9,
 };
 
-struct bootstage_hdr {
-	uint32_t version;	/* BOOTSTAGE_VERSION */
-	uint32_t count;		/* Number of records */
-	uint32_t size;		/* Total data size (non-zero if valid) */
-	uint32_t magic;		/* Unused */
-};
-
 int bootstage_relocate(void)
 {
 	int i;
@@ -51,9 +44,12 @@ int bootstage_relocate(void)
 	 * Duplicate all strings.  They may point to an old location in the
 	 * program .text section that can eventually get trashed.
 	 */
-	for (i = 0; i < BOOTSTAGE_ID_COUNT; i++)
+	for (i = 0; i < BOOTSTAGE_ID_COUNT; i++) {
 		if (record[i].name)
 			record[i].name = strdup(record[i].name);
+		if (record[i].group)
+			record[i].group = strdup(record[i].group);
+	}
 
 	return 0;
 }
@@ -150,6 +146,46 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+uint32_t bootstage_accum_time(enum bootstage_id id, const char *name,
+			      uint32_t duration)
+{
+	struct bootstage_record *rec = &record[id];
+
+	/* A start time is what makes this an accumulator */
+	if (!rec->start_us)
+		rec->start_us = timer_get_boot_us();
+	rec->name = name;
+	rec->time_us += duration;
+
+	return rec->time_us;
+}
+
+#ifdef CONFIG_BOOTSTAGE_SPAN
+void bootstage_span(const char *group, const char *name, ulong addr,
+		    ulong start)
+{
+	struct bootstage_record *rec;
+	int id = next_id++;
+
+	if (id >= BOOTSTAGE_ID_COUNT)
+		return;
+
+	rec = &record[id];
+	rec->time_us = timer_get_boot_us();
+	rec->start_us = start;
+	rec->name = name;
+	rec->flags = BOOTSTAGEF_SPAN;
+	rec->id = id;
+	rec->group = group;
+	rec->addr = addr;
+}
+#endif
+
+static int is_span(const struct bootstage_record *rec)
+{
+	return (rec->flags & BOOTSTAGEF_SPAN) != 0;
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -161,9 +197,22 @@ uint32_t bootstage_accum(enum bootstage_id id)
 static const char *get_record_name(char *buf, int len,
 				   struct bootstage_record *rec)
 {
+#ifdef CONFIG_KALLSYMS
+	ulong caddr;
+	const char *sym;
+#endif
+
 	if (rec->name)
 		return rec->name;
-	else if (rec->id >= BOOTSTAGE_ID_USER)
+
+	if (rec->addr) {
+#ifdef CONFIG_KALLSYMS
+		sym = symbol_lookup(rec->addr, &caddr);
+		if (sym && caddr == rec->addr)
+			return sym;
+#endif
+		snprintf(buf, len, "%#lx", rec->addr);
+	} else if (rec->id >= BOOTSTAGE_ID_USER)
 		snprintf(buf, len, "user_%d", rec->id - BOOTSTAGE_ID_USER);
 	else
 		snprintf(buf, len, "id=%d", rec->id);
@@ -240,9 +289,21 @@ static int add_bootstages_devicetree(struct fdt_header *blob)
 				get_record_name(buf, sizeof(buf), rec)))
 			return -1;
 
+		/* A span has a start and group besides its (end) mark */
+		if (is_span(rec)) {
+			if (fdt_setprop_cell(blob, node, "start",
+					     rec->start_us))
+				return -1;
+			if (rec->group && fdt_setprop_string(blob, node,
+							     "group",
+							     rec->group))
+				return -1;
+		}
+
 		/* Check if this is a 'mark' or 'accum' record */
 		if (fdt_setprop_cell(blob, node,
-				rec->start_us ? "accum" : "mark",
+				rec->start_us && !is_span(rec) ?
+				"accum" : "mark",
 				rec->time_us))
 			return -1;
 	}
@@ -259,6 +320,53 @@ int bootstage_fdt_add_report(void)
 }
 #endif
 
+static int same_group(const char *g1, const char *g2)
+{
+	return g1 == g2 || (g1 && g2 && !strcmp(g1, g2));
+}
+
+/* Print the total time of the spans of each subsystem */
+static void print_span_groups(void)
+{
+	struct bootstage_record *rec, *other;
+	ulong total;
+	int id, count;
+
+	for (id = 0, rec = record; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (is_span(rec))
+			break;
+	}
+	if (id == BOOTSTAGE_ID_COUNT)
+		return;
+
+	puts("\nTime per subsystem (spans may nest):\n");
+	printf("%11s%11s  %s\n", "Time", "Count", "Subsystem");
+	for (; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (!is_span(rec))
+			continue;
+
+		/* Add up the group at its first span only */
+		for (other = record; other < rec; other++) {
+			if (is_span(other) &&
+			    same_group(rec->group, other->group))
+				break;
+		}
+		if (other < rec)
+			continue;
+
+		for (total = count = 0; other < record + BOOTSTAGE_ID_COUNT;
+		     other++) {
+			if (is_span(other) &&
+			    same_group(rec->group, other->group)) {
+				total += other->time_us - other->start_us;
+				count++;
+			}
+		}
+		print_grouped_ull(total, BOOTSTAGE_DIGITS);
+		printf("%11d  %s\n", count, rec->group ? rec->group : "-");
+	}
+}
+
 void bootstage_report(void)
 {
 	struct bootstage_record *rec = record;
@@ -277,7 +385,7 @@ void bootstage_report(void)
 	qsort(record, ARRAY_SIZE(record), sizeof(*rec), h_compare_record);
 
 	for (id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
-		if (rec->time_us != 0 && !rec->start_us)
+		if (rec->time_us != 0 && !rec->start_us && !is_span(rec))
 			prev = print_time_record(rec->id, rec, prev);
 	}
 	if (next_id > BOOTSTAGE_ID_COUNT)
@@ -287,9 +395,11 @@ void bootstage_report(void)
 
 	puts("\nAccumulated time:\n");
 	for (id = 0, rec = record; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
-		if (rec->start_us)
+		if (rec->start_us && !is_span(rec))
 			prev = print_time_record(id, rec, -1);
 	}
+
+	print_span_groups();
 }
 
 ulong __timer_get_boot_us(void)
@@ -334,6 +444,7 @@ static void append_data(char **ptrp, char *end, const void *data, int size)
 int bootstage_stash(void *base, int size)
 {
 	struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
+	struct bootstage_stash_rec srec;
 	struct bootstage_record *rec;
 	char buf[20];
 	char *ptr = base, *end = ptr + size;
@@ -361,17 +472,26 @@ int bootstage_stash(void *base, int size)
 
 	/* Write the records, silently stopping when we run out of space */
 	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
-		if (rec->time_us != 0)
-			append_data(&ptr, end, rec, sizeof(*rec));
+		if (rec->time_us == 0)
+			continue;
+
+		srec.time_us = rec->time_us;
+		srec.start_us = rec->start_us;
+		srec.flags = rec->flags;
+		srec.id = rec->id;
+		srec.addr = rec->addr;
+		append_data(&ptr, end, &srec, sizeof(srec));
 	}
 
-	/* Write the name strings */
+	/* Write the name and group strings */
 	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
 		if (rec->time_us != 0) {
 			const char *name;
 
 			name = get_record_name(buf, sizeof(buf), rec);
 			append_data(&ptr, end, name, strlen(name) + 1);
+			name = rec->group ? rec->group : "";
+			append_data(&ptr, end, name, strlen(name) + 1);
 		}
 	}
 
@@ -388,13 +508,17 @@ int bootstage_stash(void *base, int size)
 	return 0;
 }
 
-int bootstage_unstash(void *base, int size)
+/**
+ * Check that there is valid stashed bootstage data in a buffer
+ *
+ * @param base	Base address of memory buffer
+ * @param size	Size of memory buffer (-1 if unknown)
+ * @return 0 if ok, -1 if bootstage info not found
+ */
+static int check_stash(const void *base, int size)
 {
-	struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
-	struct bootstage_record *rec;
-	char *ptr = base, *end = ptr + size;
-	uint rec_size;
-	int id;
+	const struct bootstage_hdr *hdr = base;
+	const char *ptr = base, *end = ptr + size;
 
 	if (size == -1)
 		end = (char *)(~(uintptr_t)0);
@@ -414,10 +538,11 @@ int bootstage_unstash(void *base, int size)
 		return -1;
 	}
 
-	if (hdr->count * sizeof(*rec) > hdr->size) {
+	if (hdr->count * sizeof(struct bootstage_stash_rec) > hdr->size) {
 		debug("%s: Bootstage has %d records needing %lu bytes, but "
 			"only %d bytes is available\n", __func__, hdr->count,
-		      (ulong)hdr->count * sizeof(*rec), hdr->size);
+		      (ulong)hdr->count * sizeof(struct bootstage_stash_rec),
+		      hdr->size);
 		return -1;
 	}
 
@@ -427,6 +552,48 @@ int bootstage_unstash(void *base, int size)
 		return -1;
 	}
 
+	return 0;
+}
+
+/**
+ * Read a stashed record
+ *
+ * @param rec	Record to fill in
+ * @param srecp	Pointer to the stashed record, updated to the next one
+ * @param strp	Pointer to its name and group, updated to the next ones
+ */
+static void read_stash_record(struct bootstage_record *rec,
+			      const struct bootstage_stash_rec **srecp,
+			      const char **strp)
+{
+	const struct bootstage_stash_rec *srec = (*srecp)++;
+	const char *str = *strp;
+
+	rec->time_us = srec->time_us;
+	rec->start_us = srec->start_us;
+	rec->flags = srec->flags;
+	rec->id = srec->id;
+	rec->addr = srec->addr;
+
+	/* Assume no data corruption here */
+	rec->name = str;
+	str += strlen(str) + 1;
+	rec->group = *str ? str : NULL;
+	str += strlen(str) + 1;
+	*strp = str;
+}
+
+int bootstage_unstash(void *base, int size)
+{
+	struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
+	const struct bootstage_stash_rec *srec;
+	struct bootstage_record *rec;
+	const char *str;
+	int id;
+
+	if (check_stash(base, size))
+		return -1;
+
 	if (next_id + hdr->count > BOOTSTAGE_ID_COUNT) {
 		debug("%s: Bootstage has %d records, we have space for %d\n"
 			"- please increase CONFIG_BOOTSTAGE_USER_COUNT\n",
@@ -434,24 +601,107 @@ int bootstage_unstash(void *base, int size)
 		return -1;
 	}
 
-	ptr += sizeof(*hdr);
+	/* Read the records, the name strings follow them */
+	srec = (struct bootstage_stash_rec *)(hdr + 1);
+	str = (const char *)(srec + hdr->count);
+	for (rec = record + next_id, id = 0; id < hdr->count; id++, rec++)
+		read_stash_record(rec, &srec, &str);
+
+	/* Mark the records as read */
+	next_id += hdr->count;
+	printf("Unstashed %d records\n", hdr->count);
+
+	return 0;
+}
+
+/* The time of a record: when it was marked, or how long it took */
+static ulong record_time(const struct bootstage_record *rec)
+{
+	return is_span(rec) ? rec->time_us - rec->start_us : rec->time_us;
+}
 
-	/* Read the records */
-	rec_size = hdr->count * sizeof(*record);
-	memcpy(record + next_id, ptr, rec_size);
+static void print_diff(const struct bootstage_record *rec, const char *name,
+		       const struct bootstage_record *old)
+{
+	if (old)
+		print_grouped_ull(record_time(old), BOOTSTAGE_DIGITS);
+	else
+		printf("%11s", "-");
+	if (rec)
+		print_grouped_ull(record_time(rec), BOOTSTAGE_DIGITS);
+	else
+		printf("%11s", "-");
 
-	/* Read the name strings */
-	ptr += rec_size;
-	for (rec = record + next_id, id = 0; id < hdr->count; id++, rec++) {
-		rec->name = ptr;
+	if (rec && old)
+		printf("%+11ld", (long)record_time(rec) -
+		       (long)record_time(old));
+	else
+		printf("%11s", rec ? "new" : "gone");
 
-		/* Assume no data corruption here */
-		ptr += strlen(ptr) + 1;
+	rec = rec ? rec : old;
+	if (rec->group)
+		printf("  %s: %s\n", rec->group, name);
+	else
+		printf("  %s\n", name);
+}
+
+int bootstage_diff(const void *base, int size)
+{
+	const struct bootstage_hdr *hdr = base;
+	const struct bootstage_stash_rec *srec;
+	struct bootstage_record *rec, old;
+	const char *str, *name;
+	char *matched;
+	char buf[20];
+	int id, i;
+
+	if (check_stash(base, size))
+		return -1;
+
+	matched = calloc(hdr->count, 1);
+	if (!matched)
+		return -1;
+
+	printf("%11s%11s%11s  %s\n", "Baseline", "Now", "Change", "Stage");
+
+	/*
+	 * Records are matched up by name and group, so that this works
+	 * across builds as long as the names stay the same. Of names used
+	 * more than once, the earliest record not matched yet is taken.
+	 */
+	for (id = 0, rec = record; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (rec->time_us == 0)
+			continue;
+
+		name = get_record_name(buf, sizeof(buf), rec);
+		srec = (const struct bootstage_stash_rec *)(hdr + 1);
+		str = (const char *)(srec + hdr->count);
+		for (i = 0; i < hdr->count; i++) {
+			read_stash_record(&old, &srec, &str);
+			if (!matched[i] &&
+			    is_span(&old) == is_span(rec) &&
+			    same_group(old.group, rec->group) &&
+			    !strcmp(old.name, name))
+				break;
+		}
+
+		if (i < hdr->count) {
+			matched[i] = 1;
+			print_diff(rec, name, &old);
+		} else {
+			print_diff(rec, name, NULL);
+		}
 	}
 
-	/* Mark the records as read */
-	next_id += hdr->count;
-	printf("Unstashed %d records\n", hdr->count);
+	/* Then what is only in the baseline */
+	srec = (const struct bootstage_stash_rec *)(hdr + 1);
+	str = (const char *)(srec + hdr->count);
+	for (i = 0; i < hdr->count; i++) {
+		read_stash_record(&old, &srec, &str);
+		if (!matched[i])
+			print_diff(NULL, old.name, &old);
+	}
+	free(matched);
 
 	return 0;
 }
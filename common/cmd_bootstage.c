@@ -63,10 +63,31 @@ static int do_bootstage_stash(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_bootstage_diff(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	ulong base, size;
+
+	if (get_base_size(argc, argv, &base, &size))
+		return CMD_RET_USAGE;
+	if (base == -1UL) {
+		printf("No bootstage stash area defined\n");
+		return 1;
+	}
+
+	if (bootstage_diff((void *)base, size)) {
+		printf("No bootstage data found\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 static cmd_tbl_t cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
+	U_BOOT_CMD_MKENT(diff, 4, 0, do_bootstage_diff, "", ""),
 };
 
 /*
@@ -96,5 +117,6 @@ U_BOOT_CMD(bootstage, 4, 1, do_boostage,
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
-	"unstash [<start> [<size>]]  - Unstash data from memory"
+	"unstash [<start> [<size>]]  - Unstash data from memory\n"
+	"diff [<start> [<size>]]     - Compare with data stashed earlier"
 );
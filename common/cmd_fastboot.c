@@ -10,11 +10,23 @@
 #include <common.h>
 #include <command.h>
 #include <g_dnl.h>
+#include <net.h>
+#include <fb_command.h>
 
 static int do_fastboot(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 {
 	int ret;
 
+#ifdef CONFIG_FASTBOOT_UDP
+	if (argc > 1 && !strcmp(argv[1], "udp")) {
+		ret = NetLoop(FASTBOOT);
+		fb_set_progress(NULL);
+		return ret < 0 ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+	}
+#endif
+	if (argc > 1)
+		return CMD_RET_USAGE;
+
 	g_dnl_clear_detach();
 	ret = g_dnl_register("usb_dnl_fastboot");
 	if (ret)
@@ -34,8 +46,12 @@ static int do_fastboot(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 }
 
 U_BOOT_CMD(
-	fastboot,	1,	0,	do_fastboot,
+	fastboot,	2,	0,	do_fastboot,
 	"use USB Fastboot protocol",
 	"\n"
 	"    - run as a fastboot usb device"
+#ifdef CONFIG_FASTBOOT_UDP
+	"\nfastboot udp\n"
+	"    - run as a fastboot device on the network"
+#endif
 );
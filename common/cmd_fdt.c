@@ -14,6 +14,7 @@
 #include <linux/types.h>
 #include <asm/global_data.h>
 #include <libfdt.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <asm/io.h>
 
@@ -147,6 +148,9 @@ static int do_fdt(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 				}
 			}
 		}
+#ifdef CONFIG_FDT_INDEX
+		fdt_index_build(blob);
+#endif
 
 		return CMD_RET_SUCCESS;
 	}
@@ -17,6 +17,7 @@
 #include <asm/arch/bl31_apis.h>
 #include <asm/arch/secure_apb.h>
 #include <libfdt.h>
+#include <fdt_index.h>
 
 typedef struct andr_img_hdr boot_img_hdr;
 
@@ -211,6 +212,10 @@ static int do_image_read_dtb(cmd_tbl_t *cmdtp, int flag, int argc, char * const
     }
     const unsigned fdtsz    = fdt_totalsize((char*)fdtAddr);
     memmove(dtDestAddr, (char*)fdtAddr, fdtsz);
+#ifdef CONFIG_FDT_INDEX
+    /* Drivers read their settings from this tree before it is booted */
+    fdt_index_build(dtDestAddr);
+#endif
 
     return nReturn;
 }
@@ -784,6 +784,8 @@ static cmd_tbl_t cmd_mmc[] = {
 static int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	cmd_tbl_t *cp;
+	ulong start;
+	int ret;
 
 	cp = find_cmd_tbl(argv[1], cmd_mmc, ARRAY_SIZE(cmd_mmc));
 
@@ -804,7 +806,12 @@ static int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			return CMD_RET_FAILURE;
 		}
 	}
-	return cp->cmd(cmdtp, flag, argc, argv);
+
+	start = bootstage_span_start();
+	ret = cp->cmd(cmdtp, flag, argc, argv);
+	bootstage_span("mmc", cp->name, 0, start);
+
+	return ret;
 }
 
 U_BOOT_CMD(
@@ -11,6 +11,9 @@
 #include <common.h>
 #include <command.h>
 #include <net.h>
+#ifdef CONFIG_NET_SINK
+#include <net_sink.h>
+#endif
 
 static int netboot_common(enum proto_t, cmd_tbl_t *, int, char * const []);
 
@@ -100,6 +103,19 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]"
+);
+#endif
+
 #if defined(CONFIG_CMD_NFS)
 static int do_nfs(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -228,7 +244,13 @@ static int netboot_common(enum proto_t proto, cmd_tbl_t *cmdtp, int argc,
 	}
 	bootstage_mark(BOOTSTAGE_ID_NET_START);
 
-	if ((size = NetLoop(proto)) < 0) {
+	size = NetLoop(proto);
+#ifdef CONFIG_NET_SINK
+	/* The file went to storage, there is nothing to boot from memory */
+	if (net_sink_end() && size > 0)
+		size = 0;
+#endif
+	if (size < 0) {
 		bootstage_error(BOOTSTAGE_ID_NET_NETLOOP_OK);
 		return 1;
 	}
@@ -445,3 +467,71 @@ U_BOOT_CMD(
 );
 
 #endif  /* CONFIG_CMD_LINK_LOCAL */
+
+#if defined(CONFIG_NET_SINK)
+static int do_netsink(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+	int sparse;
+
+	if (argc == 1) {
+		net_sink_print();
+		return 0;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "off")) {
+		net_sink_disarm();
+		return 0;
+	}
+
+	if (argc < 3)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "ubi")) {
+		if (argc != 4)
+			return CMD_RET_USAGE;
+		if (net_sink_arm_ubi(argv[2], simple_strtoul(argv[3], NULL, 16)))
+			return 1;
+		net_sink_print();
+		return 0;
+	}
+
+	if (argc > 4 || (argc == 4 && strcmp(argv[3], "sparse")))
+		return CMD_RET_USAGE;
+	sparse = argc == 4;
+
+	if (!strcmp(argv[1], "store")) {
+		if (net_sink_arm_store(argv[2], sparse))
+			return 1;
+	} else {
+		if (get_device_and_partition(argv[1], argv[2], &dev_desc,
+					     &info, 1) < 0)
+			return 1;
+		if (!dev_desc->block_write) {
+			printf("Device %s %s is read-only\n", argv[1], argv[2]);
+			return 1;
+		}
+		if (net_sink_arm_blk(dev_desc, &info, sparse))
+			return 1;
+	}
+	net_sink_print();
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	netsink,	4,	0,	do_netsink,
+	"write the next network download straight to storage",
+	"<interface> <dev[:part]> [sparse]\n"
+	"    - write the next tftp/nfs download to a block device partition\n"
+	"netsink store <partition> [sparse]\n"
+	"    - write the next download to a store partition\n"
+	"netsink ubi <volume> <size>\n"
+	"    - write the next download (of hex 'size' bytes) to a UBI volume\n"
+	"netsink [off]\n"
+	"    - show or cancel the pending target\n"
+	"'sparse' decodes an Android sparse image on the fly"
+);
+#endif	/* CONFIG_NET_SINK */
@@ -99,7 +99,7 @@ static int env_print(char *name, int flag)
 	}
 
 	/* print whole list */
-	len = hexport_r(&env_htab, '\n', flag, &res, 0, 0, NULL);
+	len = hexport_r(&env_htab, '\n', flag | H_SORT, &res, 0, 0, NULL);
 
 	if (len > 0) {
 		puts(res);
@@ -189,7 +189,7 @@ static int do_env_grep(cmd_tbl_t *cmdtp, int flag,
 
 DONE:
 	len = hexport_r(&env_htab, '\n',
-			flag | grep_what | grep_how,
+			flag | grep_what | grep_how | H_SORT,
 			&res, 0, argc, argv);
 
 	if (len > 0) {
@@ -907,7 +907,7 @@ NXTARG:		;
 
 	if (sep) {		/* export as text file */
 		len = hexport_r(&env_htab, sep,
-				H_MATCH_KEY | H_MATCH_IDENT,
+				H_MATCH_KEY | H_MATCH_IDENT | H_SORT,
 				&ptr, size, argc, argv);
 		if (len < 0) {
 			error("Cannot export environment: errno = %d\n", errno);
@@ -0,0 +1,103 @@
+/*
+ * Sampling profiler commands
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <profile.h>
+#include <asm/io.h>
+
+static int profile_start_cmd(int argc, char * const argv[])
+{
+	unsigned int hz = CONFIG_SAMPLE_PROFILE_HZ;
+	unsigned int depth = PROFILE_MAX_DEPTH;
+	int ret;
+
+	if (argc > 2)
+		hz = simple_strtoul(argv[2], NULL, 10);
+	if (argc > 3)
+		depth = simple_strtoul(argv[3], NULL, 10);
+
+	ret = profile_start(hz, depth);
+	if (ret) {
+		printf("Cannot start profiling (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int profile_dump_cmd(int argc, char * const argv[])
+{
+	size_t buff_size, buff_ptr, avail, needed;
+	char *buff;
+
+	if (argc < 4) {
+		buff_size = getenv_ulong("profsize", 16, 0);
+		buff = map_sysmem(getenv_ulong("profbase", 16, 0), buff_size);
+		buff_ptr = getenv_ulong("profoffset", 16, 0);
+	} else {
+		buff_size = simple_strtoul(argv[3], NULL, 16);
+		buff = map_sysmem(simple_strtoul(argv[2], NULL, 16),
+				  buff_size);
+		buff_ptr = 0;
+	}
+
+	avail = buff_size > buff_ptr ? buff_size - buff_ptr : 0;
+	if (profile_dump(buff + buff_ptr, avail, &needed)) {
+		printf("Error: buffer too small (%#zx bytes needed)\n", needed);
+		return CMD_RET_FAILURE;
+	}
+	printf("Samples dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), needed);
+
+	setenv_hex("profbase", map_to_sysmem(buff));
+	setenv_hex("profsize", buff_size);
+	setenv_hex("profoffset", buff_ptr + needed);
+
+	return 0;
+}
+
+static int do_profile(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	const char *cmd = argc < 2 ? NULL : argv[1];
+
+	if (!cmd)
+		return CMD_RET_USAGE;
+	switch (*cmd) {
+	case 's':
+		if (!strcmp(cmd, "stop"))
+			profile_stop();
+		else if (!strcmp(cmd, "start"))
+			return profile_start_cmd(argc, argv);
+		else
+			return CMD_RET_USAGE;
+		break;
+	case 'i':
+		profile_print_stats();
+		break;
+	case 'r':
+		profile_report();
+		break;
+	case 'd':
+		return profile_dump_cmd(argc, argv);
+	default:
+		return CMD_RET_USAGE;
+	}
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	profile,	4,	0,	do_profile,
+	"sampling profiler",
+	"start [<hz> [<depth>]]  - start taking samples, with up to <depth>\n"
+	"                                  frames each\n"
+	"profile stop                    - stop taking samples\n"
+	"profile info                    - show the number of samples\n"
+	"profile report                  - print samples as folded stacks\n"
+	"profile dump [<addr> <size>]    - dump samples for proftool"
+);
@@ -173,6 +173,7 @@ int do_reboot (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			reboot_mode_val = AMLOGIC_NORMAL_BOOT;
 		}
 	}
+	console_flush();
 	aml_reboot (PSCI_SYS_REBOOT, reboot_mode_val, 0, 0);
 	return 0;
 }
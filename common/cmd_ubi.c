@@ -263,7 +263,7 @@ out_err:
 	return err;
 }
 
-static int ubi_volume_continue_write(char *volume, void *buf, size_t size)
+int ubi_volume_continue_write(char *volume, void *buf, size_t size)
 {
 	int err = 1;
 	struct ubi_volume *vol;
@@ -97,6 +97,12 @@ extern int overwrite_console(void);
 
 #endif /* CONFIG_SYS_CONSOLE_IS_IN_ENV */
 
+#ifdef CONFIG_CONSOLE_RING
+static void con_ring_send(int all);
+#else
+static inline void con_ring_send(int all) {}
+#endif
+
 static int console_setfile(int file, struct stdio_dev * dev)
 {
 	int error = 0;
@@ -104,6 +110,10 @@ static int console_setfile(int file, struct stdio_dev * dev)
 	if (dev == NULL)
 		return -1;
 
+	/* Queued output still goes where it was meant to */
+	if (file == stdout)
+		con_ring_send(1);
+
 	switch (file) {
 	case stdin:
 	case stdout:
@@ -252,6 +262,183 @@ static inline void console_doenv(int file, struct stdio_dev *dev)
 }
 #endif /* defined(CONFIG_CONSOLE_MUX) */
 
+#ifdef CONFIG_CONSOLE_RING
+/** Console output ring ************************************************/
+
+/*
+ * putc() and puts() store the output in a ring in memory, which is fed
+ * to the UART as fast as its FIFO takes it: whenever there is output,
+ * the console is polled, udelay() spins or the ring fills up. Writing to
+ * the UART never waits for it to finish a character this way.
+ *
+ * The ring has the layout of a pstore/ramoops console zone, so it also
+ * is a log of the boot loader output the kernel can read after boot.
+ * Only the number of bytes still to be sent lives in global data.
+ */
+#define CON_RING_SIG		0x43474244	/* "DBGC", PERSISTENT_RAM_SIG */
+
+struct con_ring {
+	u32	sig;
+	u32	start;		/* where the next byte goes in data[] */
+	u32	size;		/* bytes of log in data[] */
+	u8	data[0];
+};
+
+#define CON_RING_DATA	(CONFIG_CONSOLE_RING_SIZE - sizeof(struct con_ring))
+
+static inline struct con_ring *con_ring(void)
+{
+	return (struct con_ring *)CONFIG_CONSOLE_RING_ADDR;
+}
+
+static inline int con_ring_silent(void)
+{
+#ifdef CONFIG_SILENT_CONSOLE
+	return gd->flags & GD_FLG_SILENT;
+#else
+	return 0;
+#endif
+}
+
+static void con_ring_init(void)
+{
+	struct con_ring *ring = con_ring();
+
+	/* Append to what the kernel logged before a reboot, if intact */
+	if (ring->sig != CON_RING_SIG || ring->size > CON_RING_DATA ||
+	    ring->start > ring->size) {
+		ring->sig = CON_RING_SIG;
+		ring->start = 0;
+		ring->size = 0;
+	}
+	gd->con_ring_pending = 0;
+}
+
+/* Does stdout go straight to the UART? Other devices aren't queued for */
+static int con_ring_direct(void)
+{
+	if (!(gd->flags & GD_FLG_DEVINIT))
+		return 1;
+#ifdef CONFIG_CONSOLE_MUX
+	return 0;
+#else
+	return stdio_devices[stdout] &&
+		!strcmp(stdio_devices[stdout]->name, "serial");
+#endif
+}
+
+/*
+ * Send queued output, all of it when @all is set, else only what the
+ * UART takes without waiting
+ */
+static void con_ring_send(int all)
+{
+	struct con_ring *ring = con_ring();
+	ulong tail;
+	int room;
+	char c;
+
+	/* Nothing goes out when silent, and driver output isn't reentered */
+	if (con_ring_silent() || (gd->flags & GD_FLG_CON_RING_BUSY))
+		return;
+	gd->flags |= GD_FLG_CON_RING_BUSY;
+
+	tail = ring->start + CON_RING_DATA - gd->con_ring_pending;
+	if (tail >= CON_RING_DATA)
+		tail -= CON_RING_DATA;
+
+	if (!con_ring_direct()) {
+		char buf[64 + 1];
+		ulong len;
+
+		while (gd->con_ring_pending) {
+			len = min_t(ulong, gd->con_ring_pending, CON_RING_DATA - tail);
+			len = min_t(ulong, len, sizeof(buf) - 1);
+			memcpy(buf, ring->data + tail, len);
+			buf[len] = '\0';
+			console_puts(stdout, buf);
+
+			gd->con_ring_pending -= len;
+			tail += len;
+			if (tail == CON_RING_DATA)
+				tail = 0;
+		}
+	} else {
+		room = all ? -1 : serial_tx_space();
+
+		while (gd->con_ring_pending) {
+			c = ring->data[tail];
+			/* A newline goes out as CR LF */
+			if (room >= 0 && room < (c == '\n' ? 2 : 1))
+				break;
+			serial_putc(c);
+			if (room > 0)
+				room -= c == '\n' ? 2 : 1;
+
+			gd->con_ring_pending--;
+			if (++tail == CON_RING_DATA)
+				tail = 0;
+		}
+	}
+
+	gd->flags &= ~GD_FLG_CON_RING_BUSY;
+}
+
+static void con_ring_putc(const char c)
+{
+	struct con_ring *ring = con_ring();
+
+	if (gd->con_ring_pending == CON_RING_DATA) {
+		/* Full of unsent output, make room */
+		con_ring_send(1);
+		/* or lose the oldest when that isn't possible right now */
+		if (gd->con_ring_pending == CON_RING_DATA)
+			gd->con_ring_pending--;
+	}
+
+	ring->data[ring->start] = c;
+	if (++ring->start == CON_RING_DATA)
+		ring->start = 0;
+	if (ring->size < CON_RING_DATA)
+		ring->size++;
+	gd->con_ring_pending++;
+}
+
+static void con_ring_puts(const char *s)
+{
+	while (*s)
+		con_ring_putc(*s++);
+}
+
+/* Pass queued output on to the UART, as much as it takes right now */
+void console_poll(void)
+{
+	if (gd->have_console && gd->con_ring_pending)
+		con_ring_send(0);
+}
+
+/*
+ * Send all queued output and wait until the UART is done with it, for
+ * hand-off to an OS or a reset. Output queued while silent is dropped.
+ */
+void console_flush(void)
+{
+	if (!gd->have_console)
+		return;
+
+	if (con_ring_silent()) {
+		gd->con_ring_pending = 0;
+		return;
+	}
+
+	con_ring_send(1);
+	if (con_ring_direct())
+		serial_flush();
+}
+#else
+static inline void con_ring_init(void) {}
+#endif /* CONFIG_CONSOLE_RING */
+
 /** U-Boot INITIAL CONSOLE-NOT COMPATIBLE FUNCTIONS *************************/
 
 int serial_printf(const char *fmt, ...)
@@ -313,14 +500,18 @@ int ftstc(int file)
 
 void fputc(int file, const char c)
 {
-	if (file < MAX_FILES)
+	if (file < MAX_FILES) {
+		con_ring_send(1);
 		console_putc(file, c);
+	}
 }
 
 void fputs(int file, const char *s)
 {
-	if (file < MAX_FILES)
+	if (file < MAX_FILES) {
+		con_ring_send(1);
 		console_puts(file, s);
+	}
 }
 
 int fprintf(int file, const char *fmt, ...)
@@ -354,6 +545,9 @@ int getc(void)
 	if (!gd->have_console)
 		return 0;
 
+	/* The prompt must be out before we wait for an answer */
+	con_ring_send(1);
+
 	if (gd->flags & GD_FLG_DEVINIT) {
 		/* Get from the standard input */
 		return fgetc(stdin);
@@ -373,6 +567,8 @@ int tstc(void)
 	if (!gd->have_console)
 		return 0;
 
+	con_ring_send(0);
+
 	if (gd->flags & GD_FLG_DEVINIT) {
 		/* Test the standard input */
 		return ftstc(stdin);
@@ -415,12 +611,10 @@ static inline void pre_console_puts(const char *s) {}
 static inline void print_pre_console_buffer(void) {}
 #endif
 
-
-#ifdef CONFIG_SILENT_CONSOLE
+#if defined(CONFIG_SILENT_CONSOLE) && !defined(CONFIG_CONSOLE_RING)
 static void print_to_buf(const char *s);
 #endif
 
-
 void putc(const char c)
 {
 #ifdef CONFIG_SANDBOX
@@ -429,7 +623,7 @@ void putc(const char c)
 		return;
 	}
 #endif
-#ifdef CONFIG_SILENT_CONSOLE
+#if defined(CONFIG_SILENT_CONSOLE) && !defined(CONFIG_CONSOLE_RING)
 	char s[2];
 	s[0] = c;
 	s[1] = '\0';
@@ -447,6 +641,11 @@ void putc(const char c)
 	if (!gd->have_console)
 		return pre_console_putc(c);
 
+#ifdef CONFIG_CONSOLE_RING
+	/* Queued even when silent, con_ring_send() holds it back then */
+	con_ring_putc(c);
+	con_ring_send(0);
+#else
 	if (gd->flags & GD_FLG_DEVINIT) {
 		/* Send to the standard output */
 		fputc(stdout, c);
@@ -454,9 +653,11 @@ void putc(const char c)
 		/* Send directly to the handler */
 		serial_putc(c);
 	}
+#endif
 }
 
 #ifdef CONFIG_SILENT_CONSOLE
+#ifndef CONFIG_CONSOLE_RING
 #define PRT_BUF_SIZE		65536
 #define PRT_BUF_END		(PRT_BUF_SIZE - 8)
 static int buf_p = 0;
@@ -517,6 +718,7 @@ void destory_print_buf(void)
 	print_buf = NULL;
 	buf_p = 0;
 }
+#endif /* !CONFIG_CONSOLE_RING */
 
 static int do_silent(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -539,7 +741,7 @@ U_BOOT_CMD(
    "silent",
    "make console silence on/off"
 );
-#endif /* CONFIG_MUTE_PRINT */
+#endif /* CONFIG_SILENT_CONSOLE */
 
 void puts(const char *s)
 {
@@ -550,7 +752,7 @@ void puts(const char *s)
 	}
 #endif
 
-#ifdef CONFIG_SILENT_CONSOLE
+#if defined(CONFIG_SILENT_CONSOLE) && !defined(CONFIG_CONSOLE_RING)
 	if (gd->flags & GD_FLG_SILENT) {
 		print_to_buf(s);
 		return;
@@ -565,6 +767,10 @@ void puts(const char *s)
 	if (!gd->have_console)
 		return pre_console_puts(s);
 
+#ifdef CONFIG_CONSOLE_RING
+	con_ring_puts(s);
+	con_ring_send(0);
+#else
 	if (gd->flags & GD_FLG_DEVINIT) {
 		/* Send to the standard output */
 		fputs(stdout, s);
@@ -572,6 +778,7 @@ void puts(const char *s)
 		/* Send directly to the handler */
 		serial_puts(s);
 	}
+#endif
 }
 
 int printf(const char *fmt, ...)
@@ -770,6 +977,7 @@ int console_assign(int file, const char *devname)
 /* Called before relocation - use serial functions */
 int console_init_f(void)
 {
+	con_ring_init();
 	gd->have_console = 1;
 
 	print_pre_console_buffer();
@@ -779,7 +987,7 @@ int console_init_f(void)
 
 int console_init_m(void)
 {
-#ifdef CONFIG_SILENT_CONSOLE
+#if defined(CONFIG_SILENT_CONSOLE) && !defined(CONFIG_CONSOLE_RING)
 	print_buf = (char*)malloc(PRT_BUF_SIZE);
 	if (!print_buf) {
 		puts("no memory for print_buf\n");
@@ -275,6 +275,8 @@ void env_relocate(void)
 		gd->flags |= GD_FLG_SILENT;
 	else {
 		gd->flags &= ~GD_FLG_SILENT;
+		/* What was held back so far */
+		console_poll();
 		flush_print_buf();
 	}
 	destory_print_buf();
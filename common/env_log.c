@@ -0,0 +1,325 @@
+/*
+ * Environment change log, see include/env_log.h
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/* #define DEBUG */
+
+#include <common.h>
+#include <environment.h>
+#include <env_log.h>
+#include <errno.h>
+#include <malloc.h>
+#include <search.h>
+
+/* Geometry of the log area */
+static size_t log_size;
+static size_t log_blksz;
+
+/* Whether the log applies to the environment copy on storage */
+static int log_valid;
+static uint32_t log_base;
+static uint32_t log_seq;	/* sequence number of the next batch */
+static size_t log_end;
+
+/* Sorted export of the environment as it is on storage */
+static char *log_saved;
+
+/* Batch waiting for env_log_commit() and the state it leads to */
+static char *log_batch;
+static char *log_next_saved;
+static uint32_t log_next_base;
+static size_t log_next_end;
+
+static void env_log_discard(void)
+{
+	free(log_batch);
+	free(log_next_saved);
+	log_batch = NULL;
+	log_next_saved = NULL;
+}
+
+static char *env_log_export(void)
+{
+	char *res = NULL;
+
+	if (hexport_r(&env_htab, '\0', H_SORT, &res, 0, 0, NULL) < 0)
+		return NULL;
+
+	return res;
+}
+
+/* Length of an exported environment, including the final empty string */
+static size_t env_log_strlen(const char *env)
+{
+	const char *s = env;
+
+	while (*s)
+		s += strlen(s) + 1;
+
+	return s - env + 1;
+}
+
+/* Compare the names of two "name=value" strings */
+static int env_log_keycmp(const char *a, const char *b)
+{
+	while (*a == *b && *a != '=') {
+		a++;
+		b++;
+	}
+
+	if (*a == *b)
+		return 0;
+	if (*a == '=')
+		return -1;
+	if (*b == '=')
+		return 1;
+
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+/*
+ * Write the records turning the sorted environment "old" into "new" to
+ * "out". Returns their length, which is 1 (just the terminating empty
+ * string) if there is no difference.
+ */
+static size_t env_log_diff(const char *old, const char *new, char *out)
+{
+	char *p = out;
+	size_t n;
+	int cmp;
+
+	while (*old || *new) {
+		if (!*old)
+			cmp = 1;
+		else if (!*new)
+			cmp = -1;
+		else
+			cmp = env_log_keycmp(old, new);
+
+		if (cmp < 0) {
+			/* deleted, just the name */
+			n = strchr(old, '=') - old;
+			memcpy(p, old, n);
+			p[n] = '\0';
+			p += n + 1;
+		} else if (cmp > 0 || strcmp(old, new)) {
+			/* new or changed */
+			n = strlen(new) + 1;
+			memcpy(p, new, n);
+			p += n;
+		}
+
+		if (cmp <= 0)
+			old += strlen(old) + 1;
+		if (cmp >= 0)
+			new += strlen(new) + 1;
+	}
+	*p++ = '\0';
+
+	return p - out;
+}
+
+static int env_log_hdr_ok(const struct env_log_hdr *hdr)
+{
+	return hdr->magic == ENV_LOG_MAGIC &&
+	       hdr->hdr_crc == crc32(0, (const uchar *)hdr,
+				     offsetof(struct env_log_hdr, hdr_crc));
+}
+
+/* Allocate a batch of "len" bytes of records and fill in its header */
+static char *env_log_batch(uint32_t base, const char *records, size_t len,
+			   size_t *total)
+{
+	struct env_log_hdr *hdr;
+	char *batch;
+
+	*total = ALIGN(sizeof(*hdr) + len, log_blksz);
+	batch = memalign(ARCH_DMA_MINALIGN, *total);
+	if (!batch)
+		return NULL;
+
+	hdr = (struct env_log_hdr *)batch;
+	hdr->magic = ENV_LOG_MAGIC;
+	hdr->base = base;
+	hdr->seq = log_seq;
+	hdr->len = len;
+	hdr->crc = crc32(0, (const uchar *)records, len);
+	hdr->hdr_crc = crc32(0, (const uchar *)hdr,
+			     offsetof(struct env_log_hdr, hdr_crc));
+	memcpy(batch + sizeof(*hdr), records, len);
+	memset(batch + sizeof(*hdr) + len, 0, *total - sizeof(*hdr) - len);
+
+	return batch;
+}
+
+int env_log_load(const char *log, size_t size, size_t blksz,
+		 const env_t *env)
+{
+	const struct env_log_hdr *hdr;
+	size_t off, next;
+	uint32_t seq = 0;
+	int n = 0;
+
+	env_log_discard();
+	free(log_saved);
+	log_saved = NULL;
+	log_valid = 0;
+	log_size = size;
+	log_blksz = blksz;
+	log_seq = 0;
+	log_end = 0;
+
+	if (!log)
+		goto out;
+
+	/*
+	 * Batches left over from before the log was last started over, or
+	 * torn ones, must never be taken for new ones: sequence numbers
+	 * only go up, counting from the highest one there is.
+	 */
+	for (off = 0; off + sizeof(*hdr) <= size; off += blksz) {
+		hdr = (const struct env_log_hdr *)(log + off);
+		if (env_log_hdr_ok(hdr) && hdr->seq >= log_seq)
+			log_seq = hdr->seq + 1;
+	}
+
+	if (!env)
+		goto out;
+
+	log_base = env->crc;
+	for (off = 0; off + sizeof(*hdr) <= size; off = next) {
+		hdr = (const struct env_log_hdr *)(log + off);
+		if (!env_log_hdr_ok(hdr) || hdr->base != log_base ||
+		    (n && hdr->seq <= seq))
+			break;
+
+		next = ALIGN(off + sizeof(*hdr) + hdr->len, blksz);
+		if (!hdr->len || next > size ||
+		    crc32(0, (const uchar *)(hdr + 1), hdr->len) != hdr->crc)
+			break;
+
+		if (hdr->len > 1 &&
+		    !himport_r(&env_htab, (const char *)(hdr + 1), hdr->len,
+			       '\0', H_NOCLEAR | H_FORCE, 0, 0, NULL))
+			break;
+
+		debug("env_log: batch %u at 0x%zx, %u bytes\n", hdr->seq,
+		      off, hdr->len);
+		seq = hdr->seq;
+		log_end = next;
+		n++;
+	}
+
+	/* Without a first batch the log belongs to another copy */
+	if (n) {
+		log_saved = env_log_export();
+		log_valid = log_saved != NULL;
+	}
+
+out:
+	if (!log_seq)
+		log_seq = 1;
+
+	return n;
+}
+
+int env_log_prepare(char **batch, size_t *len)
+{
+	char *new, *records;
+	size_t max, n;
+
+	env_log_discard();
+	*len = 0;
+
+	if (!log_valid)
+		return -ENOSPC;
+
+	new = env_log_export();
+	if (!new)
+		return -ENOMEM;
+
+	max = env_log_strlen(log_saved) + env_log_strlen(new);
+	records = malloc(max);
+	if (!records) {
+		free(new);
+		return -ENOMEM;
+	}
+
+	n = env_log_diff(log_saved, new, records);
+	if (n == 1) {
+		free(records);
+		free(new);
+		return 0;
+	}
+
+	log_batch = env_log_batch(log_base, records, n, len);
+	free(records);
+	if (!log_batch) {
+		free(new);
+		return -ENOMEM;
+	}
+
+	if (log_end + *len > log_size) {
+		debug("env_log: full, %zu + %zu bytes\n", log_end, *len);
+		free(new);
+		env_log_discard();
+		*len = 0;
+		return -ENOSPC;
+	}
+
+	log_next_saved = new;
+	log_next_base = log_base;
+	log_next_end = log_end + *len;
+	*batch = log_batch;
+
+	return 0;
+}
+
+int env_log_reset(uint32_t base, char **batch, size_t *len)
+{
+	env_log_discard();
+	*len = 0;
+
+	if (!log_blksz || log_blksz > log_size)
+		return -EINVAL;
+
+	log_next_saved = env_log_export();
+	if (!log_next_saved)
+		return -ENOMEM;
+
+	/* A batch without records, it only starts the log */
+	log_batch = env_log_batch(base, "", 1, len);
+	if (!log_batch) {
+		env_log_discard();
+		*len = 0;
+		return -ENOMEM;
+	}
+
+	log_next_base = base;
+	log_next_end = *len;
+	*batch = log_batch;
+
+	return 0;
+}
+
+size_t env_log_end(void)
+{
+	return log_end;
+}
+
+void env_log_commit(void)
+{
+	free(log_batch);
+	log_batch = NULL;
+
+	free(log_saved);
+	log_saved = log_next_saved;
+	log_next_saved = NULL;
+
+	log_base = log_next_base;
+	log_end = log_next_end;
+	log_seq++;
+	log_valid = 1;
+}
@@ -15,6 +15,7 @@
 #include <mmc.h>
 #include <search.h>
 #include <errno.h>
+#include <env_log.h>
 
 #ifdef CONFIG_STORE_COMPATIBLE
 	#include <emmc_partitions.h>
@@ -40,6 +41,20 @@ DECLARE_GLOBAL_DATA_PTR;
 #define CONFIG_ENV_OFFSET 0
 #endif
 
+/* The change log is only kept by U-Boot proper */
+#if defined(CONFIG_ENV_LOG) && defined(CONFIG_SPL_BUILD)
+#undef CONFIG_ENV_LOG
+#endif
+
+#ifdef CONFIG_ENV_LOG
+#ifndef CONFIG_ENV_LOG_SIZE
+#define CONFIG_ENV_LOG_SIZE	CONFIG_ENV_SIZE
+#endif
+#if defined(CONFIG_ENV_OFFSET_REDUND) && !defined(CONFIG_ENV_LOG_OFFSET)
+#error CONFIG_ENV_LOG_OFFSET must be set along with CONFIG_ENV_OFFSET_REDUND
+#endif
+#endif
+
 __weak int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr)
 {
 	s64 offset;
@@ -72,6 +87,27 @@ __weak int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr)
 	return 0;
 }
 
+#ifdef CONFIG_ENV_LOG
+__weak int mmc_get_env_log_addr(struct mmc *mmc, u32 *log_addr)
+{
+#ifdef CONFIG_ENV_LOG_OFFSET
+	s64 offset = CONFIG_ENV_LOG_OFFSET;
+
+	if (offset < 0)
+		offset += mmc->capacity;
+
+	*log_addr = offset;
+#else
+	/* Right behind the environment */
+	if (mmc_get_env_addr(mmc, 0, log_addr))
+		return -1;
+
+	*log_addr += CONFIG_ENV_SIZE;
+#endif
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_STORE_COMPATIBLE
 int mmc_env_init(void)
 #else
@@ -160,6 +196,57 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 static unsigned char env_flags;
 #endif
 
+#ifdef CONFIG_ENV_LOG
+/* Append what changed to the log, -ENOSPC means a full save is needed */
+static int env_log_append(struct mmc *mmc)
+{
+	char *batch;
+	size_t len;
+	u32 offset;
+	int ret;
+
+	ret = env_log_prepare(&batch, &len);
+	if (ret)
+		return ret;
+
+	if (!len) {
+		puts("Environment unchanged\n");
+		return 0;
+	}
+
+	if (mmc_get_env_log_addr(mmc, &offset))
+		return -EIO;
+
+	printf("Writing changes to MMC(%d)... ", CONFIG_SYS_MMC_ENV_DEV);
+	if (write_env(mmc, len, offset + env_log_end(), batch)) {
+		puts("failed\n");
+		return -EIO;
+	}
+	puts("done\n");
+
+	env_log_commit();
+	return 0;
+}
+
+/* Start the log over for the copy just written */
+static int env_log_start(struct mmc *mmc, uint32_t crc)
+{
+	char *batch;
+	size_t len;
+	u32 offset;
+
+	if (env_log_reset(crc, &batch, &len) ||
+	    mmc_get_env_log_addr(mmc, &offset) ||
+	    write_env(mmc, len, offset, batch)) {
+		puts("*** Warning - could not reset environment log\n");
+		return -EIO;
+	}
+
+	env_log_commit();
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_STORE_COMPATIBLE
 int mmc_saveenv(void)
 #else
@@ -174,6 +261,14 @@ int saveenv(void)
 	if (init_mmc_for_env(mmc))
 		return 1;
 
+#ifdef CONFIG_ENV_LOG
+	ret = env_log_append(mmc);
+	if (ret != -ENOSPC) {
+		ret = ret ? 1 : 0;
+		goto fini;
+	}
+#endif
+
 	ret = env_export(env_new);
 	if (ret)
 		goto fini;
@@ -205,6 +300,11 @@ int saveenv(void)
 	gd->env_valid = gd->env_valid == 2 ? 1 : 2;
 #endif
 
+#ifdef CONFIG_ENV_LOG
+	if (env_log_start(mmc, env_new->crc))
+		ret = 1;
+#endif
+
 fini:
 	fini_mmc_for_env(mmc);
 	return ret;
@@ -229,6 +329,28 @@ static inline int read_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_LOG
+/* Replay the log on top of "env", the copy just imported, if any */
+static void env_log_read(struct mmc *mmc, const env_t *env)
+{
+	char *log;
+	u32 offset;
+
+	log = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_LOG_SIZE);
+	if (log && (mmc_get_env_log_addr(mmc, &offset) ||
+		    read_env(mmc, CONFIG_ENV_LOG_SIZE, offset, log))) {
+		puts("*** Warning - could not read environment log\n");
+		free(log);
+		log = NULL;
+	}
+
+	env_log_load(log, CONFIG_ENV_LOG_SIZE, mmc->write_bl_len, env);
+	free(log);
+}
+#else
+static inline void env_log_read(struct mmc *mmc, const env_t *env) {}
+#endif
+
 #ifdef CONFIG_ENV_OFFSET_REDUND
 #ifdef CONFIG_STORE_COMPATIBLE
 void mmc_env_relocate_spec(void)
@@ -312,6 +434,7 @@ void env_relocate_spec(void)
 	ret = 0;
 
 fini:
+	env_log_read(mmc, ret ? NULL : ep);
 	fini_mmc_for_env(mmc);
 err:
 	if (ret)
@@ -330,6 +453,7 @@ void env_relocate_spec(void)
 #if !defined(ENV_IS_EMBEDDED)
 	ALLOC_CACHE_ALIGN_BUFFER(char, buf, CONFIG_ENV_SIZE);
 	struct mmc *mmc;
+	env_t *ep = NULL;
 	u32 offset;
 	int ret;
 	int dev = CONFIG_SYS_MMC_ENV_DEV;
@@ -355,10 +479,13 @@ void env_relocate_spec(void)
 		goto fini;
 	}
 
-	env_import(buf, 1);
+	if (env_import(buf, 1))
+		ep = (env_t *)buf;
 	ret = 0;
 
 fini:
+	/* Even without an environment, saveenv needs to know the log */
+	env_log_read(mmc, ep);
 	fini_mmc_for_env(mmc);
 err:
 	if (ret)
@@ -0,0 +1,401 @@
+/*
+ * Fastboot command set, shared by the USB and the UDP transport
+ *
+ * Copyright 2014 Linaro, Ltd.
+ * Rob Herring <robh@kernel.org>
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+#include <config.h>
+#include <common.h>
+#include <command.h>
+#include <version.h>
+#include <g_dnl.h>
+#include <fb_command.h>
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+#include <fb_mmc.h>
+#include <fb_storage.h>
+#endif
+#include <partition_table.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define FASTBOOT_VERSION		"0.4"
+
+#define DEVICE_PRODUCT	CONFIG_DEVICE_PRODUCT
+#define DEVICE_SERIAL	"1234567890"
+
+#define BYTES_PER_DOT	0x20000
+
+static unsigned int download_size;
+static unsigned int download_bytes;
+
+static void (*progress_cb)(const char *msg);
+
+#define DRAM_UBOOT_RESERVE		0x01000000
+unsigned int ddr_size_usable(unsigned int addr_start)
+{
+	unsigned int ddr_size=0;
+	unsigned int free_size = 0;
+	int i;
+
+	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++)
+		ddr_size += gd->bd->bi_dram[i].size;
+
+	free_size = (ddr_size - DRAM_UBOOT_RESERVE - addr_start - CONFIG_SYS_MALLOC_LEN - CONFIG_SYS_MEM_TOP_HIDE);
+#if defined CONFIG_FASTBOOT_MAX_DOWN_SIZE
+	if (free_size > CONFIG_FASTBOOT_MAX_DOWN_SIZE)
+		free_size = CONFIG_FASTBOOT_MAX_DOWN_SIZE;
+#endif
+	return free_size;
+}
+
+void fb_set_progress(void (*cb)(const char *msg))
+{
+	progress_cb = cb;
+}
+
+void fb_progress(const char *msg)
+{
+	if (progress_cb)
+		progress_cb(msg);
+}
+
+static int cb_reboot(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strcpy(response, "OKAY");
+	strsep(&cmd, "-");
+	if (!cmd)
+		return FB_ACTION_REBOOT;
+
+	return FB_ACTION_REBOOT_BOOTLOADER;
+}
+
+static int strcmp_l1(const char *s1, const char *s2)
+{
+	if (!s1 || !s2)
+		return -1;
+	return strncmp(s1, s2, strlen(s1));
+}
+
+static int cb_getvar(char *cmd, char *response)
+{
+	char *s;
+	char *s1;
+	char *s2;
+	char *s3;
+	size_t chars_left;
+
+	strcpy(response, "OKAY");
+	chars_left = FASTBOOT_RESPONSE_LEN - strlen(response) - 1;
+
+	strsep(&cmd, ":");
+	if (!cmd) {
+		error("missing variable\n");
+		strcpy(response, "FAILmissing var");
+		return FB_ACTION_NONE;
+	}
+
+	if (!strcmp_l1("version", cmd)) {
+		strncat(response, FASTBOOT_VERSION, chars_left);
+	} else if (!strcmp_l1("bootloader-version", cmd)) {
+		strncat(response, U_BOOT_VERSION, chars_left);
+	} else if (!strcmp_l1("downloadsize", cmd) ||
+		!strcmp_l1("max-download-size", cmd)) {
+		char str_num[12];
+
+		sprintf(str_num, "0x%08x", ddr_size_usable(CONFIG_USB_FASTBOOT_BUF_ADDR));
+		strncat(response, str_num, chars_left);
+	} else if (!strcmp_l1("serialno", cmd)) {
+		s = get_usid_string();
+		if (s)
+			strncat(response, s, chars_left);
+		else
+			strncat(response, DEVICE_SERIAL, chars_left);
+	} else if (!strcmp_l1("product", cmd)) {
+		s1 = DEVICE_PRODUCT;
+		strncat(response, s1, chars_left);
+	} else if (!strcmp_l1("slot-count", cmd)) {
+		strncat(response, "2", chars_left);
+	} else if (!strcmp_l1("slot-suffixes", cmd)) {
+		s2 = getenv("slot-suffixes");
+		printf("slot-suffixes: %s\n", s2);
+		if (s2)
+			strncat(response, s2, chars_left);
+		else
+			strncat(response, "0", chars_left);
+	} else if (!strcmp_l1("current-slot", cmd)) {
+		s3 = getenv("active_slot");
+		printf("active_slot: %s\n", s3);
+		if (s3)
+			strncat(response, s3, chars_left);
+	} else if (!strcmp_l1("has-slot:boot", cmd)) {
+		if (has_boot_slot == 1) {
+			printf("has boot slot\n");
+			strncat(response, "yes", chars_left);
+		} else
+			strncat(response, "no", chars_left);
+	} else if (!strcmp_l1("has-slot:system", cmd)) {
+		if (has_system_slot == 1) {
+			printf("has system slot\n");
+			strncat(response, "yes", chars_left);
+		} else
+			strncat(response, "no", chars_left);
+	} else {
+		error("unknown variable: %s\n", cmd);
+		strcpy(response, "FAILVariable not implemented");
+	}
+	return FB_ACTION_NONE;
+}
+
+unsigned int fb_download_remaining(void)
+{
+	if (download_bytes >= download_size)
+		return 0;
+	return download_size - download_bytes;
+}
+
+void fb_download_data(const void *data, unsigned int len)
+{
+	unsigned int pre_dot_num, now_dot_num;
+
+	if (len > fb_download_remaining())
+		len = fb_download_remaining();
+
+	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
+	       data, len);
+
+	pre_dot_num = download_bytes / BYTES_PER_DOT;
+	download_bytes += len;
+	now_dot_num = download_bytes / BYTES_PER_DOT;
+
+	if (pre_dot_num != now_dot_num) {
+		putc('.');
+		if (!(now_dot_num % 74))
+			putc('\n');
+	}
+}
+
+void fb_download_complete(char *response)
+{
+	/*
+	 * Reset global transfer variable, keep download_bytes because
+	 * it will be used in the next possible flashing command
+	 */
+	download_size = 0;
+	strcpy(response, "OKAY");
+
+	printf("\ndownloading of %d bytes finished\n", download_bytes);
+}
+
+static int cb_download(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strsep(&cmd, ":");
+	download_size = cmd ? simple_strtoul(cmd, NULL, 16) : 0;
+	download_bytes = 0;
+
+	printf("Starting download of %d bytes\n", download_size);
+
+	if (0 == download_size) {
+		sprintf(response, "FAILdata invalid size");
+	} else if (download_size > ddr_size_usable(CONFIG_USB_FASTBOOT_BUF_ADDR)) {
+		download_size = 0;
+		sprintf(response, "FAILdata too large");
+	} else {
+		sprintf(response, "DATA%08x", download_size);
+		return FB_ACTION_DOWNLOAD;
+	}
+	return FB_ACTION_NONE;
+}
+
+static int cb_boot(char *cmd, char *response)
+{
+	strcpy(response, "OKAY");
+	return FB_ACTION_BOOT;
+}
+
+static int cb_continue(char *cmd, char *response)
+{
+	strcpy(response, "OKAY");
+	return FB_ACTION_CONTINUE;
+}
+
+#ifdef CONFIG_FASTBOOT_FLASH
+static int cb_flash(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strsep(&cmd, ":");
+	if (!cmd) {
+		error("missing partition name\n");
+		strcpy(response, "FAILmissing partition name");
+		return FB_ACTION_NONE;
+	}
+
+	strcpy(response, "FAILno flash device defined");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
+			   download_bytes, response);
+#endif
+	return FB_ACTION_NONE;
+}
+#endif
+
+static int cb_set_active(char *cmd, char *response)
+{
+	int ret = 0;
+	char str[128];
+
+	printf("cmd is %s\n", cmd);
+	strsep(&cmd, ":");
+	if (!cmd) {
+		error("missing slot name\n");
+		strcpy(response, "FAILmissing slot name");
+		return FB_ACTION_NONE;
+	}
+
+	snprintf(str, sizeof(str), "set_active_slot %s", cmd);
+	printf("command:    %s\n", str);
+	ret = run_command(str, 0);
+	printf("ret = %d\n", ret);
+	if (ret == 0)
+		strcpy(response, "OKAY");
+	else
+		strcpy(response, "FAILset slot error");
+	return FB_ACTION_NONE;
+}
+
+static int cb_flashall(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strcpy(response, "FAILno flash device defined");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
+			   download_bytes, response);
+#endif
+	return FB_ACTION_NONE;
+}
+
+static int cb_erase(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strsep(&cmd, ":");
+	if (!cmd) {
+		error("missing partition name\n");
+		strcpy(response, "FAILmissing partition name");
+		return FB_ACTION_NONE;
+	}
+
+	strcpy(response, "FAILno erase device defined");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	fb_mmc_erase_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR, response);
+#endif
+	return FB_ACTION_NONE;
+}
+
+static int cb_devices(char *cmd, char *response)
+{
+	printf("cmd is %s\n", cmd);
+
+	strcpy(response, "AMLOGIC");
+	return FB_ACTION_NONE;
+}
+
+struct cmd_dispatch_info {
+	char *cmd;
+	int (*cb)(char *cmd, char *response);
+};
+
+static const struct cmd_dispatch_info cmd_dispatch_info[] = {
+	{
+		.cmd = "reboot",
+		.cb = cb_reboot,
+	}, {
+		.cmd = "getvar:",
+		.cb = cb_getvar,
+	}, {
+		.cmd = "download:",
+		.cb = cb_download,
+	}, {
+		.cmd = "boot",
+		.cb = cb_boot,
+	}, {
+		.cmd = "continue",
+		.cb = cb_continue,
+	},
+#ifdef CONFIG_FASTBOOT_FLASH
+	{
+		.cmd = "flash",
+		.cb = cb_flash,
+	},
+#endif
+	{
+		.cmd = "update",
+		.cb = cb_download,
+	},
+	{
+		.cmd = "flashall",
+		.cb = cb_flashall,
+	},
+	{
+		.cmd = "erase",
+		.cb = cb_erase,
+	},
+	{
+		.cmd = "devices",
+		.cb = cb_devices,
+	},
+	{
+		.cmd = "reboot-bootloader",
+		.cb = cb_reboot,
+	},
+	{
+		.cmd = "set_active",
+		.cb = cb_set_active,
+	},
+};
+
+int fb_handle_command(char *cmd, char *response)
+{
+	int i;
+
+	*response = '\0';
+	for (i = 0; i < ARRAY_SIZE(cmd_dispatch_info); i++) {
+		if (!strcmp_l1(cmd_dispatch_info[i].cmd, cmd))
+			return cmd_dispatch_info[i].cb(cmd, response);
+	}
+
+	error("unknown command: %s\n", cmd);
+	strcpy(response, "FAILunknown command");
+	return FB_ACTION_NONE;
+}
+
+void fb_do_action(int action)
+{
+	char boot_addr_start[12];
+	char *bootm_args[] = { "bootm", boot_addr_start, NULL };
+
+	switch (action) {
+	case FB_ACTION_BOOT:
+		puts("Booting kernel..\n");
+
+		sprintf(boot_addr_start, "0x%lx", load_addr);
+		do_bootm(NULL, 0, 2, bootm_args);
+
+		/* This only happens if image is somehow faulty so we start over */
+		do_reset(NULL, 0, 0, NULL);
+		break;
+	case FB_ACTION_REBOOT:
+		do_reset(NULL, 0, 0, NULL);
+		break;
+	case FB_ACTION_REBOOT_BOOTLOADER:
+		run_command("reboot fastboot", 0);
+		break;
+	}
+}
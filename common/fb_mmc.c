@@ -11,6 +11,7 @@
 #include <aboot.h>
 #include <sparse_format.h>
 #include <mmc.h>
+#include <fb_command.h>
 #ifndef CONFIG_FASTBOOT_GPT_NAME
 #define CONFIG_FASTBOOT_GPT_NAME GPT_ENTRY_NAME
 #endif
@@ -19,6 +20,9 @@
 #define CONFIG_FASTBOOT_MBR_NAME "mbr"
 #endif
 
+/* Raw images are written in pieces of this size to report progress */
+#define FB_MMC_WRITE_CHUNK	(16 * 1024 * 1024)
+
 extern int dtb_write(void *addr);
 extern int renew_partition_tbl(unsigned char *buffer);
 /* The 64 defined bytes plus the '\0' */
@@ -67,6 +71,7 @@ static void write_raw_image(block_dev_desc_t *dev_desc, disk_partition_t *info,
 {
 	lbaint_t blkcnt;
 	lbaint_t blks;
+	lbaint_t blk, chunk;
 
 	/* determine number of blocks to write */
 	blkcnt = ((download_bytes + (info->blksz - 1)) & ~(info->blksz - 1));
@@ -80,12 +85,17 @@ static void write_raw_image(block_dev_desc_t *dev_desc, disk_partition_t *info,
 
 	puts("Flashing Raw Image\n");
 
-	blks = dev_desc->block_write(dev_desc->dev, info->start, blkcnt,
-				     buffer);
-	if (blks != blkcnt) {
-		error("failed writing to device %d\n", dev_desc->dev);
-		fastboot_fail("failed writing to device");
-		return;
+	for (blk = 0; blk < blkcnt; blk += chunk) {
+		chunk = min_t(lbaint_t, blkcnt - blk,
+			      FB_MMC_WRITE_CHUNK / info->blksz);
+		blks = dev_desc->block_write(dev_desc->dev, info->start + blk,
+					     chunk, buffer + blk * info->blksz);
+		if (blks != chunk) {
+			error("failed writing to device %d\n", dev_desc->dev);
+			fastboot_fail("failed writing to device");
+			return;
+		}
+		fb_progress("writing");
 	}
 
 	printf("........ wrote " LBAFU " bytes to '%s'\n", blkcnt * info->blksz,
@@ -15,6 +15,7 @@
 #include <asm/global_data.h>
 #include <libfdt.h>
 #include <fdt_support.h>
+#include <fdt_index.h>
 #include <exports.h>
 
 /**
@@ -122,12 +123,308 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 	return offset;
 }
 
+static int fdt_batch_add(struct fdt_batch *batch, int offset, int remove,
+			 int len, int nameoff, int prop, const void *data,
+			 int data_len)
+{
+	struct fdt_batch_edit *edit;
+
+	if (batch->count == FDT_BATCH_MAX)
+		return -FDT_ERR_NOSPACE;
+
+	edit = &batch->edit[batch->count++];
+	edit->offset = offset;
+	edit->remove = remove;
+	edit->len = len;
+	edit->nameoff = nameoff;
+	edit->prop = prop;
+	edit->data = data;
+	edit->data_len = data_len;
+
+	return 0;
+}
+
+/* Copy a small value into the batch, returns NULL if there is no room */
+static void *fdt_batch_copy(struct fdt_batch *batch, const void *val, int len)
+{
+	void *ptr = batch->buf + batch->buf_used;
+
+	if (len > FDT_BATCH_BUF_SIZE - batch->buf_used)
+		return NULL;
+	memcpy(ptr, val, len);
+	batch->buf_used += len;
+
+	return ptr;
+}
+
+/* Returns the offset of a name in the strings block, adding it if needed */
+static int fdt_batch_string(struct fdt_batch *batch, const char *name)
+{
+	const void *fdt = batch->fdt;
+	const char *strtab = fdt + fdt_off_dt_strings(fdt);
+	int size = fdt_size_dt_strings(fdt);
+	int len = strlen(name) + 1;
+	struct fdt_batch_edit *edit;
+	int i, err;
+
+	for (i = 0; i <= size - len; i++) {
+		if (!memcmp(strtab + i, name, len))
+			return i;
+	}
+	for (i = 0; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (!edit->prop && edit->nameoff >= 0 &&
+		    !strcmp(edit->data, name))
+			return edit->nameoff;
+	}
+
+	err = fdt_batch_add(batch, fdt_off_dt_strings(fdt) + size, 0, len,
+			    size + batch->strings_len, 0, name, len);
+	if (err)
+		return err;
+	batch->strings_len += len;
+
+	return size + batch->strings_len - len;
+}
+
+int fdt_batch_init(struct fdt_batch *batch, void *fdt)
+{
+	int err;
+
+	batch->fdt = fdt;
+	batch->count = 0;
+	batch->strings_len = 0;
+	batch->buf_used = 0;
+
+	err = fdt_check_header(fdt);
+	if (err)
+		return err;
+
+	/* Put the blocks in the order that fdt_batch_apply() expects */
+	if (fdt_version(fdt) < 17 ||
+	    fdt_off_mem_rsvmap(fdt) < ALIGN(sizeof(struct fdt_header), 8) ||
+	    fdt_off_dt_struct(fdt) < fdt_off_mem_rsvmap(fdt) ||
+	    fdt_off_dt_strings(fdt) <
+			fdt_off_dt_struct(fdt) + fdt_size_dt_struct(fdt) ||
+	    fdt_totalsize(fdt) <
+			fdt_off_dt_strings(fdt) + fdt_size_dt_strings(fdt))
+		return fdt_open_into(fdt, fdt, fdt_totalsize(fdt));
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len)
+{
+	const void *fdt = batch->fdt;
+	const struct fdt_property *prop;
+	struct fdt_batch_edit *edit;
+	int offset, remove, nameoff;
+	int oldlen, i;
+
+	prop = fdt_get_property(fdt, nodeoffset, name, &oldlen);
+	if (prop) {
+		offset = (const char *)prop - (const char *)fdt;
+		remove = sizeof(*prop) + ALIGN(oldlen, FDT_TAGSIZE);
+		nameoff = fdt32_to_cpu(prop->nameoff);
+	} else if (oldlen == -FDT_ERR_NOTFOUND) {
+		fdt_next_tag(fdt, nodeoffset, &offset);
+		offset += fdt_off_dt_struct(fdt);
+		remove = 0;
+		nameoff = fdt_batch_string(batch, name);
+		if (nameoff < 0)
+			return nameoff;
+	} else {
+		return oldlen;
+	}
+
+	/* A later change to a property replaces an earlier one */
+	for (i = 0; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (edit->prop && edit->offset == offset &&
+		    edit->nameoff == nameoff) {
+			edit->len = sizeof(*prop) + ALIGN(len, FDT_TAGSIZE);
+			edit->data = val;
+			edit->data_len = len;
+			return 0;
+		}
+	}
+
+	return fdt_batch_add(batch, offset, remove,
+			     sizeof(*prop) + ALIGN(len, FDT_TAGSIZE), nameoff,
+			     1, val, len);
+}
+
+int fdt_batch_subnode(struct fdt_batch *batch, int parentoffset,
+		      const char *name)
+{
+	int err;
+
+	if (fdt_subnode_offset(batch->fdt, parentoffset, name) ==
+			-FDT_ERR_NOTFOUND) {
+		err = fdt_batch_apply(batch);
+		if (err)
+			return err;
+	}
+
+	return fdt_find_or_add_subnode(batch->fdt, parentoffset, name);
+}
+
+int fdt_batch_add_mem_rsv(struct fdt_batch *batch, uint64_t address,
+			  uint64_t size)
+{
+	const void *fdt = batch->fdt;
+	struct fdt_reserve_entry re;
+	void *data;
+
+	re.address = cpu_to_fdt64(address);
+	re.size = cpu_to_fdt64(size);
+	data = fdt_batch_copy(batch, &re, sizeof(re));
+	if (!data)
+		return -FDT_ERR_NOSPACE;
+
+	/* Before the entry which ends the map */
+	return fdt_batch_add(batch, fdt_off_mem_rsvmap(fdt) +
+			     fdt_num_mem_rsv(fdt) * sizeof(re), 0, sizeof(re),
+			     -1, 0, data, sizeof(re));
+}
+
+int fdt_batch_del_mem_rsv(struct fdt_batch *batch, int n)
+{
+	const void *fdt = batch->fdt;
+	int offset, i;
+
+	if (n < 0 || n >= fdt_num_mem_rsv(fdt))
+		return -FDT_ERR_NOTFOUND;
+
+	offset = fdt_off_mem_rsvmap(fdt) + n * sizeof(struct fdt_reserve_entry);
+	for (i = 0; i < batch->count; i++) {
+		if (batch->edit[i].offset == offset && batch->edit[i].remove)
+			return 0;
+	}
+
+	return fdt_batch_add(batch, offset, sizeof(struct fdt_reserve_entry), 0,
+			     -1, 0, NULL, 0);
+}
+
+/* Sort order of changes: by offset, inserting before removing */
+static int fdt_batch_before(const struct fdt_batch_edit *a,
+			     const struct fdt_batch_edit *b)
+{
+	if (a->offset != b->offset)
+		return a->offset < b->offset;
+
+	return !a->remove && b->remove;
+}
+
+/*
+ * Move the part of the tree between a change and the next one, if it
+ * moves in the given direction
+ */
+static void fdt_batch_move(struct fdt_batch *batch, int i, int data_end,
+			   int up)
+{
+	struct fdt_batch_edit *edit = &batch->edit[i];
+	int start = edit->offset + edit->remove;
+	int end = i + 1 < batch->count ? edit[1].offset : data_end;
+	int shift = edit->shift + edit->len - edit->remove;
+
+	if (up ? shift > 0 : shift < 0)
+		memmove(batch->fdt + start + shift, batch->fdt + start,
+			end - start);
+}
+
+int fdt_batch_apply(struct fdt_batch *batch)
+{
+	void *fdt = batch->fdt;
+	struct fdt_batch_edit *edit, tmp;
+	struct fdt_property *prop;
+	int off_struct = fdt_off_dt_struct(fdt);
+	int off_strings = fdt_off_dt_strings(fdt);
+	int data_end = off_strings + fdt_size_dt_strings(fdt);
+	int rsv_delta = 0, struct_delta = 0, strings_delta = 0;
+	int shift, end, i, j;
+	int err = 0;
+
+	for (i = 1; i < batch->count; i++) {
+		tmp = batch->edit[i];
+		for (j = i; j && fdt_batch_before(&tmp, &batch->edit[j - 1]);
+		     j--)
+			batch->edit[j] = batch->edit[j - 1];
+		batch->edit[j] = tmp;
+	}
+
+	for (i = 0, shift = 0, end = 0; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (edit->offset < end) {
+			err = -FDT_ERR_BADOFFSET;
+			goto done;
+		}
+		end = edit->offset + edit->remove;
+		edit->shift = shift;
+		shift += edit->len - edit->remove;
+
+		if (edit->offset < off_struct)
+			rsv_delta += edit->len - edit->remove;
+		else if (edit->offset < off_strings)
+			struct_delta += edit->len - edit->remove;
+		else
+			strings_delta += edit->len - edit->remove;
+	}
+	if (data_end + shift > fdt_totalsize(fdt)) {
+		err = -FDT_ERR_NOSPACE;
+		goto done;
+	}
+
+	/*
+	 * Parts that move down cannot overwrite those before them which move
+	 * up, nor those after them, so move them first, then the others from
+	 * the end
+	 */
+	for (i = 0; i < batch->count; i++)
+		fdt_batch_move(batch, i, data_end, 0);
+	for (i = batch->count - 1; i >= 0; i--)
+		fdt_batch_move(batch, i, data_end, 1);
+
+	for (i = 0; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (!edit->prop) {
+			/* Nothing to copy when only removing */
+			if (edit->len)
+				memcpy(fdt + edit->offset + edit->shift,
+				       edit->data, edit->len);
+			continue;
+		}
+		prop = fdt + edit->offset + edit->shift;
+		prop->tag = cpu_to_fdt32(FDT_PROP);
+		prop->len = cpu_to_fdt32(edit->data_len);
+		prop->nameoff = cpu_to_fdt32(edit->nameoff);
+		memcpy(prop->data, edit->data, edit->data_len);
+		memset(prop->data + edit->data_len, '\0',
+		       edit->len - sizeof(*prop) - edit->data_len);
+	}
+
+	fdt_set_off_dt_struct(fdt, off_struct + rsv_delta);
+	fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + struct_delta);
+	fdt_set_off_dt_strings(fdt, off_strings + rsv_delta + struct_delta);
+	fdt_set_size_dt_strings(fdt, fdt_size_dt_strings(fdt) + strings_delta);
+	if (batch->count)
+		fdt_index_invalidate(fdt);
+
+done:
+	batch->count = 0;
+	batch->strings_len = 0;
+	batch->buf_used = 0;
+
+	return err;
+}
+
 /* rename to CONFIG_OF_STDOUT_PATH ? */
 #if defined(OF_STDOUT_PATH)
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch, int chosenoff)
 {
-	return fdt_setprop(fdt, chosenoff, "linux,stdout-path",
-			      OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
+	return fdt_batch_setprop(batch, chosenoff, "linux,stdout-path",
+				 OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
 }
 #elif defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
 static void fdt_fill_multisername(char *sername, size_t maxlen)
@@ -142,14 +439,15 @@ static void fdt_fill_multisername(char *sername, size_t maxlen)
 		strncpy(sername, outname + 1, maxlen);
 }
 
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch, int chosenoff)
 {
+	void *fdt = batch->fdt;
 	int err;
 	int aliasoff;
 	char sername[9] = { 0 };
 	const void *path;
+	void *tmp;
 	int len;
-	char tmp[256]; /* long enough */
 
 	fdt_fill_multisername(sername, sizeof(sername) - 1);
 	if (!sername[0])
@@ -167,10 +465,15 @@ static int fdt_fixup_stdout(void *fdt, int chosenoff)
 		goto error;
 	}
 
-	/* fdt_setprop may break "path" so we copy it to tmp buffer */
-	memcpy(tmp, path, len);
+	/* The batch moves "path" so we copy it to the batch */
+	tmp = fdt_batch_copy(batch, path, len);
+	if (!tmp) {
+		err = -FDT_ERR_NOSPACE;
+		goto error;
+	}
 
-	err = fdt_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
+	err = fdt_batch_setprop(batch, chosenoff, "linux,stdout-path", tmp,
+				len);
 error:
 	if (err < 0)
 		printf("WARNING: could not set linux,stdout-path %s.\n",
@@ -179,24 +482,33 @@ error:
 	return err;
 }
 #else
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch, int chosenoff)
 {
 	return 0;
 }
 #endif
 
-static inline int fdt_setprop_uxx(void *fdt, int nodeoffset, const char *name,
-				  uint64_t val, int is_u64)
+static int fdt_batch_setprop_uxx(struct fdt_batch *batch, int nodeoffset,
+				 const char *name, uint64_t val, int is_u64)
 {
-	if (is_u64)
-		return fdt_setprop_u64(fdt, nodeoffset, name, val);
-	else
-		return fdt_setprop_u32(fdt, nodeoffset, name, (uint32_t)val);
+	fdt64_t tmp64 = cpu_to_fdt64(val);
+	fdt32_t tmp32 = cpu_to_fdt32(val);
+	void *data;
+	int len;
+
+	len = is_u64 ? sizeof(tmp64) : sizeof(tmp32);
+	data = fdt_batch_copy(batch, is_u64 ? (void *)&tmp64 : &tmp32, len);
+	if (!data)
+		return -FDT_ERR_NOSPACE;
+
+	return fdt_batch_setprop(batch, nodeoffset, name, data, len);
 }
 
 
-int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
+int fdt_batch_initrd(struct fdt_batch *batch, ulong initrd_start,
+		     ulong initrd_end)
 {
+	void *fdt = batch->fdt;
 	int   nodeoffset;
 	int   err, j, total;
 	int is_u64;
@@ -207,7 +519,7 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 		return 0;
 
 	/* find or create "/chosen" node. */
-	nodeoffset = fdt_find_or_add_subnode(fdt, 0, "chosen");
+	nodeoffset = fdt_batch_subnode(batch, 0, "chosen");
 	if (nodeoffset < 0)
 		return nodeoffset;
 
@@ -220,12 +532,13 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 	for (j = 0; j < total; j++) {
 		err = fdt_get_mem_rsv(fdt, j, &addr, &size);
 		if (addr == initrd_start) {
-			fdt_del_mem_rsv(fdt, j);
+			fdt_batch_del_mem_rsv(batch, j);
 			break;
 		}
 	}
 
-	err = fdt_add_mem_rsv(fdt, initrd_start, initrd_end - initrd_start);
+	err = fdt_batch_add_mem_rsv(batch, initrd_start,
+				    initrd_end - initrd_start);
 	if (err < 0) {
 		printf("fdt_initrd: %s\n", fdt_strerror(err));
 		return err;
@@ -233,8 +546,8 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 
 	is_u64 = (fdt_address_cells(fdt, 0) == 2);
 
-	err = fdt_setprop_uxx(fdt, nodeoffset, "linux,initrd-start",
-			      (uint64_t)initrd_start, is_u64);
+	err = fdt_batch_setprop_uxx(batch, nodeoffset, "linux,initrd-start",
+				    (uint64_t)initrd_start, is_u64);
 
 	if (err < 0) {
 		printf("WARNING: could not set linux,initrd-start %s.\n",
@@ -242,8 +555,8 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 		return err;
 	}
 
-	err = fdt_setprop_uxx(fdt, nodeoffset, "linux,initrd-end",
-			      (uint64_t)initrd_end, is_u64);
+	err = fdt_batch_setprop_uxx(batch, nodeoffset, "linux,initrd-end",
+				    (uint64_t)initrd_end, is_u64);
 
 	if (err < 0) {
 		printf("WARNING: could not set linux,initrd-end %s.\n",
@@ -255,6 +568,25 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 	return 0;
 }
 
+int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
+{
+	struct fdt_batch batch;
+	int err;
+
+	err = fdt_batch_init(&batch, fdt);
+	if (err)
+		return err;
+	err = fdt_batch_initrd(&batch, initrd_start, initrd_end);
+	if (err)
+		return err;
+
+	err = fdt_batch_apply(&batch);
+	if (err < 0)
+		printf("fdt_initrd: %s\n", fdt_strerror(err));
+
+	return err;
+}
+
 #ifdef CONFIG_INSTABOOT
 #include <amlogic/instaboot.h>
 
@@ -331,25 +663,26 @@ int fdt_instaboot(void *fdt)
 
 int fdt_chosen(void *fdt)
 {
+	struct fdt_batch batch;
 	int   nodeoffset;
-	int   err;
+	int   err, stdout_err;
 	char  *str;		/* used to set string properties */
 
-	err = fdt_check_header(fdt);
+	err = fdt_batch_init(&batch, fdt);
 	if (err < 0) {
 		printf("fdt_chosen: %s\n", fdt_strerror(err));
 		return err;
 	}
 
 	/* find or create "/chosen" node. */
-	nodeoffset = fdt_find_or_add_subnode(fdt, 0, "chosen");
+	nodeoffset = fdt_batch_subnode(&batch, 0, "chosen");
 	if (nodeoffset < 0)
 		return nodeoffset;
 
 	str = getenv("bootargs");
 	if (str) {
-		err = fdt_setprop(fdt, nodeoffset, "bootargs", str,
-				  strlen(str) + 1);
+		err = fdt_batch_setprop(&batch, nodeoffset, "bootargs", str,
+					strlen(str) + 1);
 		if (err < 0) {
 			printf("WARNING: could not set bootargs %s.\n",
 			       fdt_strerror(err));
@@ -357,7 +690,16 @@ int fdt_chosen(void *fdt)
 		}
 	}
 
-	return fdt_fixup_stdout(fdt, nodeoffset);
+	/* fdt_fixup_stdout() warns on failure; bootargs is still set */
+	stdout_err = fdt_fixup_stdout(&batch, nodeoffset);
+
+	err = fdt_batch_apply(&batch);
+	if (err < 0) {
+		printf("fdt_chosen: %s\n", fdt_strerror(err));
+		return err;
+	}
+
+	return stdout_err;
 }
 
 void do_fixup_by_path(void *fdt, const char *path, const char *prop,
@@ -473,6 +815,7 @@ static int fdt_pack_reg(const void *fdt, void *buf, u64 *address, u64 *size,
 #endif
 int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 {
+	struct fdt_batch batch;
 	int err, nodeoffset;
 	int len;
 	u8 tmp[MEMORY_BANKS_MAX * 16]; /* Up to 64-bit address + 64-bit size */
@@ -484,19 +827,19 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 		return -1;
 	}
 
-	err = fdt_check_header(blob);
+	err = fdt_batch_init(&batch, blob);
 	if (err < 0) {
 		printf("%s: %s\n", __FUNCTION__, fdt_strerror(err));
 		return err;
 	}
 
 	/* find or create "/memory" node. */
-	nodeoffset = fdt_find_or_add_subnode(blob, 0, "memory");
+	nodeoffset = fdt_batch_subnode(&batch, 0, "memory");
 	if (nodeoffset < 0)
 			return nodeoffset;
 
-	err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
-			sizeof("memory"));
+	err = fdt_batch_setprop(&batch, nodeoffset, "device_type", "memory",
+				sizeof("memory"));
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n", "device_type",
 				fdt_strerror(err));
@@ -505,13 +848,18 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 
 	len = fdt_pack_reg(blob, tmp, start, size, banks);
 
-	err = fdt_setprop(blob, nodeoffset, "reg", tmp, len);
+	err = fdt_batch_setprop(&batch, nodeoffset, "reg", tmp, len);
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n",
 				"reg", fdt_strerror(err));
 		return err;
 	}
-	return 0;
+
+	err = fdt_batch_apply(&batch);
+	if (err < 0)
+		printf("%s: %s\n", __FUNCTION__, fdt_strerror(err));
+
+	return err;
 }
 
 int fdt_fixup_memory(void *blob, u64 start, u64 size)
@@ -519,13 +867,15 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 	return fdt_fixup_memory_banks(blob, &start, &size, 1);
 }
 
-void fdt_fixup_ethernet(void *fdt)
+void fdt_batch_fixup_ethernet(struct fdt_batch *batch)
 {
-	int node, i, j;
+	void *fdt = batch->fdt;
+	int node, i, j, off, err;
 	char enet[16], *tmp, *end;
 	char mac[16];
 	const char *path;
 	unsigned char mac_addr[6];
+	void *val;
 
 	node = fdt_path_offset(fdt, "/aliases");
 	if (node < 0)
@@ -558,17 +908,44 @@ void fdt_fixup_ethernet(void *fdt)
 				tmp = (*end) ? end+1 : end;
 		}
 
-		do_fixup_by_path(fdt, path, "mac-address", &mac_addr, 6, 0);
-		do_fixup_by_path(fdt, path, "local-mac-address",
-				&mac_addr, 6, 1);
+		val = fdt_batch_copy(batch, mac_addr, sizeof(mac_addr));
+		off = fdt_path_offset(fdt, path);
+		err = val ? 0 : -FDT_ERR_NOSPACE;
+		if (!err && off < 0)
+			err = off;
+		if (!err && fdt_get_property(fdt, off, "mac-address", NULL))
+			err = fdt_batch_setprop(batch, off, "mac-address",
+						val, 6);
+		if (!err)
+			err = fdt_batch_setprop(batch, off,
+						"local-mac-address", val, 6);
+		if (err)
+			printf("Unable to update property %s:%s, err=%s\n",
+			       path, "mac-address", fdt_strerror(err));
 
 		sprintf(mac, "eth%daddr", ++i);
 	}
 }
 
+void fdt_fixup_ethernet(void *fdt)
+{
+	struct fdt_batch batch;
+	int err;
+
+	err = fdt_batch_init(&batch, fdt);
+	if (err)
+		return;
+	fdt_batch_fixup_ethernet(&batch);
+
+	err = fdt_batch_apply(&batch);
+	if (err)
+		printf("%s: %s\n", __func__, fdt_strerror(err));
+}
+
 /* Resize the fdt to its actual size + a bit of padding */
 int fdt_shrink_to_minimum(void *blob)
 {
+	struct fdt_batch batch;
 	int i;
 	uint64_t addr, size;
 	int total, ret;
@@ -577,11 +954,15 @@ int fdt_shrink_to_minimum(void *blob)
 	if (!blob)
 		return 0;
 
+	ret = fdt_batch_init(&batch, blob);
+	if (ret < 0)
+		return ret;
+
 	total = fdt_num_mem_rsv(blob);
 	for (i = 0; i < total; i++) {
 		fdt_get_mem_rsv(blob, i, &addr, &size);
 		if (addr == (uintptr_t)blob) {
-			fdt_del_mem_rsv(blob, i);
+			fdt_batch_del_mem_rsv(&batch, i);
 			break;
 		}
 	}
@@ -594,6 +975,9 @@ int fdt_shrink_to_minimum(void *blob)
 	 */
 	actualsize = fdt_off_dt_strings(blob) +
 		fdt_size_dt_strings(blob) + 5 * sizeof(struct fdt_reserve_entry);
+	/* ...less the entry for the fdt, which is still in the map */
+	if (i < total)
+		actualsize -= sizeof(struct fdt_reserve_entry);
 
 	/* Make it so the fdt ends on a page boundary */
 	actualsize = ALIGN(actualsize + ((uintptr_t)blob & 0xfff), 0x1000);
@@ -602,8 +986,10 @@ int fdt_shrink_to_minimum(void *blob)
 	/* Change the fdt header to reflect the correct size */
 	fdt_set_totalsize(blob, actualsize);
 
-	/* Add the new reservation */
-	ret = fdt_add_mem_rsv(blob, (uintptr_t)blob, actualsize);
+	/* Replace the reservation, moving the tree at most once */
+	ret = fdt_batch_add_mem_rsv(&batch, (uintptr_t)blob, actualsize);
+	if (!ret)
+		ret = fdt_batch_apply(&batch);
 	if (ret < 0)
 		return ret;
 
@@ -103,7 +103,7 @@ void boot_fdt_add_mem_rsv_regions(struct lmb *lmb, void *fdt_blob)
  * boot_relocate_fdt() allocates a region of memory within the bootmap and
  * relocates the of_flat_tree into that region, even if the fdt is already in
  * the bootmap.  It also expands the size of the fdt by CONFIG_SYS_FDT_PAD
- * bytes.
+ * bytes, plus room for the boot arguments.
  *
  * of_flat_tree and of_size are set to final (after relocation) values
  *
@@ -116,6 +116,7 @@ int boot_relocate_fdt(struct lmb *lmb, char **of_flat_tree, ulong *of_size)
 	void	*fdt_blob = *of_flat_tree;
 	void	*of_start = NULL;
 	char	*fdt_high;
+	char	*bootargs;
 	ulong	of_len = 0;
 	int	err;
 	int	disable_relocation = 0;
@@ -133,6 +134,11 @@ int boot_relocate_fdt(struct lmb *lmb, char **of_flat_tree, ulong *of_size)
 	/* Pad the FDT by a specified amount */
 	of_len = *of_size + CONFIG_SYS_FDT_PAD;
 
+	/* ...and by the boot arguments, which fdt_chosen() adds later */
+	bootargs = getenv("bootargs");
+	if (bootargs)
+		of_len += ALIGN(strlen(bootargs) + 1, FDT_TAGSIZE);
+
 	/* If fdt_high is set use it to select the relocation address */
 	fdt_high = getenv("fdt_high");
 	if (fdt_high) {
@@ -493,6 +499,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 {
 	ulong *initrd_start = &images->initrd_start;
 	ulong *initrd_end = &images->initrd_end;
+	struct fdt_batch batch;
 	int ret = -EPERM;
 	int fdt_ret;
 
@@ -519,7 +526,24 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 			goto err;
 		}
 	}
-	fdt_fixup_ethernet(blob);
+#ifdef CONFIG_INSTABOOT
+	fdt_instaboot(blob);
+#endif
+
+	/*
+	 * Make the remaining fixups at once, and before shrinking so that
+	 * they can use the padding added by boot_relocate_fdt()
+	 */
+	fdt_ret = fdt_batch_init(&batch, blob);
+	if (!fdt_ret) {
+		fdt_batch_fixup_ethernet(&batch);
+		fdt_batch_initrd(&batch, *initrd_start, *initrd_end);
+		fdt_ret = fdt_batch_apply(&batch);
+	}
+	if (fdt_ret) {
+		printf("ERROR: fdt fixup failed: %s\n", fdt_strerror(fdt_ret));
+		goto err;
+	}
 
 	/* Delete the old LMB reservation */
 	lmb_free(lmb, (phys_addr_t)(u32)(uintptr_t)blob,
@@ -530,21 +554,12 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		goto err;
 	of_size = ret;
 
-	if (*initrd_start && *initrd_end) {
-		of_size += FDT_RAMDISK_OVERHEAD;
-		fdt_set_totalsize(blob, of_size);
-	}
 	/* Create a new LMB reservation */
 	lmb_reserve(lmb, (ulong)blob, of_size);
 
-	fdt_initrd(blob, *initrd_start, *initrd_end);
 	if (!ft_verify_fdt(blob))
 		goto err;
 
-#ifdef CONFIG_INSTABOOT
-	fdt_instaboot(blob);
-#endif
-
 #if defined(CONFIG_SOC_KEYSTONE)
 	if (IMAGE_OF_BOARD_SETUP)
 		ft_board_setup_ex(blob, gd->bd);
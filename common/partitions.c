@@ -3,6 +3,7 @@
 #include <linux/err.h>
 #include <partition_table.h>
 #include <libfdt.h>
+#include <fdt_index.h>
 #include <asm/arch/bl31_apis.h>
 
 extern int is_dtb_encrypt(unsigned char *buffer);
@@ -105,6 +106,10 @@ int get_partition_from_dts(unsigned char *buffer)
 	dt_addr = (char *)get_multi_dt_entry((unsigned long)buffer);
 #else
 	dt_addr = (char *)buffer;
+#endif
+#ifdef CONFIG_FDT_INDEX
+	/* Each partition is looked up by phandle */
+	fdt_index_build(dt_addr);
 #endif
 	nodeoffset = fdt_path_offset(dt_addr, "/partitions");
 	if (nodeoffset < 0)
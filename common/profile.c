@@ -0,0 +1,248 @@
+/*
+ * Sampling profiler, see include/profile.h
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <profile.h>
+#include <trace.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static u32 *prof_buf;		/* samples, see include/profile.h */
+static size_t prof_used;	/* words used in prof_buf */
+static unsigned int prof_lost;	/* samples dropped, buffer full */
+static unsigned int prof_depth;
+static unsigned int prof_hz;
+static int prof_running;
+
+#define PROF_WORDS	(CONFIG_SAMPLE_PROFILE_BUF_SIZE / sizeof(u32))
+
+int __weak profile_timer_start(unsigned int hz)
+{
+	return -ENOSYS;
+}
+
+void __weak profile_timer_stop(void)
+{
+}
+
+/* Offset of a run-time address from the start of the code, as linked */
+static u32 prof_offset(ulong addr)
+{
+	return addr - gd->reloc_off - CONFIG_SYS_TEXT_BASE;
+}
+
+void profile_sample(ulong pc, ulong fp, ulong sp)
+{
+	u32 *rec = prof_buf + prof_used;
+	ulong top = gd->start_addr_sp;
+	ulong *frame;
+	u32 n;
+
+	if (!prof_running)
+		return;
+	if (prof_used + 1 + prof_depth > PROF_WORDS) {
+		prof_lost++;
+		return;
+	}
+
+	rec[1] = prof_offset(pc);
+	n = 1;
+
+	/*
+	 * Follow the frame records { caller's fp, return address } for as
+	 * long as they stay in the stack and head towards its top. The
+	 * return address points after the call, so step back into it.
+	 */
+	while (n < prof_depth && fp > sp && fp + 2 * sizeof(ulong) <= top &&
+	       !(fp & (sizeof(ulong) - 1))) {
+		frame = (ulong *)fp;
+		if (!frame[1])
+			break;
+		rec[1 + n++] = prof_offset(frame[1] - 4);
+		sp = fp;
+		fp = frame[0];
+	}
+	rec[0] = n;
+
+	/* Make the sample visible only once it is complete */
+	barrier();
+	prof_used += 1 + n;
+}
+
+int profile_start(unsigned int hz, unsigned int depth)
+{
+	int ret;
+
+	profile_stop();
+	if (!hz)
+		return -EINVAL;
+	if (!prof_buf) {
+		prof_buf = malloc(PROF_WORDS * sizeof(u32));
+		if (!prof_buf)
+			return -ENOMEM;
+	}
+
+	prof_used = 0;
+	prof_lost = 0;
+	prof_depth = clamp(depth, 1U, (unsigned int)PROFILE_MAX_DEPTH);
+	prof_hz = hz;
+	prof_running = 1;
+
+	ret = profile_timer_start(hz);
+	if (ret)
+		prof_running = 0;
+
+	return ret;
+}
+
+void profile_stop(void)
+{
+	if (!prof_running)
+		return;
+
+	profile_timer_stop();
+	prof_running = 0;
+}
+
+/* Count the samples in the first "used" words of the buffer */
+static unsigned int prof_count(size_t used)
+{
+	unsigned int count = 0;
+	size_t pos;
+
+	for (pos = 0; pos < used; pos += 1 + prof_buf[pos])
+		count++;
+
+	return count;
+}
+
+void profile_print_stats(void)
+{
+	size_t used = prof_used;
+
+	printf("Profiling %s", prof_running ? "running" : "stopped");
+	if (prof_hz)
+		printf(", %u Hz, %u frames", prof_hz, prof_depth);
+	printf("\n");
+	printf("Samples:  %u\n", prof_buf ? prof_count(used) : 0);
+	printf("Lost:     %u\n", prof_lost);
+	printf("Buffer:   %#zx of %#zx bytes used\n", used * sizeof(u32),
+	       PROF_WORDS * sizeof(u32));
+}
+
+static const u32 *sort_buf;
+
+static int h_cmp_sample(const void *v1, const void *v2)
+{
+	const u32 *s1 = sort_buf + *(const u32 *)v1;
+	const u32 *s2 = sort_buf + *(const u32 *)v2;
+	u32 i;
+
+	if (s1[0] != s2[0])
+		return s1[0] < s2[0] ? -1 : 1;
+	for (i = 1; i <= s1[0]; i++) {
+		if (s1[i] != s2[i])
+			return s1[i] < s2[i] ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/* Offset of the function containing "offset", as far as we can tell */
+static u32 prof_func(u32 offset)
+{
+#ifdef CONFIG_KALLSYMS
+	unsigned long caddr;
+
+	if (symbol_lookup(offset + CONFIG_SYS_TEXT_BASE, &caddr))
+		return caddr - CONFIG_SYS_TEXT_BASE;
+#endif
+	return offset;
+}
+
+static void prof_print_func(u32 offset)
+{
+#ifdef CONFIG_KALLSYMS
+	unsigned long caddr;
+	const char *name;
+
+	name = symbol_lookup(offset + CONFIG_SYS_TEXT_BASE, &caddr);
+	if (name) {
+		puts(name);
+		return;
+	}
+#endif
+	printf("%#x", offset);
+}
+
+void profile_report(void)
+{
+	size_t used = prof_used;
+	unsigned int count, i, j, run;
+	u32 *buf, *idx;
+	size_t pos;
+
+	if (!prof_buf || !used) {
+		printf("No samples\n");
+		return;
+	}
+
+	/* Samples in the same functions are the same stack */
+	count = prof_count(used);
+	buf = malloc(used * sizeof(u32));
+	idx = malloc(count * sizeof(u32));
+	if (!buf || !idx) {
+		printf("Out of memory\n");
+		goto out;
+	}
+	for (pos = 0, i = 0; pos < used; pos += 1 + buf[pos], i++) {
+		idx[i] = pos;
+		buf[pos] = prof_buf[pos];
+		for (j = 1; j <= buf[pos]; j++)
+			buf[pos + j] = prof_func(prof_buf[pos + j]);
+	}
+
+	sort_buf = buf;
+	qsort(idx, count, sizeof(*idx), h_cmp_sample);
+
+	for (i = 0; i < count; i += run) {
+		const u32 *rec = buf + idx[i];
+
+		for (run = 1; i + run < count; run++) {
+			if (h_cmp_sample(&idx[i], &idx[i + run]))
+				break;
+		}
+		for (j = rec[0]; j > 0; j--) {
+			prof_print_func(rec[j]);
+			putc(j > 1 ? ';' : ' ');
+		}
+		printf("%u\n", run);
+	}
+
+out:
+	free(idx);
+	free(buf);
+}
+
+int profile_dump(void *buff, size_t buff_size, size_t *needed)
+{
+	size_t used = prof_used;
+	struct trace_output_hdr hdr;
+
+	*needed = sizeof(hdr) + used * sizeof(u32);
+	if (*needed > buff_size)
+		return -ENOSPC;
+
+	hdr.type = TRACE_CHUNK_SAMPLES;
+	hdr.rec_count = prof_buf ? prof_count(used) : 0;
+	memcpy(buff, &hdr, sizeof(hdr));
+	if (used)
+		memcpy(buff + sizeof(hdr), prof_buf, used * sizeof(u32));
+
+	return 0;
+}
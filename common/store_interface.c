@@ -1819,13 +1819,18 @@ static cmd_tbl_t cmd_store_sub[] = {
 static int do_store(cmd_tbl_t * cmdtp, int flag, int argc, char * const argv[])
 {
     cmd_tbl_t *c;
+    ulong start;
+    int ret;
 
     if (argc < 2) return CMD_RET_USAGE;
 
     c = find_cmd_tbl(argv[1], cmd_store_sub, ARRAY_SIZE(cmd_store_sub));
 
 	if (c) {
-        return	c->cmd(cmdtp, flag, argc, argv);
+        start = bootstage_span_start();
+        ret = c->cmd(cmdtp, flag, argc, argv);
+        bootstage_span("store", c->name, 0, start);
+        return ret;
     }
 
     return CMD_RET_USAGE;
@@ -63,6 +63,11 @@ ifdef FTRACE
 PLATFORM_CPPFLAGS += -finstrument-functions -DFTRACE
 endif
 
+# The sampling profiler follows frame pointers to find the callers
+ifdef CONFIG_SAMPLE_PROFILE
+PLATFORM_CPPFLAGS += -fno-omit-frame-pointer
+endif
+
 # Allow use of stdint.h if available
 ifneq ($(USE_STDINT),)
 PLATFORM_CPPFLAGS += -DCONFIG_USE_STDINT
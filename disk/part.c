@@ -251,6 +251,11 @@ void dev_print (block_dev_desc_t *dev_desc)
 
 void init_part(block_dev_desc_t *dev_desc)
 {
+#ifdef CONFIG_EFI_PARTITION
+	/* The device was (re)scanned, forget any GPT read from it before */
+	part_efi_invalidate_cache(dev_desc);
+#endif
+
 #ifdef CONFIG_ISO_PARTITION
 	if (test_part_iso(dev_desc) == 0) {
 		dev_desc->part_type = PART_TYPE_ISO;
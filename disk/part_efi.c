@@ -172,21 +172,107 @@ static void prepare_backup_gpt_header(gpt_header *gpt_h)
 
 #ifdef CONFIG_EFI_PARTITION
 /*
- * Public Functions (include/part.h)
+ * Validated GPTs are kept per block device, so that repeated partition
+ * lookups (fastboot, 'part' commands in scripts, ...) do not re-read and
+ * re-check the header and the whole entry array with its CRC every time.
+ * Entries are matched on the device descriptor and its geometry, and are
+ * dropped whenever the GPT is written or the device is (re)scanned.
  */
+#define GPT_CACHE_ENTRIES	4
 
-void print_part_efi(block_dev_desc_t * dev_desc)
+struct gpt_name_idx {
+	char name[PARTNAME_SZ + 1];
+	int part;
+};
+
+struct gpt_cache {
+	block_dev_desc_t *dev_desc;	/* NULL if the slot is unused */
+	lbaint_t lba;
+	unsigned long blksz;
+	gpt_header gpt_head;
+	gpt_entry *gpt_pte;
+	int nparts;			/* leading valid entries */
+	int nnames;			/* entries in @names */
+	struct gpt_name_idx *names;	/* sorted by name, then number */
+};
+
+static struct gpt_cache gpt_cache[GPT_CACHE_ENTRIES];
+static int gpt_cache_next;
+
+static void gpt_cache_free(struct gpt_cache *gc)
+{
+	free(gc->gpt_pte);
+	free(gc->names);
+	memset(gc, 0, sizeof(*gc));
+}
+
+void part_efi_invalidate_cache(block_dev_desc_t *dev_desc)
+{
+	int i;
+
+	for (i = 0; i < GPT_CACHE_ENTRIES; i++) {
+		if (gpt_cache[i].dev_desc &&
+		    (!dev_desc || gpt_cache[i].dev_desc == dev_desc))
+			gpt_cache_free(&gpt_cache[i]);
+	}
+}
+
+/*
+ * gpt_cache_index_names(): build the sorted name index of a cached GPT
+ *
+ * Only the entries get_partition_info_efi_by_name() ever looked at are
+ * indexed: the valid ones before the first unused entry, up to
+ * GPT_ENTRY_NUMBERS - 1. Insertion sort keeps duplicate names in
+ * partition order, so a lookup still finds the lowest numbered one.
+ */
+static int gpt_cache_index_names(struct gpt_cache *gc)
+{
+	struct gpt_name_idx tmp;
+	int i, j;
+
+	gc->nnames = min(gc->nparts, GPT_ENTRY_NUMBERS - 1);
+	if (!gc->nnames)
+		return 0;
+
+	gc->names = malloc(gc->nnames * sizeof(*gc->names));
+	if (!gc->names)
+		return -1;
+
+	for (i = 0; i < gc->nnames; i++) {
+		strcpy(tmp.name, print_efiname(&gc->gpt_pte[i]));
+		tmp.part = i + 1;
+
+		for (j = i; j > 0 && strcmp(gc->names[j - 1].name,
+					    tmp.name) > 0; j--)
+			gc->names[j] = gc->names[j - 1];
+		gc->names[j] = tmp;
+	}
+
+	return 0;
+}
+
+/*
+ * gpt_cache_get(): return the validated GPT of a device
+ *
+ * Reads and validates the primary GPT, falling back to the backup one,
+ * unless a cached copy for @dev_desc exists already.
+ *
+ * Returns: the cache entry, or NULL if no valid GPT could be read.
+ */
+static struct gpt_cache *gpt_cache_get(block_dev_desc_t *dev_desc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
 	gpt_entry *gpt_pte = NULL;
-	int i = 0;
-	char uuid[37];
-	unsigned char *uuid_bin;
+	struct gpt_cache *gc;
+	int i;
 
-	if (!dev_desc) {
-		printf("%s: Invalid Argument(s)\n", __func__);
-		return;
+	for (i = 0; i < GPT_CACHE_ENTRIES; i++) {
+		gc = &gpt_cache[i];
+		if (gc->dev_desc == dev_desc && gc->lba == dev_desc->lba &&
+		    gc->blksz == dev_desc->blksz)
+			return gc;
 	}
+
 	/* This function validates AND fills in the GPT header and PTE */
 	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
 			 gpt_head, &gpt_pte) != 1) {
@@ -195,13 +281,80 @@ void print_part_efi(block_dev_desc_t * dev_desc)
 				 gpt_head, &gpt_pte) != 1) {
 			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
 			       __func__);
-			return;
+			return NULL;
 		} else {
 			printf("%s: ***        Using Backup GPT ***\n",
 			       __func__);
 		}
 	}
 
+	gc = &gpt_cache[gpt_cache_next];
+	gpt_cache_next = (gpt_cache_next + 1) % GPT_CACHE_ENTRIES;
+	gpt_cache_free(gc);
+
+	memcpy(&gc->gpt_head, gpt_head, sizeof(gc->gpt_head));
+	gc->gpt_pte = gpt_pte;
+	while (gc->nparts < le32_to_cpu(gpt_head->num_partition_entries) &&
+	       is_pte_valid(&gpt_pte[gc->nparts]))
+		gc->nparts++;
+
+	if (gpt_cache_index_names(gc)) {
+		printf("GPT: Failed to allocate memory for name index\n");
+		gpt_cache_free(gc);
+		return NULL;
+	}
+
+	gc->dev_desc = dev_desc;
+	gc->lba = dev_desc->lba;
+	gc->blksz = dev_desc->blksz;
+
+	return gc;
+}
+
+static void gpt_fill_part_info(block_dev_desc_t *dev_desc, gpt_entry *pte,
+			       disk_partition_t *info)
+{
+	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
+	info->start = (lbaint_t)le64_to_cpu(pte->starting_lba);
+	/* The ending LBA is inclusive, to calculate size, add 1 to it */
+	info->size = (lbaint_t)le64_to_cpu(pte->ending_lba) + 1
+		     - info->start;
+	info->blksz = dev_desc->blksz;
+
+	sprintf((char *)info->name, "%s", print_efiname(pte));
+	sprintf((char *)info->type, "U-Boot");
+	info->bootable = is_bootable(pte);
+#ifdef CONFIG_PARTITION_UUIDS
+	uuid_bin_to_str(pte->unique_partition_guid.b, info->uuid,
+			UUID_STR_FORMAT_GUID);
+#endif
+
+	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
+	      info->start, info->size, info->name);
+}
+
+/*
+ * Public Functions (include/part.h)
+ */
+
+void print_part_efi(block_dev_desc_t * dev_desc)
+{
+	struct gpt_cache *gc;
+	gpt_entry *gpt_pte;
+	int i = 0;
+	char uuid[37];
+	unsigned char *uuid_bin;
+
+	if (!dev_desc) {
+		printf("%s: Invalid Argument(s)\n", __func__);
+		return;
+	}
+
+	gc = gpt_cache_get(dev_desc);
+	if (!gc)
+		return;
+	gpt_pte = gc->gpt_pte;
+
 	debug("%s: gpt-entry at %p\n", __func__, gpt_pte);
 
 	printf("Part\tStart LBA\tEnd LBA\t\tName\n");
@@ -209,11 +362,7 @@ void print_part_efi(block_dev_desc_t * dev_desc)
 	printf("\tType GUID\n");
 	printf("\tPartition GUID\n");
 
-	for (i = 0; i < le32_to_cpu(gpt_head->num_partition_entries); i++) {
-		/* Stop at the first non valid PTE */
-		if (!is_pte_valid(&gpt_pte[i]))
-			break;
-
+	for (i = 0; i < gc->nparts; i++) {
 		printf("%3d\t0x%08llx\t0x%08llx\t\"%s\"\n", (i + 1),
 			le64_to_cpu(gpt_pte[i].starting_lba),
 			le64_to_cpu(gpt_pte[i].ending_lba),
@@ -226,17 +375,12 @@ void print_part_efi(block_dev_desc_t * dev_desc)
 		uuid_bin_to_str(uuid_bin, uuid, UUID_STR_FORMAT_GUID);
 		printf("\tguid:\t%s\n", uuid);
 	}
-
-	/* Remember to free pte */
-	free(gpt_pte);
-	return;
 }
 
 int get_partition_info_efi(block_dev_desc_t * dev_desc, int part,
 				disk_partition_t * info)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
-	gpt_entry *gpt_pte = NULL;
+	struct gpt_cache *gc;
 
 	/* "part" argument must be at least 1 */
 	if (!dev_desc || !info || part < 1) {
@@ -244,70 +388,56 @@ int get_partition_info_efi(block_dev_desc_t * dev_desc, int part,
 		return -1;
 	}
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
-			gpt_head, &gpt_pte) != 1) {
-		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
-		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
-				 gpt_head, &gpt_pte) != 1) {
-			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
-			       __func__);
-			return -1;
-		} else {
-			printf("%s: ***        Using Backup GPT ***\n",
-			       __func__);
-		}
-	}
+	gc = gpt_cache_get(dev_desc);
+	if (!gc)
+		return -1;
 
-	if (part > le32_to_cpu(gpt_head->num_partition_entries) ||
-	    !is_pte_valid(&gpt_pte[part - 1])) {
+	if (part > le32_to_cpu(gc->gpt_head.num_partition_entries) ||
+	    !is_pte_valid(&gc->gpt_pte[part - 1])) {
 		debug("%s: *** ERROR: Invalid partition number %d ***\n",
 			__func__, part);
-		free(gpt_pte);
 		return -1;
 	}
 
-	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
-	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
-	/* The ending LBA is inclusive, to calculate size, add 1 to it */
-	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
-		     - info->start;
-	info->blksz = dev_desc->blksz;
-
-	sprintf((char *)info->name, "%s",
-			print_efiname(&gpt_pte[part - 1]));
-	sprintf((char *)info->type, "U-Boot");
-	info->bootable = is_bootable(&gpt_pte[part - 1]);
-#ifdef CONFIG_PARTITION_UUIDS
-	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
-			UUID_STR_FORMAT_GUID);
-#endif
-
-	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
-	      info->start, info->size, info->name);
-
-	/* Remember to free pte */
-	free(gpt_pte);
+	gpt_fill_part_info(dev_desc, &gc->gpt_pte[part - 1], info);
 	return 0;
 }
 
 int get_partition_info_efi_by_name(block_dev_desc_t *dev_desc,
 	const char *name, disk_partition_t *info)
 {
-	int ret;
-	int i;
-	for (i = 1; i < GPT_ENTRY_NUMBERS; i++) {
-		ret = get_partition_info_efi(dev_desc, i, info);
-		if (ret != 0) {
-			/* no more entries in table */
-			return -1;
-		}
-		if (strcmp(name, (const char *)info->name) == 0) {
-			/* matched */
-			return 0;
-		}
+	struct gpt_cache *gc;
+	int lo, hi, mid;
+
+	if (!dev_desc || !name || !info) {
+		printf("%s: Invalid Argument(s)\n", __func__);
+		return -1;
+	}
+
+	gc = gpt_cache_get(dev_desc);
+	if (!gc)
+		return -1;
+
+	/* Find the first (lowest numbered) entry called @name */
+	lo = 0;
+	hi = gc->nnames;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(gc->names[mid].name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < gc->nnames && strcmp(gc->names[lo].name, name) == 0) {
+		/* matched */
+		gpt_fill_part_info(dev_desc,
+				   &gc->gpt_pte[gc->names[lo].part - 1], info);
+		return 0;
 	}
-	return -2;
+
+	/* -1 if we ran into the end of the table, -2 if it was full */
+	return gc->nnames < GPT_ENTRY_NUMBERS - 1 ? -1 : -2;
 }
 
 int test_part_efi(block_dev_desc_t * dev_desc)
@@ -362,6 +492,8 @@ int write_gpt_table(block_dev_desc_t *dev_desc,
 	u32 calc_crc32;
 
 	debug("max lba: %x\n", (u32) dev_desc->lba);
+	part_efi_invalidate_cache(dev_desc);
+
 	/* Setup the Protective MBR */
 	if (set_protective_mbr(dev_desc) < 0)
 		goto err;
@@ -580,6 +712,8 @@ int write_mbr_and_gpt_partitions(block_dev_desc_t *dev_desc, void *buf)
 	if (is_valid_gpt_buf(dev_desc, buf))
 		return -1;
 
+	part_efi_invalidate_cache(dev_desc);
+
 	/* determine start of GPT Header in the buffer */
 	gpt_h = buf + (GPT_PRIMARY_PARTITION_TABLE_LBA *
 		       dev_desc->blksz);
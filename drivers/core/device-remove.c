@@ -167,6 +167,7 @@ int device_remove(struct udevice *dev)
 
 	device_free(dev);
 
+	uclass_unhash_device(dev, DM_HASH_SEQ);
 	dev->seq = -1;
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
@@ -24,11 +24,25 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#ifdef CONFIG_DM_PROBE_TIMES
+/* Total time of the probes done so far, to leave out of their callers' */
+static ulong probe_nested_us;
+
+static void device_probe_time(struct udevice *dev, ulong start, ulong nested)
+{
+	ulong total = timer_get_us() - start;
+
+	dev->probe_us = total - (probe_nested_us - nested);
+	probe_nested_us = nested + total;
+}
+#endif
+
 int device_bind(struct udevice *parent, struct driver *drv, const char *name,
 		void *platdata, int of_offset, struct udevice **devp)
 {
 	struct udevice *dev;
 	struct uclass *uc;
+	int type;
 	int ret = 0;
 
 	*devp = NULL;
@@ -46,6 +60,8 @@ int device_bind(struct udevice *parent, struct driver *drv, const char *name,
 	INIT_LIST_HEAD(&dev->sibling_node);
 	INIT_LIST_HEAD(&dev->child_head);
 	INIT_LIST_HEAD(&dev->uclass_node);
+	for (type = 0; type < DM_HASH_COUNT; type++)
+		INIT_HLIST_NODE(&dev->hash_node[type]);
 	dev->platdata = platdata;
 	dev->name = name;
 	dev->of_offset = of_offset;
@@ -124,6 +140,10 @@ int device_bind_by_name(struct udevice *parent, bool pre_reloc_only,
 int device_probe_child(struct udevice *dev, void *parent_priv)
 {
 	struct driver *drv;
+	ulong start;
+#ifdef CONFIG_DM_PROBE_TIMES
+	ulong probe_start, nested;
+#endif
 	int size = 0;
 	int ret;
 	int seq;
@@ -186,7 +206,13 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_hash_device(dev, DM_HASH_SEQ);
 
+	start = bootstage_span_start();
+#ifdef CONFIG_DM_PROBE_TIMES
+	probe_start = timer_get_us();
+	nested = probe_nested_us;
+#endif
 	if (dev->parent && dev->parent->driver->child_pre_probe) {
 		ret = dev->parent->driver->child_pre_probe(dev);
 		if (ret)
@@ -212,6 +238,10 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 		dev->flags &= ~DM_FLAG_ACTIVATED;
 		goto fail_uclass;
 	}
+	bootstage_span(dev->uclass->uc_drv->name, dev->name, 0, start);
+#ifdef CONFIG_DM_PROBE_TIMES
+	device_probe_time(dev, probe_start, nested);
+#endif
 
 	return 0;
 fail_uclass:
@@ -220,6 +250,7 @@ fail_uclass:
 			__func__, dev->name);
 	}
 fail:
+	uclass_unhash_device(dev, DM_HASH_SEQ);
 	dev->seq = -1;
 	device_free(dev);
 
@@ -261,6 +292,13 @@ void *dev_get_parentdata(struct udevice *dev)
 	return dev->parent_priv;
 }
 
+void dev_set_of_offset(struct udevice *dev, int of_offset)
+{
+	uclass_unhash_device(dev, DM_HASH_OF_OFFSET);
+	dev->of_offset = of_offset;
+	uclass_hash_device(dev, DM_HASH_OF_OFFSET);
+}
+
 static int device_get_device_tail(struct udevice *dev, int ret,
 				  struct udevice **devp)
 {
@@ -16,8 +16,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -93,6 +96,154 @@ int device_bind_driver(struct udevice *parent, const char *drv_name,
 }
 
 #ifdef CONFIG_OF_CONTROL
+/**
+ * struct dm_compat_entry - A compatible string supported by a driver
+ *
+ * @of_id: Compatible string and its data
+ * @drv: Driver which supports it
+ * @next: Index of the next entry in the same hash chain, or -1
+ */
+struct dm_compat_entry {
+	const struct udevice_id *of_id;
+	struct driver *drv;
+	int next;
+};
+
+/**
+ * struct dm_compat_index - All drivers' compatible strings, hashed
+ *
+ * The entries are in linker-list order of drivers, then of_match order, and
+ * so are the hash chains. So the earliest entry that matches a node is the
+ * one that a search of the drivers would find.
+ *
+ * @mask: Number of hash chains - 1
+ * @head: First entry of each hash chain, or -1
+ * @entry: The entries
+ */
+struct dm_compat_index {
+	uint mask;
+	int *head;
+	struct dm_compat_entry entry[];
+};
+
+static uint lists_compat_hash(const char *str)
+{
+	uint hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + (unsigned char)*str++;
+
+	return hash;
+}
+
+/**
+ * lists_compat_index() - Get the compatible-string index
+ *
+ * The index is built on first use after relocation, since the drivers do
+ * not change after that. Before relocation there is too little memory for
+ * it, and few enough nodes to bind that it does not matter.
+ *
+ * @return the index, or NULL if there is none
+ */
+static struct dm_compat_index *lists_compat_index(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_id;
+	struct dm_compat_index *idx;
+	struct dm_compat_entry *entry;
+	struct driver *drv;
+	int count = 0;
+	uint size, hash;
+	int i;
+
+	if (gd->dm_compat || !(gd->flags & GD_FLG_RELOC))
+		return gd->dm_compat;
+
+	for (drv = driver; drv != driver + n_ents; drv++) {
+		of_id = drv->of_match;
+		for (; of_id && of_id->compatible; of_id++)
+			count++;
+	}
+	for (size = 1; size < count; size <<= 1)
+		;
+
+	idx = malloc(sizeof(*idx) + count * sizeof(*entry) +
+		     size * sizeof(int));
+	if (!idx)
+		return NULL;
+	idx->mask = size - 1;
+	idx->head = (int *)(idx->entry + count);
+	memset(idx->head, 0xff, size * sizeof(int));
+
+	entry = idx->entry;
+	for (drv = driver; drv != driver + n_ents; drv++) {
+		of_id = drv->of_match;
+		for (; of_id && of_id->compatible; of_id++) {
+			entry->of_id = of_id;
+			entry->drv = drv;
+			entry++;
+		}
+	}
+
+	/* Add the entries last to first, so each chain is in order */
+	for (i = count - 1; i >= 0; i--) {
+		entry = &idx->entry[i];
+		hash = lists_compat_hash(entry->of_id->compatible) & idx->mask;
+		entry->next = idx->head[hash];
+		idx->head[hash] = i;
+	}
+	gd->dm_compat = idx;
+
+	return idx;
+}
+
+/**
+ * lists_compat_lookup() - Find the driver for a node using the index
+ *
+ * @idx:	Compatible-string index
+ * @blob:	Device tree pointer
+ * @offset:	Offset of node in device tree
+ * @drvp:	Returns the driver that was found
+ * @of_idp:	Returns the match that was found
+ * @return 0 if there is a match, -ENOENT if no match, -ENODEV if the node
+ * does not have a compatible string, other error <0 if there is a device
+ * tree error
+ */
+static int lists_compat_lookup(struct dm_compat_index *idx, const void *blob,
+			       int offset, struct driver **drvp,
+			       const struct udevice_id **of_idp)
+{
+	const struct dm_compat_entry *entry, *best = NULL;
+	const char *compat, *end;
+	int len, i;
+
+	compat = fdt_getprop(blob, offset, "compatible", &len);
+	if (!compat)
+		return len == -FDT_ERR_NOTFOUND ? -ENODEV : -EINVAL;
+
+	for (end = compat + len; compat < end; compat += len + 1) {
+		len = strnlen(compat, end - compat);
+		if (compat + len == end)
+			break;
+		i = idx->head[lists_compat_hash(compat) & idx->mask];
+		for (; i != -1; i = entry->next) {
+			entry = &idx->entry[i];
+			if (!strcmp(entry->of_id->compatible, compat)) {
+				if (!best || entry < best)
+					best = entry;
+				break;
+			}
+		}
+	}
+	if (!best)
+		return -ENOENT;
+	*drvp = best->drv;
+	*of_idp = best->of_id;
+
+	return 0;
+}
+
 /**
  * driver_check_compatible() - Check if a driver is compatible with this node
  *
@@ -131,56 +282,76 @@ static int driver_check_compatible(const void *blob, int offset,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
-		   struct udevice **devp)
+/**
+ * lists_driver_lookup_fdt() - Find the driver for a node by searching them
+ *
+ * @blob:	Device tree pointer
+ * @offset:	Offset of node in device tree
+ * @drvp:	Returns the driver that was found
+ * @of_idp:	Returns the match that was found
+ * @return as for lists_compat_lookup()
+ */
+static int lists_driver_lookup_fdt(const void *blob, int offset,
+				   struct driver **drvp,
+				   const struct udevice_id **of_idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+	int ret = -ENOENT;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		ret = driver_check_compatible(blob, offset, entry->of_match,
+					      of_idp);
+		if (ret != -ENOENT)
+			break;
+	}
+	if (!ret)
+		*drvp = entry;
+
+	return ret;
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
+		   struct udevice **devp)
+{
+	struct dm_compat_index *idx;
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
-	bool found = false;
 	const char *name;
-	int result = 0;
-	int ret = 0;
+	int ret;
 
 	dm_dbg("bind node %s\n", fdt_get_name(blob, offset, NULL));
 	if (devp)
 		*devp = NULL;
-	for (entry = driver; entry != driver + n_ents; entry++) {
-		ret = driver_check_compatible(blob, offset, entry->of_match,
-					      &id);
-		name = fdt_get_name(blob, offset, NULL);
-		if (ret == -ENOENT) {
-			continue;
-		} else if (ret == -ENODEV) {
-			dm_dbg("Device '%s' has no compatible string\n", name);
-			break;
-		} else if (ret) {
-			dm_warn("Device tree error at offset %d\n", offset);
-			result = ret;
-			break;
-		}
-
-		dm_dbg("   - found match at '%s'\n", entry->name);
-		ret = device_bind(parent, entry, name, NULL, offset, &dev);
-		if (ret) {
-			dm_warn("Error binding driver '%s'\n", entry->name);
-			return ret;
-		} else {
-			dev->of_id = id;
-			found = true;
-			if (devp)
-				*devp = dev;
-		}
-		break;
+	idx = lists_compat_index();
+	if (idx)
+		ret = lists_compat_lookup(idx, blob, offset, &entry, &id);
+	else
+		ret = lists_driver_lookup_fdt(blob, offset, &entry, &id);
+	name = fdt_get_name(blob, offset, NULL);
+	if (ret == -ENOENT) {
+		dm_dbg("No match for node '%s'\n", name);
+		return 0;
+	} else if (ret == -ENODEV) {
+		dm_dbg("Device '%s' has no compatible string\n", name);
+		return 0;
+	} else if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
 	}
 
-	if (!found && !result && ret != -ENODEV) {
-		dm_dbg("No match for node '%s'\n",
-		       fdt_get_name(blob, offset, NULL));
+	dm_dbg("   - found match at '%s'\n", entry->name);
+	ret = device_bind(parent, entry, name, NULL, offset, &dev);
+	if (ret) {
+		dm_warn("Error binding driver '%s'\n", entry->name);
+		return ret;
 	}
+	dev->of_id = id;
+	if (devp)
+		*devp = dev;
 
-	return result;
+	return 0;
 }
 #endif
@@ -17,6 +17,7 @@
 #include <dm/platdata.h>
 #include <dm/root.h>
 #include <dm/uclass.h>
+#include <dm/uclass-internal.h>
 #include <dm/util.h>
 #include <linux/list.h>
 
@@ -46,6 +47,15 @@ int dm_init(void)
 	}
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
 
+	/* Pre-relocation memory is too small for the lookup tables */
+	if (gd->flags & GD_FLG_RELOC) {
+		if (!gd->dm_index)
+			gd->dm_index = malloc(sizeof(*gd->dm_index));
+		if (!gd->dm_index)
+			return -ENOMEM;
+		memset(gd->dm_index, '\0', sizeof(*gd->dm_index));
+	}
+
 	ret = device_bind_by_name(NULL, false, &root_info, &DM_ROOT_NON_CONST);
 	if (ret)
 		return ret;
@@ -25,11 +25,12 @@ struct uclass *uclass_find(enum uclass_id key)
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	if (gd->dm_index) {
+		if (key < 0 || key >= UCLASS_COUNT)
+			return NULL;
+		return gd->dm_index->uclass[key];
+	}
+
 	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -38,6 +39,79 @@ struct uclass *uclass_find(enum uclass_id key)
 	return NULL;
 }
 
+/* Returns the key of a device in a lookup table */
+static int uclass_hash_key(struct udevice *dev, enum dm_hash_type type)
+{
+	switch (type) {
+	case DM_HASH_SEQ:
+		return dev->seq;
+	case DM_HASH_REQ_SEQ:
+		return dev->req_seq;
+	case DM_HASH_OF_OFFSET:
+	default:
+		return dev->of_offset;
+	}
+}
+
+static struct hlist_head *uclass_hash_head(enum uclass_id id,
+					   enum dm_hash_type type, int key)
+{
+	u32 hash = ((u32)key ^ ((u32)id << 24)) * 0x9e3779b1;
+
+	return &gd->dm_index->hash[type][hash >> (32 - DM_HASH_BITS)];
+}
+
+void uclass_hash_device(struct udevice *dev, enum dm_hash_type type)
+{
+	struct hlist_node *node = &dev->hash_node[type];
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	int key;
+
+	key = uclass_hash_key(dev, type);
+	if (!gd->dm_index || key == -1)
+		return;
+
+	/* Add at the end, so that lookups find the first-bound device */
+	head = uclass_hash_head(dev->uclass->uc_drv->id, type, key);
+	if (!head->first) {
+		hlist_add_head(node, head);
+		return;
+	}
+	for (pos = head->first; pos->next; pos = pos->next)
+		;
+	hlist_add_after(pos, node);
+}
+
+void uclass_unhash_device(struct udevice *dev, enum dm_hash_type type)
+{
+	hlist_del_init(&dev->hash_node[type]);
+}
+
+/**
+ * uclass_hash_find() - Look up a device in a lookup table
+ *
+ * @id: Uclass of the device
+ * @type: Table to search (DM_HASH_...)
+ * @key: Key to look for
+ * @return the first device bound in the uclass with that key, or NULL
+ */
+static struct udevice *uclass_hash_find(enum uclass_id id,
+					enum dm_hash_type type, int key)
+{
+	struct hlist_node *node;
+	struct udevice *dev;
+
+	hlist_for_each(node, uclass_hash_head(id, type, key)) {
+		dev = container_of(node - type, struct udevice, hash_node[0]);
+		if (dev->uclass->uc_drv->id == id &&
+		    uclass_hash_key(dev, type) == key)
+			return dev;
+	}
+
+	return NULL;
+}
+
 /**
  * uclass_add() - Create new uclass in list
  * @id: Id number to create
@@ -74,6 +148,8 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+	if (gd->dm_index)
+		gd->dm_index->uclass[id] = uc;
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -90,6 +166,8 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+	if (gd->dm_index)
+		gd->dm_index->uclass[id] = NULL;
 fail_mem:
 	free(uc);
 
@@ -115,6 +193,8 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	if (gd->dm_index)
+		gd->dm_index->uclass[uc_drv->id] = NULL;
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
 	free(uc);
@@ -171,6 +251,16 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+	if (gd->dm_index) {
+		dev = uclass_hash_find(id, find_req_seq ? DM_HASH_REQ_SEQ :
+				       DM_HASH_SEQ, seq_or_req_seq);
+		if (!dev)
+			goto not_found;
+		*devp = dev;
+		debug("   - found\n");
+		return 0;
+	}
+
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		debug("   - %d %d\n", dev->req_seq, dev->seq);
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
@@ -180,6 +270,7 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 			return 0;
 		}
 	}
+not_found:
 	debug("   - not found\n");
 
 	return -ENODEV;
@@ -199,6 +290,14 @@ static int uclass_find_device_by_of_offset(enum uclass_id id, int node,
 	if (ret)
 		return ret;
 
+	if (gd->dm_index) {
+		dev = uclass_hash_find(id, DM_HASH_OF_OFFSET, node);
+		if (!dev)
+			return -ENODEV;
+		*devp = dev;
+		return 0;
+	}
+
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		if (dev->of_offset == node) {
 			*devp = dev;
@@ -321,10 +420,14 @@ int uclass_bind_device(struct udevice *dev)
 	uc = dev->uclass;
 
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_hash_device(dev, DM_HASH_REQ_SEQ);
+	uclass_hash_device(dev, DM_HASH_OF_OFFSET);
 
 	if (uc->uc_drv->post_bind) {
 		ret = uc->uc_drv->post_bind(dev);
 		if (ret) {
+			uclass_unhash_device(dev, DM_HASH_REQ_SEQ);
+			uclass_unhash_device(dev, DM_HASH_OF_OFFSET);
 			list_del(&dev->uclass_node);
 			return ret;
 		}
@@ -336,6 +439,7 @@ int uclass_bind_device(struct udevice *dev)
 int uclass_unbind_device(struct udevice *dev)
 {
 	struct uclass *uc;
+	int type;
 	int ret;
 
 	uc = dev->uclass;
@@ -345,6 +449,8 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
+	for (type = 0; type < DM_HASH_COUNT; type++)
+		uclass_unhash_device(dev, type);
 	list_del(&dev->uclass_node);
 	return 0;
 }
@@ -407,6 +513,7 @@ int uclass_pre_remove_device(struct udevice *dev)
 		free(dev->uclass_priv);
 		dev->uclass_priv = NULL;
 	}
+	uclass_unhash_device(dev, DM_HASH_SEQ);
 	dev->seq = -1;
 
 	return 0;
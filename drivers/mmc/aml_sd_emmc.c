@@ -789,7 +789,17 @@ void sd_emmc_register(struct aml_card_sd_info * aml_priv)
 	cfg->f_max = 40000000;
 	cfg->part_type = PART_TYPE_AML;
 	cfg->b_max = 256;
+#ifdef CONFIG_INITCALL_ASYNC
+	{
+		struct mmc *mmc = mmc_create(cfg, aml_priv);
+
+		/* eMMC is always there, let it power up early */
+		if (mmc && aml_priv->sd_emmc_port == SDIO_PORT_C)
+			mmc_set_preinit(mmc, 1);
+	}
+#else
 	mmc_create(cfg,aml_priv);
+#endif
 }
 
 bool aml_is_emmc_tsd (struct mmc *mmc) // is eMMC OR TSD
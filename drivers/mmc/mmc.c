@@ -11,6 +11,7 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <initcall.h>
 #include <mmc.h>
 #include <part.h>
 #include <malloc.h>
@@ -436,6 +437,8 @@ static int mmc_send_op_cond(struct mmc *mmc)
 
  	/* Asking to the card its capabilities */
 	mmc->op_cond_pending = 1;
+	/* The card is idle again, whatever it said last time */
+	mmc->op_cond_response &= ~OCR_BUSY;
 
 	return IN_PROGRESS;
 
@@ -459,16 +462,20 @@ static int mmc_complete_op_cond(struct mmc *mmc)
 	int err;
 
 	mmc->op_cond_pending = 0;
-	start = get_timer(0);
-	do {
-		err = mmc_send_op_cond_iter(mmc, &cmd, 1);
-		if (err)
-			return err;
-		if (get_timer(start) > timeout)
-			return UNUSABLE_ERR;
-		udelay(100);
-	} while (!(mmc->op_cond_response & OCR_BUSY));
+	/* The card may already have finished powering up during preinit */
+	if (!(mmc->op_cond_response & OCR_BUSY)) {
+		start = get_timer(0);
+		do {
+			err = mmc_send_op_cond_iter(mmc, &cmd, 1);
+			if (err)
+				return err;
+			if (get_timer(start) > timeout)
+				return UNUSABLE_ERR;
+			udelay(100);
+		} while (!(mmc->op_cond_response & OCR_BUSY));
+	}
 
+	mmc->ocr = mmc->op_cond_response;
 	if (mmc_host_is_spi(mmc)) { /* read OCR for spi */
 		cmd.cmdidx = MMC_CMD_SPI_READ_OCR;
 		cmd.resp_type = MMC_RSP_R3;
@@ -478,10 +485,10 @@ static int mmc_complete_op_cond(struct mmc *mmc)
 
 		if (err)
 			return err;
+		mmc->ocr = cmd.response[0];
 	}
 
 	mmc->version = MMC_VERSION_UNKNOWN;
-	mmc->ocr = cmd.response[0];
 
 	mmc->high_capacity = ((mmc->ocr & OCR_HCS) == OCR_HCS);
 	mmc->rca = 1;
@@ -680,6 +687,11 @@ int mmc_switch_part(int dev_num, unsigned int part_num)
 	if ((ret == 0) || ((ret == -ENODEV) && (part_num == 0)))
 		ret = mmc_set_capacity(mmc, part_num);
 
+#ifdef CONFIG_EFI_PARTITION
+	/* Same descriptor, different contents */
+	part_efi_invalidate_cache(&mmc->block_dev);
+#endif
+
 	return ret;
 }
 
@@ -1572,11 +1584,13 @@ int mmc_init(struct mmc *mmc)
 {
 	int err = IN_PROGRESS;
 	unsigned start;
+	ulong span_start;
 
 	if (mmc->has_init)
 		return 0;
 
 	start = get_timer(0);
+	span_start = bootstage_span_start();
 
 	mmc_bus_init();
 
@@ -1607,6 +1621,7 @@ int mmc_init(struct mmc *mmc)
 	}
 	info_disprotect &= ~DISPROTECT_KEY;
 #endif
+	bootstage_span("mmc", mmc->cfg->name, 0, span_start);
 	return err;
 }
 
@@ -1664,6 +1679,67 @@ void mmc_set_preinit(struct mmc *mmc, int preinit)
 	mmc->preinit = preinit;
 }
 
+#ifdef CONFIG_INITCALL_ASYNC
+static ulong preinit_start;
+
+static int mmc_preinit_start(void)
+{
+	struct mmc *m;
+	struct list_head *entry;
+
+	mmc_bus_init();
+	list_for_each(entry, &mmc_devices) {
+		m = list_entry(entry, struct mmc, link);
+
+		if (m->preinit)
+			mmc_start_init(m);
+	}
+	preinit_start = get_timer(0);
+
+	return 0;
+}
+
+/*
+ * Wait for the cards to finish powering up, which is what takes eMMC so
+ * long. The rest of the setup is left to mmc_init().
+ */
+static int mmc_preinit_poll(void)
+{
+	struct mmc_cmd cmd;
+	struct mmc *m;
+	struct list_head *entry;
+	int busy = 0;
+
+	list_for_each(entry, &mmc_devices) {
+		m = list_entry(entry, struct mmc, link);
+
+		if (!m->init_in_progress || !m->op_cond_pending ||
+		    (m->op_cond_response & OCR_BUSY))
+			continue;
+		if (mmc_send_op_cond_iter(m, &cmd, 1))
+			continue;	/* mmc_init() will find out */
+		if (!(m->op_cond_response & OCR_BUSY))
+			busy = 1;
+	}
+
+	/* Same timeout as mmc_complete_op_cond(), which reports it */
+	if (busy && get_timer(preinit_start) <= 1000)
+		return -EBUSY;
+
+	return 0;
+}
+
+static struct initcall_async mmc_preinit = {
+	.name	= "mmc",
+	.start	= mmc_preinit_start,
+	.poll	= mmc_preinit_poll,
+};
+
+static void do_preinit(void)
+{
+	initcall_async_start(&mmc_preinit);
+}
+#else
 static void do_preinit(void)
 {
 	struct mmc *m;
@@ -1676,6 +1752,7 @@ static void do_preinit(void)
 			mmc_start_init(m);
 	}
 }
+#endif
 
 
 int mmc_initialize(bd_t *bis)
@@ -826,6 +826,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_prefetch_hdrs(ubi, pnum);
+
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1235,6 +1237,9 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
+	/* Not fatal if this fails, the headers are then read one by one */
+	ubi->hdr_buf = kmalloc(ubi->leb_start, GFP_KERNEL);
+
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
@@ -1244,6 +1249,9 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 			goto out_vidh;
 	}
 
+	kfree(ubi->hdr_buf);
+	ubi->hdr_buf = NULL;
+
 	ubi_msg("scanning is finished");
 
 	/* Calculate mean erase counter */
@@ -1287,6 +1295,8 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	return 0;
 
 out_vidh:
+	kfree(ubi->hdr_buf);
+	ubi->hdr_buf = NULL;
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -35,6 +35,7 @@
 #include <linux/err.h>
 #include <ubi_uboot.h>
 #include <linux/mtd/partitions.h>
+#include <bootstage.h>
 
 #include "ubi.h"
 
@@ -1011,7 +1012,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	if (!ubi->fm_buf)
 		goto out_free;
 #endif
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_ATTACH, "ubi_attach");
 	err = ubi_attach(ubi, 0);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_ATTACH);
 	if (err) {
 		ubi_err("failed to attach mtd%d, error %d", mtd->index, err);
 		goto out_free;
@@ -1067,6 +1070,20 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	wake_up_process(ubi->bgt_thread);
 	spin_unlock(&ubi->wl_lock);
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/*
+	 * If the device had to be attached by a full scan, write a fastmap
+	 * right away so that the next attach does not have to scan again.
+	 * A failure here is not fatal, the next attach simply scans too.
+	 */
+	if (!ubi->fm_disabled && !ubi->fm && !ubi->ro_mode) {
+		ubi_msg("writing fastmap to avoid a full scan on next attach");
+		err = ubi_update_fastmap(ubi);
+		if (err)
+			ubi_err("cannot write fastmap, error %d", err);
+	}
+#endif
+
 	ubi_devices[ubi_num] = ubi;
 	ubi_notify_all(ubi, UBI_VOLUME_ADDED, NULL);
 	return ubi_num;
@@ -697,6 +697,55 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_prefetch_hdrs - read both headers of a PEB with a single read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock number to read from
+ *
+ * When scanning, the EC and VID headers of every PEB are read one after the
+ * other. This function reads the whole headers area (everything before
+ * @ubi->leb_start) in one go, so the following 'ubi_io_read_ec_hdr()' and
+ * 'ubi_io_read_vid_hdr()' calls for @pnum are served from memory. The copy is
+ * only kept if the read was completely clean; on bit-flips or errors the
+ * headers are read again separately so that they are reported exactly as
+ * before. Does nothing if @ubi->hdr_buf is not allocated.
+ */
+void ubi_io_prefetch_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int err;
+
+	ubi->hdr_buf_pnum = -1;
+	if (!ubi->hdr_buf)
+		return;
+
+	err = ubi_io_read(ubi, ubi->hdr_buf, pnum, 0, ubi->leb_start);
+	if (!err)
+		ubi->hdr_buf_pnum = pnum;
+}
+
+/**
+ * read_hdr - read a header, using the prefetched copy if there is one.
+ * @ubi: UBI device description object
+ * @buf: buffer where to store the read data
+ * @pnum: physical eraseblock number to read from
+ * @offset: offset within the physical eraseblock from where to read
+ * @len: how many bytes to read
+ *
+ * Same as 'ubi_io_read()', but uses the data cached by
+ * 'ubi_io_prefetch_hdrs()' when it covers @pnum.
+ */
+static int read_hdr(struct ubi_device *ubi, void *buf, int pnum, int offset,
+		    int len)
+{
+	if (ubi->hdr_buf && ubi->hdr_buf_pnum == pnum &&
+	    offset + len <= ubi->leb_start) {
+		memcpy(buf, ubi->hdr_buf + offset, len);
+		return 0;
+	}
+
+	return ubi_io_read(ubi, buf, pnum, offset, len);
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -728,7 +777,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	read_err = read_hdr(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1000,8 +1049,8 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	read_err = read_hdr(ubi, p, pnum, ubi->vid_hdr_aloffset,
+			    ubi->vid_hdr_alsize);
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
@@ -56,6 +56,7 @@ static struct _tx_desc*	g_tx = NULL;
 static struct _rx_desc*	g_current_rx = NULL;
 static struct _tx_desc*	g_current_tx = NULL;
 static int g_nInitialized = 0 ;
+static int g_rx_coe = 0;	/* mac checks rx ip/udp/tcp checksums */
 static unsigned int g_phy_Identifier = 0;
 static unsigned int   g_speed_enforce=0;
 static unsigned int  g_mdc_clock_range=ETH_MAC_4_GMII_Addr_CR_100_150;
@@ -338,6 +339,10 @@ static void set_mac_mode(void)
 					| ETH_MAC_0_Configuration_RE | ETH_MAC_0_Configuration_TE), ETH_MAC_0_Configuration);
 	}
 
+	/* rx checksum offload, the bit reads back 0 if the mac lacks it */
+	aml_eth_writel(aml_eth_readl(ETH_MAC_0_Configuration) | ETH_MAC_0_Configuration_IPC, ETH_MAC_0_Configuration);
+	g_rx_coe = !!(aml_eth_readl(ETH_MAC_0_Configuration) & ETH_MAC_0_Configuration_IPC);
+
 	aml_eth_writel((ETH_MAC_1_Frame_Filter_PM | ETH_MAC_1_Frame_Filter_RA), ETH_MAC_1_Frame_Filter);
 }
 
@@ -719,11 +724,46 @@ static void eth_rx_dump(unsigned char *p, int len)
 	}
 }
 
+/*
+ * wait until the dma has given the tx descriptor back to us
+ */
+static int aml_eth_tx_wait(struct _tx_desc *pTx)
+{
+	unsigned tmo = 0;	//5S time out
+
+	_dcache_inv_range_for_net((unsigned long)pTx, (unsigned long)(pTx + 1) - 1);
+	while (pTx->tdes0 & TDES0_OWN) {
+		if (tmo++ >= 50000) {
+			return -1;
+		}
+		udelay(100);
+		_dcache_inv_range_for_net((unsigned long)pTx, (unsigned long)(pTx + 1) - 1);
+	}
+	return 0;
+}
+
 static void aml_eth_halt(struct eth_device * net_current)
 {
-	return;
+	int i;
+
+	if (!g_nInitialized) {
+		return;
+	}
+
+	/* let the packets still in the tx ring go out */
+	for (i = 0; i < gS->tx_len; i++) {
+		if (aml_eth_tx_wait(gS->tx + i)) {
+			printf("\ntransmission error, tx desc %d still busy\n", i);
+			break;
+		}
+	}
 }
 
+/*
+ * the packet is copied into the next free tx descriptor and handed to the
+ * dma without waiting for it to go out, so that several packets can be in
+ * flight; we only wait when the ring is full
+ */
 static int aml_eth_send(struct eth_device *net_current, void *packet, int length)
 {
 	unsigned int mask;
@@ -739,6 +779,11 @@ static int aml_eth_send(struct eth_device *net_current, void *packet, int length
 	struct _tx_desc* pTx = g_current_tx;
 	struct _tx_desc* pDma = (struct _tx_desc*)aml_eth_readl(ETH_DMA_18_Curr_Host_Tr_Descriptor);
 
+	/* with packets in flight the dma pointer is only stable when suspended */
+	GetDMAStatus(&mask, &status);
+	if ((status & ETH_DMA_5_Status_TS_CLS) != ETH_DMA_5_Status_TS_SUSP) {
+		pDma = NULL;
+	}
 	if (pDma != NULL) {
 		_dcache_inv_range_for_net((unsigned long)pDma, (unsigned long)(pDma) + sizeof(struct _tx_desc) - 1);
 	}
@@ -748,9 +793,6 @@ static int aml_eth_send(struct eth_device *net_current, void *packet, int length
 		//start the current_tx at pDMA
 		pTx = pDma;
 	}
-	if (pDma != pTx) {
-		_dcache_inv_range_for_net((unsigned long)pTx, (unsigned long)(pTx + 1) - 1);
-	}
 
 	if (length > ETH_MTU) {
 		goto err;
@@ -761,7 +803,7 @@ static int aml_eth_send(struct eth_device *net_current, void *packet, int length
 		goto err;
 	}
 
-	if (pTx->tdes0 & TDES0_OWN) {
+	if (aml_eth_tx_wait(pTx)) {
 #if 1
 		volatile unsigned long Cdma, Dstatus, status;
 		Cdma = aml_eth_readl(ETH_DMA_18_Curr_Host_Tr_Descriptor);
@@ -798,18 +840,7 @@ static int aml_eth_send(struct eth_device *net_current, void *packet, int length
 	printf("Current status=%x\n", status);
 #endif
 
-	/* wait for transfer to succeed */
-	//unsigned tmo = get_timer (0) + 5 * CONFIG_SYS_HZ;		//5S time out
-	unsigned tmo = 0;
-	do {
-		udelay(100);
-		GetDMAStatus(&mask, &status);
-		if (tmo++ >= 50000) {
-			printf("\ntransmission error %#x\n", status);
-			break;
-		}
-	} while (!((status & ETH_DMA_5_Status_NIS) && (status & ETH_DMA_5_Status_TI)));
-
+	/* completion is checked when the descriptor is used again */
 	if (status & ETH_DMA_5_Status_NIS) {
 		if (status & ETH_DMA_5_Status_TI) {
 			aml_eth_writel(ETH_DMA_5_Status_NIS | ETH_DMA_5_Status_TI, ETH_DMA_5_Status);
@@ -819,26 +850,42 @@ static int aml_eth_send(struct eth_device *net_current, void *packet, int length
 		}
 	}
 
-#ifdef ET_DEBUG
-	//test
-	GetDMAStatus(&mask, &status);
-	printf("Current status=%x\n", status);
-#endif
 	return 0;
 err:
 	return -1;
 }
 
 /*
- * each time receive a whole packet
+ * with rx checksum offload, frame type, ip header error and payload error
+ * in rdes0 tell which checksums the mac found good
+ */
+static int aml_eth_rx_csum(unsigned int rdes0)
+{
+	if (!g_rx_coe)
+		return 0;
+
+	switch (rdes0 & (RDES0_FT | RDES0_IPC | RDES0_MCE)) {
+	case RDES0_FT:
+		return NET_RX_CSUM_IP | NET_RX_CSUM_L4;
+	case RDES0_MCE:
+		/* payload not checked: a fragment, icmp, ... */
+		return NET_RX_CSUM_IP;
+	}
+	return 0;
+}
+
+/*
+ * hand every received frame to the network stack straight from its dma
+ * buffer, then give the descriptor back to the dma
  */
 static int aml_eth_rx(struct eth_device * net_current)
 {
 	unsigned int mask;
 	unsigned int status;
-	int rxnum = 0;
 	int len = 0;
+	int n;
 	struct _rx_desc* pRx;
+	unsigned char *buf;
 
 	if (!g_nInitialized) {
 		return -1;
@@ -846,40 +893,45 @@ static int aml_eth_rx(struct eth_device * net_current)
 
 	netdev_chk();
 
-	/* Check packet ready or not */
-	GetDMAStatus(&mask, &status);
-	if (!((status & ETH_DMA_5_Status_NIS) && (status & ETH_DMA_5_Status_RI))) {
-		return 0;
-	}
-	aml_eth_writel(ETH_DMA_5_Status_NIS | ETH_DMA_5_Status_RI, ETH_DMA_5_Status);	//clear the int flag
-
 	if (!g_current_rx) {
 		g_current_rx = gS->rx;
 	}
+
+	/* Check packet ready or not, the descriptor tells, not the status bits */
 	pRx = g_current_rx;
 	_dcache_inv_range_for_net((unsigned long)pRx, (unsigned long)(pRx + 1) - 1);
-	while (!(pRx->rdes0 & RDES0_OWN)) {
+	if (pRx->rdes0 & RDES0_OWN) {
+		return 0;
+	}
+	GetDMAStatus(&mask, &status);
+	aml_eth_writel(ETH_DMA_5_Status_NIS | ETH_DMA_5_Status_RI, ETH_DMA_5_Status);	//clear the int flag
+
+	/* at most one pass over the ring, as the dma keeps filling it */
+	for (n = 0; n < gS->rx_len && !(pRx->rdes0 & RDES0_OWN); n++) {
 		len = (pRx->rdes0 & RDES0_FL_MASK) >> RDES0_FL_P;
+		buf = (unsigned char *)(unsigned long)pRx->rdes2;
+		g_current_rx = (struct _rx_desc*)(unsigned long)pRx->rdes3;
+
 		if (14 >= len) {
 			printf("err len=%d\n", len);
-			goto NEXT_BUF;
+		} else {
+			_dcache_inv_range_for_net((unsigned long)buf, (unsigned long)buf + len - 1);
+			eth_rx_dump(buf, len);
+			net_receive_csum(buf, len, aml_eth_rx_csum(pRx->rdes0));
+			/* the stack may have written to it, e.g. to answer a ping */
+			_dcache_flush_range_for_net((unsigned long)buf, (unsigned long)buf + len - 1);
 		}
-		// pbuf_header(pb, -sizeof(short));
-		_dcache_inv_range_for_net((unsigned long)pRx->rdes2, (unsigned long)pRx->rdes2 + len - 1);
 
-		if (!memcpy((unsigned char*)NetRxPackets[0], (unsigned char*)(unsigned long)pRx->rdes2, len)) {
-			printf("memcp error\n");
-			goto NEXT_BUF;
-		}
-NEXT_BUF:
 		pRx->rdes0 = RDES0_OWN;
 		_dcache_flush_range_for_net((unsigned long)pRx, (unsigned long)(pRx + 1) - 1);
-		pRx = (struct _rx_desc*)(unsigned long)g_current_rx->rdes3;
+		pRx = g_current_rx;
 		_dcache_inv_range_for_net((unsigned long)pRx, (unsigned long)(pRx + 1) - 1);
-		g_current_rx = pRx;
-		rxnum++;
-		NetReceive(NetRxPackets[0], len);
-		eth_rx_dump((unsigned char *)NetRxPackets[0], len);
+	}
+
+	/* the dma suspends when it runs out of descriptors, restart it */
+	if (status & ETH_DMA_5_Status_RU) {
+		aml_eth_writel(ETH_DMA_5_Status_RU, ETH_DMA_5_Status);
+		aml_eth_writel(1, ETH_DMA_2_Re_Poll_Demand);
 	}
 
 	return len;
@@ -1023,6 +1075,15 @@ error_out:
 	return -1;
 }
 
+#ifdef CONFIG_MCAST_TFTP
+/* The frame filter is set to receive all, multicast included */
+static int aml_eth_mcast(struct eth_device *net_current, const u8 *mcast_mac,
+			 u8 set)
+{
+	return 0;
+}
+#endif
+
 int aml_eth_init(bd_t *bis)
 {
 	struct eth_device *dev;
@@ -1033,6 +1094,9 @@ int aml_eth_init(bd_t *bis)
 	dev->halt 	= aml_eth_halt;
 	dev->send	= aml_eth_send;
 	dev->recv	= aml_eth_rx;
+#ifdef CONFIG_MCAST_TFTP
+	dev->mcast	= aml_eth_mcast;
+#endif
 	return eth_register(dev);
 }
 
@@ -191,7 +191,8 @@ static int dw_write_hwaddr(struct eth_device *dev)
 	return 0;
 }
 
-static void dw_adjust_link(struct eth_mac_regs *mac_p,
+static void dw_adjust_link(struct dw_eth_dev *priv,
+			   struct eth_mac_regs *mac_p,
 			   struct phy_device *phydev)
 {
 	u32 conf = readl(&mac_p->conf) | FRAMEBURSTENABLE | DISABLERXOWN;
@@ -210,7 +211,16 @@ static void dw_adjust_link(struct eth_mac_regs *mac_p,
 	if (phydev->duplex)
 		conf |= FULLDPLXMODE;
 
+#ifndef CONFIG_DW_ALTDESCRIPTOR
+	/*
+	 * Rx checksum offload. Only the normal descriptors report its
+	 * result in the status word, and the bit reads back as 0 when the
+	 * MAC was built without it.
+	 */
+	conf |= RXIPCOFFLOAD;
+#endif
 	writel(conf, &mac_p->conf);
+	priv->rx_coe = !!(readl(&mac_p->conf) & RXIPCOFFLOAD);
 
 	printf("Speed: %d, %s duplex%s\n", phydev->speed,
 	       (phydev->duplex) ? "full" : "half",
@@ -275,7 +285,7 @@ static int dw_eth_init(struct eth_device *dev, bd_t *bis)
 	priv->phydev->speed = 100;
 	priv->phydev->duplex = 1;
 #endif
-	dw_adjust_link(mac_p, priv->phydev);
+	dw_adjust_link(priv, mac_p, priv->phydev);
 
 	if (!priv->phydev->link)
 		return -1;
@@ -347,6 +357,26 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
+/*
+ * Frame type, IP header error and payload error tell which checksums
+ * the rx checksum offload found good
+ */
+static int dw_rx_csum(struct dw_eth_dev *priv, u32 status)
+{
+	if (!priv->rx_coe)
+		return 0;
+
+	switch (status & (DESC_RXSTS_RXFRAMEETHER | DESC_RXSTS_RXIPC_GIANT |
+			  DESC_RXSTS_RXPAYLOADERR)) {
+	case DESC_RXSTS_RXFRAMEETHER:
+		return NET_RX_CSUM_IP | NET_RX_CSUM_L4;
+	case DESC_RXSTS_RXPAYLOADERR:
+		/* IPv4 header good, payload not checked (fragment, ICMP) */
+		return NET_RX_CSUM_IP;
+	}
+	return 0;
+}
+
 static int dw_eth_recv(struct eth_device *dev)
 {
 	struct dw_eth_dev *priv = dev->priv;
@@ -369,7 +399,8 @@ static int dw_eth_recv(struct eth_device *dev)
 		/* Invalidate received data */
 		invalidate_dcache_range((phys_addr_t)priv->rxbuffs, (phys_addr_t)priv->rxbuffs + RX_TOTAL_BUFSIZE);
 
-		NetReceive((uchar *)(phys_addr_t)desc_p->dmamac_addr, length);
+		net_receive_csum((uchar *)(phys_addr_t)desc_p->dmamac_addr,
+				 length, dw_rx_csum(priv, status));
 
 		/*
 		 * Make the current descriptor valid again and go to
@@ -40,6 +40,7 @@ struct eth_mac_regs {
 #define FES_100			(1 << 14)
 #define DISABLERXOWN		(1 << 13)
 #define FULLDPLXMODE		(1 << 11)
+#define RXIPCOFFLOAD		(1 << 10)
 #define RXENABLE		(1 << 2)
 #define TXENABLE		(1 << 3)
 
@@ -159,6 +160,7 @@ struct dmamacdescr {
 #define DESC_RXSTS_RXMIIERROR		(1 << 3)
 #define DESC_RXSTS_RXDRIBBLING		(1 << 2)
 #define DESC_RXSTS_RXCRC		(1 << 1)
+#define DESC_RXSTS_RXPAYLOADERR		(1 << 0)
 
 /*
  * dmamac_cntl definitions
@@ -223,6 +225,7 @@ struct dw_eth_dev {
 	u32 interface;
 	u32 tx_currdescnum;
 	u32 rx_currdescnum;
+	int rx_coe;		/* MAC checks rx checksums */
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -154,6 +154,21 @@ int serial_tstc(void)
 	return _serial_tstc(gd->cur_serial_dev);
 }
 
+int serial_tx_space(void)
+{
+	return -1;
+}
+
+void serial_flush(void)
+{
+	struct dm_serial_ops *ops = serial_get_ops(gd->cur_serial_dev);
+
+	if (ops->pending) {
+		while (ops->pending(gd->cur_serial_dev, false) > 0)
+			WATCHDOG_RESET();
+	}
+}
+
 void serial_setbrg(void)
 {
 	struct dm_serial_ops *ops = serial_get_ops(gd->cur_serial_dev);
@@ -185,6 +185,10 @@ void serial_register(struct serial_device *dev)
 		dev->putc += gd->reloc_off;
 	if (dev->puts)
 		dev->puts += gd->reloc_off;
+	if (dev->tx_space)
+		dev->tx_space += gd->reloc_off;
+	if (dev->flush)
+		dev->flush += gd->reloc_off;
 #endif
 
 	dev->next = serial_devices;
@@ -504,6 +508,40 @@ void serial_puts(const char *s)
 	get_current()->puts(s);
 }
 
+/**
+ * serial_tx_space() - Room in the transmitter of the selected serial port
+ *
+ * This function returns how many characters serial_putc() accepts on
+ * currently selected serial port without waiting for the hardware. A
+ * newline counts twice, as the driver sends it as CR LF. The console
+ * uses it to feed the UART from its output ring without busy-waiting.
+ *
+ * Returns the number of characters, negative if the driver can't tell.
+ */
+int serial_tx_space(void)
+{
+	struct serial_device *dev = get_current();
+
+	if (!dev->tx_space)
+		return -1;
+	return dev->tx_space();
+}
+
+/**
+ * serial_flush() - Wait until the selected serial port sent all output
+ *
+ * This function waits until all characters queued in the transmitter of
+ * currently selected serial port have left it, so nothing is lost when
+ * the port is reprogrammed or control is passed to an operating system.
+ */
+void serial_flush(void)
+{
+	struct serial_device *dev = get_current();
+
+	if (dev->flush)
+		dev->flush();
+}
+
 /**
  * default_serial_puts() - Output string by calling serial_putc() in loop
  * @s:	Zero-terminated string to be output from the serial port.
@@ -201,13 +201,36 @@ static void serial_putc_port (unsigned long port_base,const char c)
 
     /* Wait till dataTx register is not full */
     while ((readl(P_UART_STATUS(port_base)) & UART_STAT_MASK_TFIFO_FULL));
- // while(!(readl(P_UART_STATUS(port_base)) & UART_STAT_MASK_TFIFO_EMPTY));
+    /* The FIFO sends it on its own, serial_flush_port() waits for that */
     writel(c, P_UART_WFIFO(port_base));
-    /* Wait till dataTx register is empty */
+}
+
+/*
+ * Free entries in the transmit FIFO, what serial_putc_port() can take
+ * without waiting.
+ */
+#ifndef UART_TX_FIFO_SIZE
+#define UART_TX_FIFO_SIZE	64	/* the smallest FIFO, the AO UART one */
+#endif
+static int serial_tx_space_port(unsigned long port_base)
+{
+    unsigned long status = readl(P_UART_STATUS(port_base));
+    int used;
+
+    if (status & UART_STAT_MASK_TFIFO_FULL)
+        return 0;
+    used = (status & UART_STAT_MASK_TFIFO_CNT) >> 8;
+    return used < UART_TX_FIFO_SIZE ? UART_TX_FIFO_SIZE - used : 0;
+}
+
+/*
+ * Wait till everything written to the transmit FIFO has been sent
+ */
+static void serial_flush_port(unsigned long port_base)
+{
 #if !defined (CONFIG_VLSI_EMULATOR)
     while (!(readl(P_UART_STATUS(port_base)) & UART_STAT_MASK_TFIFO_EMPTY)) ;
 #endif //CONFIG_VLSI_EMULATOR
-
 }
 
 /*
@@ -259,7 +282,7 @@ static void serial_puts_port (unsigned long port_base,const char *s)
     static int  uart_##port##_init (void) {\
 	serial_init_port(port);	return(0);}\
     static void uart_##port##_setbrg (void) {\
-	serial_setbrg_port(port);}\
+	serial_flush_port(port); serial_setbrg_port(port);}\
     static int  uart_##port##_getc (void) {\
 	return serial_getc_port(port);}\
     static int  uart_##port##_tstc (void) {\
@@ -267,7 +290,11 @@ static void serial_puts_port (unsigned long port_base,const char *s)
     static void uart_##port##_putc (const char c) {\
 	serial_putc_port(port, c);}\
     static void uart_##port##_puts (const char *s) {\
-	serial_puts_port(port, s);}
+	serial_puts_port(port, s);}\
+    static int  uart_##port##_tx_space (void) {\
+	return serial_tx_space_port(port);}\
+    static void uart_##port##_flush (void) {\
+	serial_flush_port(port);}
 
 #define INIT_UART_STRUCTURE(port,_name,bus) static struct serial_device device_##port={\
 	.name	= _name,\
@@ -278,7 +305,9 @@ static void serial_puts_port (unsigned long port_base,const char *s)
 	.getc	= uart_##port##_getc,\
 	.tstc	= uart_##port##_tstc,\
 	.putc	= uart_##port##_putc,\
-	.puts	= uart_##port##_puts, }
+	.puts	= uart_##port##_puts,\
+	.tx_space = uart_##port##_tx_space,\
+	.flush	= uart_##port##_flush, }
 
 DECLARE_UART_FUNCTIONS(UART_PORT_0);
 INIT_UART_STRUCTURE(UART_PORT_0,"uart0","UART0");
@@ -334,7 +363,16 @@ void serial_puts(const char * s){
 	serial_puts_port(UART_PORT_CONS,s);
 }
 
+int serial_tx_space(void){
+	return serial_tx_space_port(UART_PORT_CONS);
+}
+
+void serial_flush(void){
+	serial_flush_port(UART_PORT_CONS);
+}
+
 void serial_setbrg(void){
+	serial_flush_port(UART_PORT_CONS);
 	serial_setbrg_port(UART_PORT_CONS);
 }
 #ifdef CONFIG_CMD_KGDB
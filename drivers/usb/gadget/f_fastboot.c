@@ -21,15 +21,7 @@
 #include <version.h>
 #include <g_dnl.h>
 #include <asm/arch/cpu.h>
-#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
-#include <fb_mmc.h>
-#include <fb_storage.h>
-#endif
-#include <partition_table.h>
-
-DECLARE_GLOBAL_DATA_PTR;
-
-#define FASTBOOT_VERSION		"0.4"
+#include <fb_command.h>
 
 #define FASTBOOT_INTERFACE_CLASS	0xff
 #define FASTBOOT_INTERFACE_SUB_CLASS	0x42
@@ -39,12 +31,6 @@ DECLARE_GLOBAL_DATA_PTR;
 #define RX_ENDPOINT_MAXIMUM_PACKET_SIZE_1_1  (0x0040)
 #define TX_ENDPOINT_MAXIMUM_PACKET_SIZE      (0x0040)
 
-#define DEVICE_PRODUCT	CONFIG_DEVICE_PRODUCT
-#define DEVICE_SERIAL	"1234567890"
-
-/* The 64 defined bytes plus \0 */
-#define RESPONSE_LEN	(64 + 1)
-
 #define EP_BUFFER_SIZE	4096
 
 struct f_fastboot {
@@ -61,8 +47,7 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 }
 
 static struct f_fastboot *fastboot_func;
-static unsigned int download_size;
-static unsigned int download_bytes;
+static int fastboot_action;
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -129,24 +114,6 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 	NULL,
 };
 
-#define DRAM_UBOOT_RESERVE		0x01000000
-unsigned int ddr_size_usable(unsigned int addr_start)
-{
-	unsigned int ddr_size=0;
-	unsigned int free_size = 0;
-	int i;
-
-	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++)
-		ddr_size += gd->bd->bi_dram[i].size;
-
-	free_size = (ddr_size - DRAM_UBOOT_RESERVE - addr_start - CONFIG_SYS_MALLOC_LEN - CONFIG_SYS_MEM_TOP_HIDE);
-#if defined CONFIG_FASTBOOT_MAX_DOWN_SIZE
-	if (free_size > CONFIG_FASTBOOT_MAX_DOWN_SIZE)
-		free_size = CONFIG_FASTBOOT_MAX_DOWN_SIZE;
-#endif
-	return free_size;
-}
-
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
 
 static void fastboot_complete(struct usb_ep *ep, struct usb_request *req)
@@ -364,176 +331,43 @@ static int fastboot_tx_write_str(const char *buffer)
 	return fastboot_tx_write(buffer, strlen(buffer));
 }
 
-static void compl_do_reset(struct usb_ep *ep, struct usb_request *req)
+static void compl_do_action(struct usb_ep *ep, struct usb_request *req)
 {
-	do_reset(NULL, 0, 0, NULL);
+	fb_do_action(fastboot_action);
 }
 
-static void compl_do_reboot_bootloader(struct usb_ep *ep, struct usb_request *req)
-{
-	run_command("reboot fastboot", 0);
-}
-
-
-static void cb_reboot(struct usb_ep *ep, struct usb_request *req)
-{
-	char *cmd = req->buf;
-
-	printf("cmd is %s\n", cmd);
-
-	strsep(&cmd, "-");
-	if (!cmd) {
-		fastboot_func->in_req->complete = compl_do_reset;
-		fastboot_tx_write_str("OKAY");
-		return;
-	}
-
-	fastboot_func->in_req->complete = compl_do_reboot_bootloader;
-	fastboot_tx_write_str("OKAY");
-}
-
-static int strcmp_l1(const char *s1, const char *s2)
-{
-	if (!s1 || !s2)
-		return -1;
-	return strncmp(s1, s2, strlen(s1));
-}
-
-static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
+static void do_exit_on_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	char *cmd = req->buf;
-	char response[RESPONSE_LEN];
-	char *s;
-	char *s1;
-	char *s2;
-	char *s3;
-	size_t chars_left;
-
-	strcpy(response, "OKAY");
-	chars_left = sizeof(response) - strlen(response) - 1;
-
-	strsep(&cmd, ":");
-	if (!cmd) {
-		error("missing variable\n");
-		fastboot_tx_write_str("FAILmissing var");
-		return;
-	}
-
-	if (!strcmp_l1("version", cmd)) {
-		strncat(response, FASTBOOT_VERSION, chars_left);
-	} else if (!strcmp_l1("bootloader-version", cmd)) {
-		strncat(response, U_BOOT_VERSION, chars_left);
-	} else if (!strcmp_l1("downloadsize", cmd) ||
-		!strcmp_l1("max-download-size", cmd)) {
-		char str_num[12];
-
-		sprintf(str_num, "0x%08x", ddr_size_usable(CONFIG_USB_FASTBOOT_BUF_ADDR));
-		strncat(response, str_num, chars_left);
-	} else if (!strcmp_l1("serialno", cmd)) {
-		//s = getenv("serial");
-		s = get_usid_string();
-		if (s)
-			strncat(response, s, chars_left);
-		else
-			strncat(response, DEVICE_SERIAL, chars_left);
-	} else if (!strcmp_l1("product", cmd)) {
-		s1 = DEVICE_PRODUCT;
-		strncat(response, s1, chars_left);
-	} else if (!strcmp_l1("slot-count", cmd)) {
-		strncat(response, "2", chars_left);
-	} else if (!strcmp_l1("slot-suffixes", cmd)) {
-		s2 = getenv("slot-suffixes");
-		printf("slot-suffixes: %s\n", s2);
-		if (s2)
-			strncat(response, s2, chars_left);
-		else
-			strncat(response, "0", chars_left);
-	} else if (!strcmp_l1("current-slot", cmd)) {
-		s3 = getenv("active_slot");
-		printf("active_slot: %s\n", s3);
-		strncat(response, s3, chars_left);
-	} else if (!strcmp_l1("has-slot:boot", cmd)) {
-		if (has_boot_slot == 1) {
-			printf("has boot slot\n");
-			strncat(response, "yes", chars_left);
-		} else
-			strncat(response, "no", chars_left);
-	} /*else if (!strcmp_l1("partition-type:boot", cmd)) {
-		char *s2, *s3;
-		s2 = getenv("active_slot");
-		printf("active_slot: %s\n", s2);
-		s3 = "boot";
-		printf("s3  1: %s\n", s3);
-		strcat(s3, s2);
-		printf("s3  2: %s\n", s3);
-		strncat(response, s3, chars_left);
-	} */else if (!strcmp_l1("has-slot:system", cmd)) {
-		if (has_system_slot == 1) {
-			printf("has system slot\n");
-			strncat(response, "yes", chars_left);
-		} else
-			strncat(response, "no", chars_left);
-	} else {
-		error("unknown variable: %s\n", cmd);
-		strcpy(response, "FAILVariable not implemented");
-	}
-	fastboot_tx_write_str(response);
+	g_dnl_trigger_detach();
 }
 
 static unsigned int rx_bytes_expected(void)
 {
-	int rx_remain = download_size - download_bytes;
-	if (rx_remain < 0)
-		return 0;
+	unsigned int rx_remain = fb_download_remaining();
+
 	if (rx_remain > EP_BUFFER_SIZE)
 		return EP_BUFFER_SIZE;
 	return rx_remain;
 }
 
-#define BYTES_PER_DOT	0x20000
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
-	char response[RESPONSE_LEN];
-	unsigned int transfer_size = download_size - download_bytes;
-	const unsigned char *buffer = req->buf;
-	unsigned int buffer_size = req->actual;
-	unsigned int pre_dot_num, now_dot_num;
+	char response[FASTBOOT_RESPONSE_LEN];
 
 	if (req->status != 0) {
 		printf("Bad status: %d\n", req->status);
 		return;
 	}
 
-	if (buffer_size < transfer_size)
-		transfer_size = buffer_size;
-
-	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
-	       buffer, transfer_size);
-
-	pre_dot_num = download_bytes / BYTES_PER_DOT;
-	download_bytes += transfer_size;
-	now_dot_num = download_bytes / BYTES_PER_DOT;
-
-	if (pre_dot_num != now_dot_num) {
-		putc('.');
-		if (!(now_dot_num % 74))
-			putc('\n');
-	}
+	fb_download_data(req->buf, req->actual);
 
 	/* Check if transfer is done */
-	if (download_bytes >= download_size) {
-		/*
-		 * Reset global transfer variable, keep download_bytes because
-		 * it will be used in the next possible flashing command
-		 */
-		download_size = 0;
+	if (!fb_download_remaining()) {
 		req->complete = rx_handler_command;
 		req->length = EP_BUFFER_SIZE;
 
-		sprintf(response, "OKAY");
+		fb_download_complete(response);
 		fastboot_tx_write_str(response);
-
-		printf("\ndownloading of %d bytes finished\n", download_bytes);
 	} else {
 		req->length = rx_bytes_expected();
 		if (req->length < ep->maxpacket)
@@ -544,244 +378,39 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	usb_ep_queue(ep, req, 0);
 }
 
-static void cb_download(struct usb_ep *ep, struct usb_request *req)
+static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 {
-	char *cmd = req->buf;
-	char response[RESPONSE_LEN];
-
-	printf("cmd is %s\n", cmd);
-
-	strsep(&cmd, ":");
-	download_size = simple_strtoul(cmd, NULL, 16);
-	download_bytes = 0;
-
-	printf("Starting download of %d bytes\n", download_size);
+	char *cmdbuf = req->buf;
+	char response[FASTBOOT_RESPONSE_LEN];
+	int action = FB_ACTION_NONE;
 
-	if (0 == download_size) {
-		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > ddr_size_usable(CONFIG_USB_FASTBOOT_BUF_ADDR)) {
-		download_size = 0;
-		sprintf(response, "FAILdata too large");
+	if (req->actual < req->length) {
+		u8 *buf = (u8 *)req->buf;
+		buf[req->actual] = 0;
+		action = fb_handle_command(cmdbuf, response);
 	} else {
-		sprintf(response, "DATA%08x", download_size);
+		error("buffer overflow\n");
+		strcpy(response, "FAILbuffer overflow");
+	}
+
+	switch (action) {
+	case FB_ACTION_DOWNLOAD:
 		req->complete = rx_handler_dl_image;
 		req->length = rx_bytes_expected();
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
+		break;
+	case FB_ACTION_CONTINUE:
+		fastboot_func->in_req->complete = do_exit_on_complete;
+		break;
+	case FB_ACTION_BOOT:
+	case FB_ACTION_REBOOT:
+	case FB_ACTION_REBOOT_BOOTLOADER:
+		fastboot_action = action;
+		fastboot_func->in_req->complete = compl_do_action;
+		break;
 	}
 	fastboot_tx_write_str(response);
-}
-
-static void do_bootm_on_complete(struct usb_ep *ep, struct usb_request *req)
-{
-	char boot_addr_start[12];
-	char *bootm_args[] = { "bootm", boot_addr_start, NULL };
-
-	puts("Booting kernel..\n");
-
-	sprintf(boot_addr_start, "0x%lx", load_addr);
-	do_bootm(NULL, 0, 2, bootm_args);
-
-	/* This only happens if image is somehow faulty so we start over */
-	do_reset(NULL, 0, 0, NULL);
-}
-
-static void cb_boot(struct usb_ep *ep, struct usb_request *req)
-{
-	fastboot_func->in_req->complete = do_bootm_on_complete;
-	fastboot_tx_write_str("OKAY");
-}
-
-static void do_exit_on_complete(struct usb_ep *ep, struct usb_request *req)
-{
-	g_dnl_trigger_detach();
-}
-
-static void cb_continue(struct usb_ep *ep, struct usb_request *req)
-{
-	fastboot_func->in_req->complete = do_exit_on_complete;
-	fastboot_tx_write_str("OKAY");
-}
-
-#ifdef CONFIG_FASTBOOT_FLASH
-static void cb_flash(struct usb_ep *ep, struct usb_request *req)
-{
-	char *cmd = req->buf;
-	char response[RESPONSE_LEN];
-
-	printf("cmd is %s\n", cmd);
-
-	strsep(&cmd, ":");
-	if (!cmd) {
-		error("missing partition name\n");
-		fastboot_tx_write_str("FAILmissing partition name");
-		return;
-	}
-
-	//strcpy(response, "FAILno flash device defined");
-#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
-	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
-			   download_bytes, response);
-#endif
-
-	fastboot_tx_write_str(response);
-}
-#endif
-
-static void cb_set_active(struct usb_ep *ep, struct usb_request *req)
-{
-	char *cmd = req->buf;
-	//char response[RESPONSE_LEN];
-	int ret = 0;
-	char str[128];
-
-	printf("cmd is %s\n", cmd);
-	strsep(&cmd, ":");
-	if (!cmd) {
-		error("missing slot name\n");
-		fastboot_tx_write_str("FAILmissing slot name");
-		return;
-	}
-
-	sprintf(str, "set_active_slot %s", cmd);
-	printf("command:    %s\n", str);
-	ret = run_command(str, 0);
-	printf("ret = %d\n", ret);
-	if (ret == 0)
-		fastboot_tx_write_str("OKAY");
-	else
-		fastboot_tx_write_str("FAILset slot error");
-}
-
-static void cb_flashall(struct usb_ep *ep, struct usb_request *req)
-{
-	char response[RESPONSE_LEN];
-	char *cmd = req->buf;
-
-	printf("cmd is %s\n", cmd);
-
-	//strcpy(response, "FAILno flash device defined");
-
-#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
-	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
-			   download_bytes, response);
-#endif
-	fastboot_tx_write_str(response);
-}
-
-static void cb_erase(struct usb_ep *ep, struct usb_request *req)
-{
-	char response[RESPONSE_LEN];
-	char *cmd = req->buf;
-
-	printf("cmd is %s\n", cmd);
-
-	strsep(&cmd, ":");
-	if (!cmd) {
-		error("missing partition name\n");
-		fastboot_tx_write_str("FAILmissing partition name");
-		return;
-	}
-
-	//strcpy(response, "FAILno erase device defined");
-#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
-	fb_mmc_erase_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR, response);
-#endif
-	fastboot_tx_write_str(response);
-}
-
-static void cb_devices(struct usb_ep *ep, struct usb_request *req)
-{
-	char response[RESPONSE_LEN];
-	char *cmd = req->buf;
-
-	printf("cmd is %s\n", cmd);
-
-	strcpy(response, "AMLOGIC");
-
-	fastboot_tx_write_str(response);
-}
-
-struct cmd_dispatch_info {
-	char *cmd;
-	void (*cb)(struct usb_ep *ep, struct usb_request *req);
-};
-
-static const struct cmd_dispatch_info cmd_dispatch_info[] = {
-	{
-		.cmd = "reboot",
-		.cb = cb_reboot,
-	}, {
-		.cmd = "getvar:",
-		.cb = cb_getvar,
-	}, {
-		.cmd = "download:",
-		.cb = cb_download,
-	}, {
-		.cmd = "boot",
-		.cb = cb_boot,
-	}, {
-		.cmd = "continue",
-		.cb = cb_continue,
-	},
-#ifdef CONFIG_FASTBOOT_FLASH
-	{
-		.cmd = "flash",
-		.cb = cb_flash,
-	},
-#endif
-	{
-		.cmd = "update",
-		.cb = cb_download,
-	},
-	{
-		.cmd = "flashall",
-		.cb = cb_flashall,
-	},
-	{
-		.cmd = "erase",
-		.cb = cb_erase,
-	},
-	{
-		.cmd = "devices",
-		.cb = cb_devices,
-	},
-	{
-		.cmd = "reboot-bootloader",
-		.cb = cb_reboot,
-	},
-	{
-		.cmd = "set_active",
-		.cb = cb_set_active,
-	},
-};
-
-static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
-{
-	char *cmdbuf = req->buf;
-	void (*func_cb)(struct usb_ep *ep, struct usb_request *req) = NULL;
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(cmd_dispatch_info); i++) {
-		if (!strcmp_l1(cmd_dispatch_info[i].cmd, cmdbuf)) {
-			func_cb = cmd_dispatch_info[i].cb;
-			break;
-		}
-	}
-
-	if (!func_cb) {
-		error("unknown command: %s\n", cmdbuf);
-		fastboot_tx_write_str("FAILunknown command");
-	} else {
-		if (req->actual < req->length) {
-			u8 *buf = (u8 *)req->buf;
-			buf[req->actual] = 0;
-			func_cb(ep, req);
-		} else {
-			error("buffer overflow\n");
-			fastboot_tx_write_str("FAILbuffer overflow");
-		}
-	}
 
 	if (req->status == 0) {
 		*cmdbuf = '\0';
@@ -195,6 +195,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index)
 	int blocksize = EXT2_BLOCK_SIZE(ext4fs_root);
 
 	i = i - (index * blocksize);
+	ext4fs_mark_bmap_dirty(get_fs()->blk_bmaps_dirty, index);
 	if (blocksize != 1024) {
 		ptr = ptr + i;
 		operand = 1 << remainder;
@@ -231,6 +232,7 @@ void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer, int index)
 	int blocksize = EXT2_BLOCK_SIZE(ext4fs_root);
 
 	i = i - (index * blocksize);
+	ext4fs_mark_bmap_dirty(get_fs()->blk_bmaps_dirty, index);
 	if (blocksize != 1024) {
 		ptr = ptr + i;
 		operand = (1 << remainder);
@@ -258,6 +260,7 @@ int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index)
 	unsigned char operand;
 
 	inode_no -= (index * ext4fs_root->sblock.inodes_per_group);
+	ext4fs_mark_bmap_dirty(get_fs()->inode_bmaps_dirty, index);
 	i = inode_no / 8;
 	remainder = inode_no % 8;
 	if (remainder == 0) {
@@ -283,6 +286,7 @@ void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index)
 	unsigned char operand;
 
 	inode_no -= (index * ext4fs_root->sblock.inodes_per_group);
+	ext4fs_mark_bmap_dirty(get_fs()->inode_bmaps_dirty, index);
 	i = inode_no / 8;
 	remainder = inode_no % 8;
 	if (remainder == 0) {
@@ -855,13 +859,16 @@ long int ext4fs_get_new_blk_no(void)
 	static int prev_bg_bitmap_index = -1;
 	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
+	/* scratch buffers are only needed on group switches, not per block */
+	char *journal_buffer = NULL;
+	char *zero_buffer = NULL;
 	struct ext2_block_group *bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (fs->first_pass_bbmap == 0) {
+		journal_buffer = zalloc(fs->blksz);
+		zero_buffer = zalloc(fs->blksz);
+		if (!journal_buffer || !zero_buffer)
+			goto fail;
 		for (i = 0; i < fs->no_blkgrp; i++) {
 			if (bgd[i].free_blocks) {
 				if (bgd[i].bg_flags & EXT4_BG_BLOCK_UNINIT) {
@@ -879,6 +886,7 @@ long int ext4fs_get_new_blk_no(void)
 				if (fs->curr_blkno == -1)
 					/* if block bitmap is completely fill */
 					continue;
+				ext4fs_mark_bmap_dirty(fs->blk_bmaps_dirty, i);
 				fs->curr_blkno = fs->curr_blkno +
 						(i * fs->blksz * 8);
 				fs->first_pass_bbmap++;
@@ -927,12 +935,17 @@ restart:
 		}
 
 		if (bgd[bg_idx].bg_flags & EXT4_BG_BLOCK_UNINIT) {
+			if (!zero_buffer)
+				zero_buffer = zalloc(fs->blksz);
+			if (!zero_buffer)
+				goto fail;
 			memset(zero_buffer, '\0', fs->blksz);
 			put_ext4(((uint64_t) ((uint64_t)bgd[bg_idx].block_id *
 					(uint64_t)fs->blksz)), zero_buffer, fs->blksz);
 			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
 			bgd[bg_idx].bg_flags = bgd[bg_idx].bg_flags &
 						~EXT4_BG_BLOCK_UNINIT;
+			ext4fs_mark_bmap_dirty(fs->blk_bmaps_dirty, bg_idx);
 		}
 
 		if (ext4fs_set_block_bmap(fs->curr_blkno, fs->blk_bmaps[bg_idx],
@@ -944,7 +957,9 @@ restart:
 
 		/* journal backup */
 		if (prev_bg_bitmap_index != bg_idx) {
-			memset(journal_buffer, '\0', fs->blksz);
+			journal_buffer = zalloc(fs->blksz);
+			if (!journal_buffer)
+				goto fail;
 			status = ext4fs_devread((lbaint_t)bgd[bg_idx].block_id
 						* fs->sect_perblk,
 						0, fs->blksz, journal_buffer);
@@ -1008,6 +1023,7 @@ int ext4fs_get_new_inode_no(void)
 				if (fs->curr_inode_no == -1)
 					/* if block bitmap is completely fill */
 					continue;
+				ext4fs_mark_bmap_dirty(fs->inode_bmaps_dirty, i);
 				fs->curr_inode_no = fs->curr_inode_no +
 							(i * inodes_per_grp);
 				fs->first_pass_ibmap++;
@@ -1043,6 +1059,8 @@ restart:
 			    bgd[ibmap_idx].bg_flags & ~EXT4_BG_INODE_UNINIT;
 			memcpy(fs->inode_bmaps[ibmap_idx], zero_buffer,
 				fs->blksz);
+			ext4fs_mark_bmap_dirty(fs->inode_bmaps_dirty,
+					       ibmap_idx);
 		}
 
 		if (ext4fs_set_inode_bmap(fs->curr_inode_no,
@@ -1402,6 +1420,272 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	*total_no_of_block += no_blks_reqd;
 }
 
+/* number of blocks tracked by the bitmap of block group @bg_idx */
+static unsigned int ext4fs_group_nr_blocks(unsigned int bg_idx)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_sblock *sblock = &ext4fs_root->sblock;
+	unsigned int blk_per_grp = sblock->blocks_per_group;
+	uint64_t left;
+
+	if (blk_per_grp > fs->blksz * 8)
+		blk_per_grp = fs->blksz * 8;
+	left = (uint64_t)sblock->total_blocks - sblock->first_data_block -
+		(uint64_t)bg_idx * sblock->blocks_per_group;
+
+	return left < blk_per_grp ? (unsigned int)left : blk_per_grp;
+}
+
+/*
+ * Find the first run of free blocks at or after bit @start of @bmap,
+ * at most @max_len long. Returns the run length (0 if there is none)
+ * and its first bit in @run_start.
+ */
+static unsigned int ext4fs_find_free_run(unsigned char *bmap,
+					 unsigned int nbits, unsigned int start,
+					 unsigned int max_len,
+					 unsigned int *run_start)
+{
+	unsigned int bit = start;
+	unsigned int len = 0;
+
+	while (bit < nbits) {
+		if (!(bit & 7) && bmap[bit >> 3] == 0xff) {
+			bit += 8;
+			continue;
+		}
+		if (!(bmap[bit >> 3] & (1 << (bit & 7))))
+			break;
+		bit++;
+	}
+	if (bit >= nbits)
+		return 0;
+
+	*run_start = bit;
+	while (bit < nbits && len < max_len) {
+		if (!(bit & 7) && bmap[bit >> 3] == 0 &&
+		    bit + 8 <= nbits && len + 8 <= max_len) {
+			bit += 8;
+			len += 8;
+			continue;
+		}
+		if (bmap[bit >> 3] & (1 << (bit & 7)))
+			break;
+		bit++;
+		len++;
+	}
+
+	return len;
+}
+
+static int ext4fs_test_root(unsigned int a, unsigned int b)
+{
+	while (1) {
+		if (a < b)
+			return a == 1;
+		if (a % b)
+			return 0;
+		a /= b;
+	}
+}
+
+static int ext4fs_bg_has_super(unsigned int bg_idx)
+{
+	if (bg_idx <= 1 || !(ext4fs_root->sblock.feature_ro_compat &
+			     EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER))
+		return 1;
+	if (!(bg_idx & 1))
+		return 0;
+
+	return ext4fs_test_root(bg_idx, 3) || ext4fs_test_root(bg_idx, 5) ||
+		ext4fs_test_root(bg_idx, 7);
+}
+
+/*
+ * An uninitialised block group can only be handed out as one big run
+ * when it holds no metadata of its own, i.e. no superblock backup and
+ * its bitmaps and inode table live in another group (flex_bg). In that
+ * case its bitmap is all zero and is set up here.
+ */
+static int ext4fs_init_uninit_group(unsigned int bg_idx)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = &fs->bgd[bg_idx];
+	uint64_t first, last;
+	unsigned int bit;
+
+	if (fs->sb->feature_incompat & EXT4_FEATURE_INCOMPAT_META_BG ||
+	    ext4fs_bg_has_super(bg_idx))
+		return -1;
+
+	first = (uint64_t)bg_idx * ext4fs_root->sblock.blocks_per_group +
+		ext4fs_root->sblock.first_data_block;
+	last = first + ext4fs_group_nr_blocks(bg_idx);
+	if ((bgd->block_id >= first && bgd->block_id < last) ||
+	    (bgd->inode_id >= first && bgd->inode_id < last) ||
+	    (bgd->inode_table_id >= first && bgd->inode_table_id < last))
+		return -1;
+
+	memset(fs->blk_bmaps[bg_idx], 0, fs->blksz);
+	/* blocks past the end of a short last group stay marked in use */
+	for (bit = last - first; bit < fs->blksz * 8; bit++)
+		fs->blk_bmaps[bg_idx][bit >> 3] |= 1 << (bit & 7);
+	bgd->bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+	ext4fs_mark_bmap_dirty(fs->blk_bmaps_dirty, bg_idx);
+
+	return 0;
+}
+
+static void ext4fs_mark_run(unsigned int bg_idx, unsigned int start,
+			    unsigned int len, int used)
+{
+	struct ext_filesystem *fs = get_fs();
+	unsigned char *bmap = fs->blk_bmaps[bg_idx];
+	unsigned int bit;
+
+	for (bit = start; bit < start + len; bit++) {
+		if (used)
+			bmap[bit >> 3] |= 1 << (bit & 7);
+		else
+			bmap[bit >> 3] &= ~(1 << (bit & 7));
+	}
+
+	if (used) {
+		fs->bgd[bg_idx].free_blocks -= len;
+		fs->sb->free_blocks -= len;
+	} else {
+		fs->bgd[bg_idx].free_blocks += len;
+		fs->sb->free_blocks += len;
+	}
+	ext4fs_mark_bmap_dirty(fs->blk_bmaps_dirty, bg_idx);
+}
+
+/*
+ * Allocate the data blocks of a new file as a few contiguous runs which
+ * are described by extents kept in the inode itself, so that neither
+ * indirect blocks nor a bitmap lookup per block are needed. Returns -1
+ * with the bitmaps untouched when the filesystem has no extent support
+ * or the free space is too fragmented; the caller then falls back to
+ * ext4fs_allocate_blocks().
+ */
+int ext4fs_allocate_extents(struct ext2_inode *file_inode,
+			    unsigned int total_remaining_blocks)
+{
+	struct {
+		unsigned int bg_idx;
+		unsigned int start;
+		unsigned int len;
+	} runs[EXT4_EXT_INODE_ENTRIES];
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = fs->bgd;
+	struct ext4_extent_header *ext_header;
+	struct ext4_extent *extent;
+	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
+	unsigned int nr_runs = 0;
+	unsigned int fileblock = 0;
+	unsigned int bg_idx, bit, len, start, want, nbits;
+	unsigned int best_bg = 0, best_start = 0, best_len;
+	uint64_t blknr;
+	char *journal_buffer;
+	int i;
+
+	if (!(fs->sb->feature_incompat & EXT4_FEATURE_INCOMPAT_EXTENTS) ||
+	    !total_remaining_blocks)
+		return -1;
+
+	while (total_remaining_blocks && nr_runs < EXT4_EXT_INODE_ENTRIES) {
+		want = min(total_remaining_blocks, (unsigned int)EXT4_EXT_MAX_LEN);
+		best_len = 0;
+
+		/* take the first run long enough, else the longest one */
+		for (bg_idx = 0; bg_idx < fs->no_blkgrp && best_len < want;
+		     bg_idx++) {
+			if (bgd[bg_idx].free_blocks == 0)
+				continue;
+			if (bgd[bg_idx].bg_flags & EXT4_BG_BLOCK_UNINIT &&
+			    ext4fs_init_uninit_group(bg_idx))
+				continue;
+			nbits = ext4fs_group_nr_blocks(bg_idx);
+			bit = 0;
+			while (best_len < want) {
+				len = ext4fs_find_free_run(fs->blk_bmaps[bg_idx],
+							   nbits, bit, want,
+							   &start);
+				if (!len)
+					break;
+				if (len > best_len) {
+					best_bg = bg_idx;
+					best_start = start;
+					best_len = len;
+				}
+				bit = start + len;
+			}
+		}
+		if (!best_len)
+			break;
+
+		ext4fs_mark_run(best_bg, best_start, best_len, 1);
+		runs[nr_runs].bg_idx = best_bg;
+		runs[nr_runs].start = best_start;
+		runs[nr_runs].len = best_len;
+		nr_runs++;
+		total_remaining_blocks -= best_len;
+	}
+
+	if (total_remaining_blocks) {
+		debug("free space too fragmented for extents\n");
+		while (nr_runs--)
+			ext4fs_mark_run(runs[nr_runs].bg_idx,
+					runs[nr_runs].start,
+					runs[nr_runs].len, 0);
+		return -1;
+	}
+
+	/* journal backup of every block bitmap touched */
+	journal_buffer = zalloc(fs->blksz);
+	if (!journal_buffer)
+		goto fail;
+	for (i = 0; i < nr_runs; i++) {
+		bg_idx = runs[i].bg_idx;
+		if (!ext4fs_devread((lbaint_t)bgd[bg_idx].block_id *
+				    fs->sect_perblk, 0, fs->blksz,
+				    journal_buffer) ||
+		    ext4fs_log_journal(journal_buffer, bgd[bg_idx].block_id)) {
+			free(journal_buffer);
+			goto fail;
+		}
+	}
+	free(journal_buffer);
+
+	memset(&file_inode->b, 0, sizeof(file_inode->b));
+	ext_header = (struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	ext_header->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	ext_header->eh_entries = cpu_to_le16(nr_runs);
+	ext_header->eh_max = cpu_to_le16(EXT4_EXT_INODE_ENTRIES);
+	ext_header->eh_depth = 0;
+
+	extent = (struct ext4_extent *)(ext_header + 1);
+	for (i = 0; i < nr_runs; i++) {
+		blknr = (uint64_t)runs[i].bg_idx * blk_per_grp +
+			ext4fs_root->sblock.first_data_block + runs[i].start;
+		extent[i].ee_block = cpu_to_le32(fileblock);
+		extent[i].ee_len = cpu_to_le16(runs[i].len);
+		extent[i].ee_start_hi = cpu_to_le16(blknr >> 32);
+		extent[i].ee_start_lo = cpu_to_le32(blknr & 0xffffffff);
+		debug("EXT %u: %u blocks at %llu\n", fileblock, runs[i].len,
+		      (unsigned long long)blknr);
+		fileblock += runs[i].len;
+	}
+	file_inode->flags |= cpu_to_le32(EXT4_EXTENTS_FL);
+
+	return 0;
+fail:
+	while (nr_runs--)
+		ext4fs_mark_run(runs[nr_runs].bg_idx, runs[nr_runs].start,
+				runs[nr_runs].len, 0);
+	return -1;
+}
+
 #endif
 
 static struct ext4_extent_header *ext4fs_get_extent_block
@@ -74,5 +74,13 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block);
 void put_ext4(uint64_t off, void *buf, uint32_t size);
+int ext4fs_allocate_extents(struct ext2_inode *file_inode,
+			    unsigned int total_remaining_blocks);
+
+static inline void ext4fs_mark_bmap_dirty(char *dirty, int index)
+{
+	if (dirty)
+		dirty[index] = 1;
+}
 #endif
 #endif
@@ -27,6 +27,48 @@
 #include <div64.h>
 #include "ext4_common.h"
 
+/* Max bitmap blocks merged into one device write by ext4fs_flush_bmaps() */
+#define EXT4_BMAP_WRITE_BATCH	16
+
+static uint32_t ext4fs_bmap_blkno(int group, int inode)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	return inode ? fs->bgd[group].inode_id : fs->bgd[group].block_id;
+}
+
+/*
+ * Write back the bitmaps of the groups marked dirty. Bitmaps which sit
+ * in consecutive disk blocks, as they do with flex_bg, are gathered and
+ * written with a single device access.
+ */
+static void ext4fs_flush_bmaps(unsigned char **bmaps, char *dirty, int inode)
+{
+	struct ext_filesystem *fs = get_fs();
+	char *batch = zalloc(EXT4_BMAP_WRITE_BATCH * fs->blksz);
+	uint32_t start;
+	int i, n;
+
+	for (i = 0; i < fs->no_blkgrp; i += n) {
+		n = 1;
+		if (dirty && !dirty[i])
+			continue;
+
+		start = ext4fs_bmap_blkno(i, inode);
+		if (!batch) {
+			put_ext4((uint64_t)start * fs->blksz, bmaps[i],
+				 fs->blksz);
+			continue;
+		}
+		for (n = 0; i + n < fs->no_blkgrp &&
+		     n < EXT4_BMAP_WRITE_BATCH && (!dirty || dirty[i + n]) &&
+		     ext4fs_bmap_blkno(i + n, inode) == start + n; n++)
+			memcpy(batch + n * fs->blksz, bmaps[i + n], fs->blksz);
+		put_ext4((uint64_t)start * fs->blksz, batch, n * fs->blksz);
+	}
+	free(batch);
+}
+
 static void ext4fs_update(void)
 {
 	short i;
@@ -38,17 +80,12 @@ static void ext4fs_update(void)
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
 	/* update block groups */
-	for (i = 0; i < fs->no_blkgrp; i++) {
+	for (i = 0; i < fs->no_blkgrp; i++)
 		fs->bgd[i].bg_checksum = ext4fs_checksum_update(i);
-		put_ext4((uint64_t)((uint64_t)fs->bgd[i].block_id * (uint64_t)fs->blksz),
-			 fs->blk_bmaps[i], fs->blksz);
-	}
+	ext4fs_flush_bmaps(fs->blk_bmaps, fs->blk_bmaps_dirty, 0);
 
 	/* update inode table groups */
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		put_ext4((uint64_t) ((uint64_t)fs->bgd[i].inode_id * (uint64_t)fs->blksz),
-			 fs->inode_bmaps[i], fs->blksz);
-	}
+	ext4fs_flush_bmaps(fs->inode_bmaps, fs->inode_bmaps_dirty, 1);
 
 	/* update the block group descriptor table */
 	put_ext4((uint64_t)((uint64_t)fs->gdtable_blkno * (uint64_t)fs->blksz),
@@ -636,6 +673,10 @@ int ext4fs_init(void)
 			goto fail;
 	}
 
+	fs->blk_bmaps_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->blk_bmaps_dirty)
+		goto fail;
+
 	/* load all the available inode bitmap of the partition */
 	fs->inode_bmaps = zalloc(fs->no_blkgrp * sizeof(unsigned char *));
 	if (!fs->inode_bmaps)
@@ -655,6 +696,10 @@ int ext4fs_init(void)
 			goto fail;
 	}
 
+	fs->inode_bmaps_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->inode_bmaps_dirty)
+		goto fail;
+
 	/*
 	 * check filesystem consistency with free blocks of file system
 	 * some time we observed that superblock freeblocks does not match
@@ -724,6 +769,11 @@ void ext4fs_deinit(void)
 		fs->inode_bmaps = NULL;
 	}
 
+	free(fs->blk_bmaps_dirty);
+	fs->blk_bmaps_dirty = NULL;
+	free(fs->inode_bmaps_dirty);
+	fs->inode_bmaps_dirty = NULL;
+
 
 	free(fs->gdtable);
 	fs->gdtable = NULL;
@@ -817,6 +867,50 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 	return len;
 }
 
+/*
+ * Write the data of a file whose blocks were laid out by
+ * ext4fs_allocate_extents(): one device write per extent, with only the
+ * partial last block bounced through a zeroed buffer.
+ */
+static int ext4fs_write_extents(struct ext2_inode *file_inode,
+				unsigned int len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_header *ext_header;
+	struct ext4_extent *extent;
+	uint64_t start, bytes, tail;
+	char *tail_buf;
+	int i;
+
+	ext_header = (struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	extent = (struct ext4_extent *)(ext_header + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_header->eh_entries); i++) {
+		start = le16_to_cpu(extent[i].ee_start_hi);
+		start = (start << 32) + le32_to_cpu(extent[i].ee_start_lo);
+		bytes = (uint64_t)le16_to_cpu(extent[i].ee_len) * fs->blksz;
+		if (bytes > len)
+			bytes = len;
+
+		tail = bytes & (fs->blksz - 1);
+		if (bytes - tail)
+			put_ext4(start * fs->blksz, buf, bytes - tail);
+		if (tail) {
+			tail_buf = zalloc(fs->blksz);
+			if (!tail_buf)
+				return -1;
+			memcpy(tail_buf, buf + bytes - tail, tail);
+			put_ext4((start * fs->blksz) + bytes - tail, tail_buf,
+				 fs->blksz);
+			free(tail_buf);
+		}
+		buf += bytes;
+		len -= bytes;
+	}
+
+	return 0;
+}
+
 int ext4fs_write(const char *fname, unsigned char *buffer,
 					unsigned long sizebytes)
 {
@@ -838,6 +932,7 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	struct ext2_sblock *sblock = &(ext4fs_root->sblock);
 	unsigned int inodes_per_block;
 	unsigned int ibmap_idx;
+	int extents;
 	struct ext_filesystem *fs = get_fs();
 	ALLOC_CACHE_ALIGN_BUFFER(char, filename, 256);
 	memset(filename, 0x00, 256);
@@ -897,9 +992,11 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	file_inode->nlinks = 1;
 	file_inode->size = sizebytes;
 
-	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	/* Allocate data blocks, contiguously where the filesystem allows */
+	extents = !ext4fs_allocate_extents(file_inode, blocks_remaining);
+	if (!extents)
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
 	file_inode->blockcnt = (blks_reqd_for_file * fs->blksz) >>
 		fs->dev_desc->log2blksz;
 
@@ -921,7 +1018,13 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	if (ext4fs_put_metadata(temp_ptr, itable_blkno))
 		goto fail;
 	/* copy the file content into data blocks */
-	if (ext4fs_write_file(file_inode, 0, sizebytes, (char *)buffer) == -1) {
+	if (extents)
+		ret = ext4fs_write_extents(file_inode, sizebytes,
+					   (char *)buffer);
+	else
+		ret = ext4fs_write_file(file_inode, 0, sizebytes,
+					(char *)buffer);
+	if (ret == -1) {
 		printf("Error in copying content\n");
 		goto fail;
 	}
@@ -96,37 +96,147 @@ static void set_name(dir_entry *dirent, const char *filename)
 }
 
 static __u8 num_of_fats;
+/* Sectors of the FAT buffer modified since it was last written back */
+static __u32 fatbuf_dirty;
+
 /*
- * Write fat buffer into block device
+ * Write the modified sectors of the fat buffer into block device
  */
 static int flush_fat_buffer(fsdata *mydata)
 {
-	int getsize = FATBUFBLOCKS;
-	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
 	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr;
+	int first, count;
 
 	startblock += mydata->fat_sect;
 
-	if (getsize > fatlength)
-		getsize = fatlength;
+	for (first = 0; first < FATBUFBLOCKS; first += count) {
+		count = 1;
+		if (!(fatbuf_dirty & (1 << first)))
+			continue;
+		while (first + count < FATBUFBLOCKS &&
+		       fatbuf_dirty & (1 << (first + count)))
+			count++;
+		bufptr = mydata->fatbuf + first * mydata->sect_size;
+
+		/* Write FAT buf */
+		if (disk_write(startblock + first, count, bufptr) < 0) {
+			debug("error: writing FAT blocks\n");
+			return -1;
+		}
 
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
+		if (num_of_fats == 2) {
+			/* Update corresponding second FAT blocks */
+			if (disk_write(startblock + first + mydata->fatlength,
+				       count, bufptr) < 0) {
+				debug("error: writing second FAT blocks\n");
+				return -1;
+			}
+		}
 	}
+	fatbuf_dirty = 0;
 
-	if (num_of_fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
-			return -1;
+	return 0;
+}
+
+/*
+ * In-memory map of the clusters in use, built with one pass over the FAT
+ * so that allocating a cluster does not need to walk the FAT itself.
+ * A set bit means the cluster is allocated.
+ */
+static __u8 *clust_map;
+static __u32 clust_map_size;	/* number of FAT entries covered */
+
+#define CLUST_MAP_READ_BLOCKS	64
+
+static void clust_map_set(__u32 entry, int used)
+{
+	if (!clust_map || entry >= clust_map_size)
+		return;
+
+	if (used)
+		clust_map[entry >> 3] |= 1 << (entry & 7);
+	else
+		clust_map[entry >> 3] &= ~(1 << (entry & 7));
+}
+
+/*
+ * Return the first cluster at or after 'entry' the map records as free,
+ * or the first entry past the map if there is none.
+ */
+static __u32 clust_map_next_free(__u32 entry)
+{
+	if (!clust_map)
+		return entry;
+
+	while (entry < clust_map_size) {
+		if (!(entry & 7) && clust_map[entry >> 3] == 0xff) {
+			entry += 8;
+			continue;
+		}
+		if (!(clust_map[entry >> 3] & (1 << (entry & 7))))
+			return entry;
+		entry++;
+	}
+
+	return clust_map_size;
+}
+
+static void clust_map_free(void)
+{
+	free(clust_map);
+	clust_map = NULL;
+	clust_map_size = 0;
+}
+
+/*
+ * Build the cluster map from the first FAT. FAT12, which this writer
+ * does not support anyway, keeps walking the FAT on every allocation.
+ */
+static int clust_map_init(fsdata *mydata, __u32 nr_entries)
+{
+	__u32 per_sect = mydata->sect_size / (mydata->fatsize / 8);
+	__u32 entry = 0, sect, nsect, i, val;
+	__u8 *buf;
+
+	if (mydata->fatsize != 16 && mydata->fatsize != 32)
+		return -1;
+
+	if (nr_entries > mydata->fatlength * per_sect)
+		nr_entries = mydata->fatlength * per_sect;
+
+	clust_map = calloc(DIV_ROUND_UP(nr_entries, 8), 1);
+	buf = memalign(ARCH_DMA_MINALIGN,
+		       CLUST_MAP_READ_BLOCKS * mydata->sect_size);
+	if (!clust_map || !buf)
+		goto fail;
+	clust_map_size = nr_entries;
+
+	for (sect = 0; entry < nr_entries; sect += nsect) {
+		nsect = min_t(__u32, CLUST_MAP_READ_BLOCKS,
+			      mydata->fatlength - sect);
+		if (disk_read(mydata->fat_sect + sect, nsect, buf) < 0)
+			goto fail;
+
+		for (i = 0; i < nsect * per_sect && entry < nr_entries;
+		     i++, entry++) {
+			if (mydata->fatsize == 32)
+				val = FAT2CPU32(((__u32 *)buf)[i]) & 0xfffffff;
+			else
+				val = FAT2CPU16(((__u16 *)buf)[i]);
+			/* entries 0 and 1 are reserved */
+			if (val || entry < 2)
+				clust_map_set(entry, 1);
 		}
 	}
 
+	free(buf);
 	return 0;
+fail:
+	debug("Error: building cluster map\n");
+	free(buf);
+	clust_map_free();
+	return -1;
 }
 
 /*
@@ -508,13 +618,16 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	switch (mydata->fatsize) {
 	case 32:
 		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		fatbuf_dirty |= 1 << (offset * 4 / mydata->sect_size);
 		break;
 	case 16:
 		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		fatbuf_dirty |= 1 << (offset * 2 / mydata->sect_size);
 		break;
 	default:
 		return -1;
 	}
+	clust_map_set(entry, entry_value != 0);
 
 	return 0;
 }
@@ -524,7 +637,7 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
  */
 static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	__u32 next_fat, next_entry = clust_map_next_free(entry + 1);
 
 	while (1) {
 		next_fat = get_fatent_value(mydata, next_entry);
@@ -589,7 +702,7 @@ set_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer,
  */
 static int find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
+	__u32 fat_val, entry = clust_map_next_free(3);
 
 	while (1) {
 		fat_val = get_fatent_value(mydata, entry);
@@ -623,9 +736,6 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 
 	dir_curclust = dir_newclust;
 
-	if (flush_fat_buffer(mydata) < 0)
-		return;
-
 	memset(get_dentfromdir_block, 0x00,
 		mydata->clust_size * mydata->sect_size);
 
@@ -652,10 +762,6 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_fat_buffer(mydata) < 0)
-		return -1;
-
 	return 0;
 }
 
@@ -988,6 +1094,11 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	fatbuf_dirty = 0;
+
+	/* Without the map, allocation falls back to walking the FAT */
+	clust_map_init(mydata, (total_sector - mydata->data_begin) /
+		       mydata->clust_size);
 
 	if (disk_read(cursect,
 		(mydata->fatsize == 32) ?
@@ -1098,6 +1209,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 	}
 
 exit:
+	clust_map_free();
 	free(mydata->fatbuf);
 	return ret;
 }
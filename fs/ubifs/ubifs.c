@@ -668,6 +668,100 @@ dump:
 	return -EINVAL;
 }
 
+/*
+ * Read the data nodes of up to @max_blocks consecutive blocks of @inode,
+ * starting at @block, with a single LEB read when they sit next to each
+ * other on the flash. Returns the number of blocks filled in at @addr,
+ * 0 when bulk-read does not apply here, or a negative error code.
+ */
+static int do_bulk_read(struct ubifs_info *c, struct inode *inode,
+			unsigned int block, unsigned int max_blocks, void *addr)
+{
+	struct bu_info *bu = &c->bu;
+	struct ubifs_data_node *dn;
+	int err, n, nn = 0, len, dlen, out_len, blk_cnt;
+
+	if (!c->bulk_read || !bu->buf)
+		return 0;
+
+	bu->buf_len = c->max_bu_buf_len;
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+
+	/* Leave holes at the start and lone nodes to do_readpage() */
+	if (bu->cnt < 2 || key_block(c, &bu->zbranch[0].key) != block)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err == -EAGAIN ? 0 : err;
+
+	blk_cnt = min_t(int, bu->blk_cnt, max_blocks);
+	for (n = 0; n < blk_cnt; n++, addr += UBIFS_BLOCK_SIZE) {
+		if (nn >= bu->cnt ||
+		    key_block(c, &bu->zbranch[nn].key) != block + n) {
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+
+		dn = bu->buf + (bu->zbranch[nn].offs - bu->zbranch[0].offs);
+		len = le32_to_cpu(dn->size);
+		if (len <= 0 || len > UBIFS_BLOCK_SIZE)
+			goto dump;
+
+		dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
+		out_len = UBIFS_BLOCK_SIZE;
+		err = ubifs_decompress(&dn->data, dlen, addr, &out_len,
+				       le16_to_cpu(dn->compr_type));
+		if (err || len != out_len)
+			goto dump;
+
+		if (len < UBIFS_BLOCK_SIZE)
+			memset(addr + len, 0, UBIFS_BLOCK_SIZE - len);
+		nn++;
+	}
+
+	return blk_cnt;
+
+dump:
+	ubifs_err("bad data node (block %u, inode %lu)",
+		  block + n, inode->i_ino);
+	ubifs_dump_node(c, dn);
+	return -EINVAL;
+}
+
+/*
+ * The TNC is kept across loads so that looking up files of the same
+ * mount hits znodes already in memory. Once it holds more clean znodes
+ * than this, everything below the root is dropped and re-read on demand.
+ */
+#ifndef CONFIG_UBIFS_ZNODE_CACHE_MAX
+#define CONFIG_UBIFS_ZNODE_CACHE_MAX	8192
+#endif
+
+static void ubifs_tnc_trim(struct ubifs_info *c)
+{
+	struct ubifs_znode *root = c->zroot.znode;
+	long freed;
+	int n;
+
+	if (!root || root->level == 0 ||
+	    atomic_long_read(&c->clean_zn_cnt) <= CONFIG_UBIFS_ZNODE_CACHE_MAX)
+		return;
+
+	for (n = 0; n < root->child_cnt; n++) {
+		if (!root->zbranch[n].znode)
+			continue;
+		freed = ubifs_destroy_tnc_subtree(root->zbranch[n].znode);
+		atomic_long_sub(freed, &c->clean_zn_cnt);
+		atomic_long_sub(freed, &ubifs_clean_zn_cnt);
+		root->zbranch[n].znode = NULL;
+	}
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -786,11 +880,12 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	struct inode *inode;
 	struct page page;
 	int err = 0;
-	int i;
+	int i, n;
 	int count;
 	int last_block_size = 0;
 
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	ubifs_tnc_trim(c);
 	/* ubifs_findfile will resolve symlinks, so we know that we get
 	 * the real file here */
 	inum = ubifs_findfile(ubifs_sb, filename);
@@ -823,19 +918,34 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	page.addr = (void *)(unsigned long)addr;
 	page.index = 0;
 	page.inode = inode;
-	for (i = 0; i < count; i++) {
+	for (i = 0; i < count; i += n) {
 		/*
-		 * Make sure to not read beyond the requested size
+		 * All but the last block may be bulk-read straight into the
+		 * destination; the last one must not overrun the requested
+		 * size.
 		 */
-		if (((i + 1) == count) && (size < inode->i_size))
-			last_block_size = size - (i * PAGE_SIZE);
-
-		err = do_readpage(c, inode, &page, last_block_size);
-		if (err)
+		n = do_bulk_read(c, inode, page.index, count - i - 1,
+				 page.addr);
+		if (n < 0) {
+			err = n;
 			break;
+		}
+
+		if (!n) {
+			/*
+			 * Make sure to not read beyond the requested size
+			 */
+			if (((i + 1) == count) && (size < inode->i_size))
+				last_block_size = size - (i * PAGE_SIZE);
+
+			err = do_readpage(c, inode, &page, last_block_size);
+			if (err)
+				break;
+			n = 1;
+		}
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+		page.addr += n * PAGE_SIZE;
+		page.index += n;
 	}
 
 	if (err)
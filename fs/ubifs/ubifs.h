@@ -65,11 +65,13 @@ void iput(struct inode *inode);
 
 /*
  * The atomic operations are used for budgeting etc which is not
- * needed for the read-only U-Boot implementation:
+ * needed for the read-only U-Boot implementation. They are kept as
+ * plain counters since the clean znode count bounds the TNC cache:
  */
-#define atomic_long_inc(a)
-#define atomic_long_dec(a)
-#define	atomic_long_sub(a, b)
+#define atomic_long_inc(a)	(*(a) += 1)
+#define atomic_long_dec(a)	(*(a) -= 1)
+#define	atomic_long_sub(a, b)	(*(b) -= (a))
+#define atomic_long_read(a)	(*(a))
 
 typedef unsigned long atomic_long_t;
 
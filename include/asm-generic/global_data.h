@@ -47,6 +47,9 @@ typedef struct global_data {
 #ifdef CONFIG_PRE_CONSOLE_BUFFER
 	unsigned long precon_buf_idx;	/* Pre-Console buffer index */
 #endif
+#ifdef CONFIG_CONSOLE_RING
+	unsigned long con_ring_pending;	/* Console ring bytes not sent yet */
+#endif
 #ifdef CONFIG_MODEM_SUPPORT
 	unsigned long do_mdm_init;
 	unsigned long be_quiet;
@@ -68,9 +71,14 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+	struct dm_index	*dm_index;	/* Lookup tables, after relocation */
+	struct dm_compat_index *dm_compat; /* Drivers by compatible string */
 #endif
 
 	const void *fdt_blob;	/* Our device tree, NULL if none */
+#ifdef CONFIG_FDT_INDEX
+	struct fdt_index *fdt_index;	/* Lookup index for one tree */
+#endif
 	void *new_fdt;		/* Relocated FDT */
 	unsigned long fdt_size;	/* Space reserved for relocated FDT */
 	void **jt;		/* jump table */
@@ -109,5 +117,6 @@ typedef struct global_data {
 #define GD_FLG_ENV_READY	0x00080	/* Env. imported into hash table   */
 #define GD_FLG_SERIAL_READY	0x00100	/* Pre-reloc serial console ready  */
 #define GD_FLG_FULL_MALLOC_INIT	0x00200	/* Full malloc() is ready	   */
+#define GD_FLG_CON_RING_BUSY	0x00400	/* Console ring is being sent	   */
 
 #endif /* __ASM_GENERIC_GBL_DATA_H */
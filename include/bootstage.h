@@ -20,6 +20,33 @@
 enum bootstage_flags {
 	BOOTSTAGEF_ERROR	= 1 << 0,	/* Error record */
 	BOOTSTAGEF_ALLOC	= 1 << 1,	/* Allocate an id */
+	BOOTSTAGEF_SPAN		= 1 << 2,	/* Span from start_us to time_us */
+};
+
+/*
+ * Stashed bootstage data: a struct bootstage_hdr, then "count" struct
+ * bootstage_stash_rec, then the name and group of each record as two
+ * strings (the group empty if the record has none). Everything is in the
+ * byte order of the machine that stashed it.
+ */
+enum {
+	BOOTSTAGE_VERSION	= 1,
+	BOOTSTAGE_MAGIC		= 0xb00757a3,
+};
+
+struct bootstage_hdr {
+	uint32_t version;	/* BOOTSTAGE_VERSION */
+	uint32_t count;		/* Number of records */
+	uint32_t size;		/* Total data size (non-zero if valid) */
+	uint32_t magic;		/* BOOTSTAGE_MAGIC */
+};
+
+struct bootstage_stash_rec {
+	uint32_t time_us;
+	uint32_t start_us;
+	uint32_t flags;		/* see enum bootstage_flags */
+	uint32_t id;
+	uint64_t addr;		/* Code address, if the record has no name */
 };
 
 /* bootstate sub-IDs used for kernel and ramdisk ranges */
@@ -194,6 +221,9 @@ enum bootstage_id {
 	BOOTSTAGE_ID_MAIN_CPU_READY,
 
 	BOOTSTAGE_ID_ACCUM_LCD,
+	BOOTSTAGE_ID_ACCUM_UBI_ATTACH,
+	BOOTSTAGE_ID_ACCUM_ASYNC_WAIT,
+	BOOTSTAGE_ID_ACCUM_ASYNC_SAVED,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -294,6 +324,49 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Add time measured some other way to an accumulator
+ *
+ * @param id	Bootstage id of the accumulator
+ * @param name	Textual name to display for this id in the report
+ * @param duration	Time to add, in microseconds
+ * @return total time accumulated
+ */
+uint32_t bootstage_accum_time(enum bootstage_id id, const char *name,
+			      uint32_t duration);
+
+/**
+ * Record a span of time spent by a subsystem
+ *
+ * Spans are recorded automatically for initcalls, driver probes and some
+ * storage operations when CONFIG_BOOTSTAGE_SPAN is defined. They take up
+ * one user record each and may nest.
+ *
+ * @param group	Subsystem, e.g. "initcall" or the name of a uclass
+ * @param name	What was done, or NULL to show the code address instead
+ * @param addr	Code address (as linked) of what was done, or 0
+ * @param start	Start time, from bootstage_span_start()
+ */
+#ifdef CONFIG_BOOTSTAGE_SPAN
+void bootstage_span(const char *group, const char *name, ulong addr,
+		    ulong start);
+
+static inline ulong bootstage_span_start(void)
+{
+	return timer_get_boot_us();
+}
+#else
+static inline void bootstage_span(const char *group, const char *name,
+				  ulong addr, ulong start)
+{
+}
+
+static inline ulong bootstage_span_start(void)
+{
+	return 0;
+}
+#endif
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -325,6 +398,18 @@ int bootstage_stash(void *base, int size);
  */
 int bootstage_unstash(void *base, int size);
 
+/**
+ * Compare this boot with stashed bootstage data
+ *
+ * Prints the times of marks, accumulators and spans found in both, and
+ * the records found in only one of them.
+ *
+ * @param base	Base address of the stashed data, e.g. from an earlier boot
+ * @param size	Size of memory buffer (-1 if unknown)
+ * @return 0 if ok, -1 if bootstage info not found
+ */
+int bootstage_diff(const void *base, int size);
+
 #else
 static inline ulong bootstage_add_record(enum bootstage_id id,
 		const char *name, int flags, ulong mark)
@@ -376,6 +461,13 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_time(enum bootstage_id id,
+					    const char *name,
+					    uint32_t duration)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -385,6 +477,16 @@ static inline int bootstage_unstash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
 }
+
+static inline void bootstage_span(const char *group, const char *name,
+				  ulong addr, ulong start)
+{
+}
+
+static inline ulong bootstage_span_start(void)
+{
+	return 0;
+}
 #endif /* CONFIG_BOOTSTAGE */
 
 /* Helper macro for adding a bootstage to a line of code */
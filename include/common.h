@@ -572,6 +572,8 @@ void	serial_putc_raw(const char);
 void	serial_puts   (const char *);
 int	serial_getc   (void);
 int	serial_tstc   (void);
+int	serial_tx_space(void);
+void	serial_flush  (void);
 
 /* These versions take a stdio_dev pointer */
 struct stdio_dev;
@@ -776,9 +778,21 @@ int	printf(const char *fmt, ...)
 		__attribute__ ((format (__printf__, 1, 2)));
 int	vprintf(const char *fmt, va_list args);
 
-#ifdef CONFIG_SILENT_CONSOLE
+#ifdef CONFIG_CONSOLE_RING
+void	console_poll(void);	/* Feed queued output to the UART	*/
+void	console_flush(void);	/* Send all of it, before OS hand-off	*/
+#else
+static inline void console_poll(void) {}
+static inline void console_flush(void) {}
+#endif
+
+/* Without the ring, output is held back in a buffer while silent */
+#if defined(CONFIG_SILENT_CONSOLE) && !defined(CONFIG_CONSOLE_RING)
 extern void flush_print_buf(void);
 extern void destory_print_buf(void);
+#else
+static inline void flush_print_buf(void) {}
+static inline void destory_print_buf(void) {}
 #endif
 
 /* stderr */
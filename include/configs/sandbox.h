@@ -31,6 +31,7 @@
 #define CONFIG_DM_DEMO_SHAPE
 #define CONFIG_DM_GPIO
 #define CONFIG_DM_TEST
+#define CONFIG_DM_PROBE_TIMES
 #define CONFIG_DM_SERIAL
 #define CONFIG_DM_CROS_EC
 
@@ -26,6 +26,15 @@ struct driver_info;
 /* DM should init this device prior to relocation */
 #define DM_FLAG_PRE_RELOC	(1 << 2)
 
+/* Keys that devices are hashed on for lookup, see struct dm_index */
+enum dm_hash_type {
+	DM_HASH_SEQ,
+	DM_HASH_REQ_SEQ,
+	DM_HASH_OF_OFFSET,
+
+	DM_HASH_COUNT,
+};
+
 /**
  * struct udevice - An instance of a driver
  *
@@ -60,6 +69,9 @@ struct driver_info;
  * @req_seq: Requested sequence number for this device (-1 = any)
  * @seq: Allocated sequence number for this device (-1 = none). This is set up
  * when the device is probed and will be unique within the device's uclass.
+ * @hash_node: Links the device into the lookup tables, one per DM_HASH_...
+ * @probe_us: Time taken to probe this device in microseconds, not counting
+ * its parents or other devices probed meanwhile (CONFIG_DM_PROBE_TIMES)
  */
 struct udevice {
 	struct driver *driver;
@@ -78,6 +90,10 @@ struct udevice {
 	uint32_t flags;
 	int req_seq;
 	int seq;
+	struct hlist_node hash_node[DM_HASH_COUNT];
+#ifdef CONFIG_DM_PROBE_TIMES
+	ulong probe_us;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -207,6 +223,17 @@ void *dev_get_parentdata(struct udevice *dev);
  */
 void *dev_get_priv(struct udevice *dev);
 
+/**
+ * dev_set_of_offset() - Change the device tree node of a device
+ *
+ * Use this rather than writing dev->of_offset, so that the device can
+ * still be found by its node.
+ *
+ * @dev		Device to update
+ * @of_offset	New device tree node offset, or -1 for none
+ */
+void dev_set_of_offset(struct udevice *dev, int of_offset);
+
 /**
  * struct dev_get_parent() - Get the parent of a device
  *
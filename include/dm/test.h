@@ -113,6 +113,8 @@ extern struct dm_test_state global_test_state;
  * @force_fail_alloc: Force all memory allocs to fail
  * @skip_post_probe: Skip uclass post-probe processing
  * @removed: Used to keep track of a device that was removed
+ * @probe_delay_us: Time the manual test driver spends in its probe
+ * @probe_nested: Device the manual test driver probes from its probe
  */
 struct dm_test_state {
 	struct udevice *root;
@@ -121,6 +123,8 @@ struct dm_test_state {
 	int force_fail_alloc;
 	int skip_post_probe;
 	struct udevice *removed;
+	int probe_delay_us;
+	struct udevice *probe_nested;
 	struct mallinfo start;
 };
 
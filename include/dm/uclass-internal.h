@@ -10,6 +10,26 @@
 #ifndef _DM_UCLASS_INTERNAL_H
 #define _DM_UCLASS_INTERNAL_H
 
+#include <dm/device.h>
+
+/* Each lookup table has 1 << DM_HASH_BITS buckets */
+#define DM_HASH_BITS	6
+
+/**
+ * struct dm_index - Lookup tables for driver model
+ *
+ * This is set up by dm_init() once U-Boot has relocated. Before that there
+ * are only a few devices and not much memory, so the lists are searched.
+ *
+ * @uclass: Each uclass that exists, indexed by its id
+ * @hash: Devices hashed by uclass id and the key of each DM_HASH_... type.
+ * Devices with equal keys are kept in the order they were bound.
+ */
+struct dm_index {
+	struct uclass *uclass[UCLASS_COUNT];
+	struct hlist_head hash[DM_HASH_COUNT][1 << DM_HASH_BITS];
+};
+
 /**
  * uclass_find_device() - Return n-th child of uclass
  * @id:		Id number of the uclass
@@ -105,4 +125,26 @@ int uclass_destroy(struct uclass *uc);
 int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 			      bool find_req_seq, struct udevice **devp);
 
+/**
+ * uclass_hash_device() - Add a device to a lookup table
+ *
+ * The device is hashed on the current value of the key, which must be set
+ * up first. Nothing is done if the key is -1, or before relocation.
+ *
+ * @dev:	Pointer to the device
+ * @type:	Table to add to (DM_HASH_...)
+ */
+void uclass_hash_device(struct udevice *dev, enum dm_hash_type type);
+
+/**
+ * uclass_unhash_device() - Remove a device from a lookup table
+ *
+ * This must be called before the key is changed. It is safe to call it
+ * for a device which is not in the table.
+ *
+ * @dev:	Pointer to the device
+ * @type:	Table to remove from (DM_HASH_...)
+ */
+void uclass_unhash_device(struct udevice *dev, enum dm_hash_type type);
+
 #endif
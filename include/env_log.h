@@ -0,0 +1,65 @@
+/*
+ * Environment change log
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __ENV_LOG_H__
+#define __ENV_LOG_H__
+
+#include <environment.h>
+
+/*
+ * Instead of rewriting the whole environment on every "saveenv", only the
+ * variables changed since the last save are appended to a log area next
+ * to it. Each save adds one batch, starting on a block boundary:
+ *
+ *	struct env_log_hdr, then "name=value\0" for a set variable and
+ *	"name\0" for a deleted one, terminated by an empty string
+ *
+ * A batch applies to the environment copy whose CRC it carries in "base"
+ * and has a higher sequence number than the one before it. When the log is
+ * full the environment is written out in full and the log starts over.
+ */
+#define ENV_LOG_MAGIC	0x4c564e45	/* "ENVL" */
+
+struct env_log_hdr {
+	uint32_t	magic;
+	uint32_t	base;		/* CRC of the environment copy	*/
+	uint32_t	seq;		/* sequence number of the batch	*/
+	uint32_t	len;		/* length of the records	*/
+	uint32_t	crc;		/* CRC32 over the records	*/
+	uint32_t	hdr_crc;	/* CRC32 over the fields above	*/
+};
+
+/*
+ * Apply the log read from storage to the environment just imported from
+ * "env". "blksz" is the write granularity of the storage. "env" is NULL
+ * if no valid copy was found and "log" is NULL if it could not be read;
+ * the next save then writes the environment in full. Returns the number
+ * of batches applied.
+ */
+int env_log_load(const char *log, size_t size, size_t blksz,
+		 const env_t *env);
+
+/*
+ * Build a batch with the changes since the last save. On success *batch
+ * and *len describe what to write at env_log_end(); *len is 0 if nothing
+ * changed. Returns -ENOSPC when the environment has to be saved in full.
+ */
+int env_log_prepare(char **batch, size_t *len);
+
+/*
+ * Start the log over after the environment was saved in full, to a copy
+ * with CRC "base". *batch and *len describe what to write at the start
+ * of the log area.
+ */
+int env_log_reset(uint32_t base, char **batch, size_t *len);
+
+/* Offset in the log area the next batch goes to */
+size_t env_log_end(void);
+
+/* Call once the batch from env_log_prepare/reset() has been written */
+void env_log_commit(void);
+
+#endif /* __ENV_LOG_H__ */
@@ -184,6 +184,9 @@ extern void env_reloc(void);
 #include <mmc.h>
 
 extern int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr);
+# ifdef CONFIG_ENV_LOG
+extern int mmc_get_env_log_addr(struct mmc *mmc, u32 *log_addr);
+# endif
 # ifdef CONFIG_SYS_MMC_ENV_PART
 extern uint mmc_get_env_part(struct mmc *mmc);
 # endif
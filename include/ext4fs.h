@@ -32,7 +32,11 @@
 #define EXT4_EXT_MAGIC			0xf30a
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
+#define EXT4_FEATURE_INCOMPAT_META_BG	0x0010
+#define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
 #define EXT4_INDIRECT_BLOCKS		12
+#define EXT4_EXT_MAX_LEN		32768 /* longest initialized extent */
+#define EXT4_EXT_INODE_ENTRIES		4 /* extents held in the inode itself */
 
 #define EXT4_BG_INODE_UNINIT		0x0001
 #define EXT4_BG_BLOCK_UNINIT		0x0002
@@ -101,11 +105,15 @@ struct ext_filesystem {
 	unsigned char **blk_bmaps;
 	long int curr_blkno;
 	uint16_t first_pass_bbmap;
+	/* Groups whose block bitmap needs writing back */
+	char *blk_bmaps_dirty;
 
 	/* Inode Bitmap Related */
 	unsigned char **inode_bmaps;
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
+	/* Groups whose inode bitmap needs writing back */
+	char *inode_bmaps_dirty;
 
 	/* Journal Related */
 
@@ -0,0 +1,62 @@
+/*
+ * Fastboot commands, independent of the transport (USB or UDP)
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _FB_COMMAND_H_
+#define _FB_COMMAND_H_
+
+/* The 64 defined bytes plus \0 */
+#define FASTBOOT_RESPONSE_LEN	(64 + 1)
+
+/* What the transport has to do once the response has been sent */
+enum fb_action {
+	FB_ACTION_NONE,
+	FB_ACTION_DOWNLOAD,		/* receive fb_download_remaining() bytes */
+	FB_ACTION_BOOT,
+	FB_ACTION_CONTINUE,		/* leave fastboot */
+	FB_ACTION_REBOOT,
+	FB_ACTION_REBOOT_BOOTLOADER,
+};
+
+/**
+ * fb_handle_command() - run a fastboot command
+ *
+ * @param cmd - the command as received, '\0' terminated
+ * @param response - filled with the response, FASTBOOT_RESPONSE_LEN bytes
+ * @return the action for the transport, enum fb_action
+ */
+int fb_handle_command(char *cmd, char *response);
+
+/* Bytes still to come in the running download */
+unsigned int fb_download_remaining(void);
+
+/**
+ * fb_download_data() - store data of the running download
+ *
+ * @param data - received data
+ * @param len - its length, at most fb_download_remaining()
+ */
+void fb_download_data(const void *data, unsigned int len);
+
+/* Called once all data arrived, fills the response to the download */
+void fb_download_complete(char *response);
+
+/* Carry out the boot and reboot actions */
+void fb_do_action(int action);
+
+/**
+ * fb_set_progress() - register a callback for long running commands
+ *
+ * The UDP transport uses it to keep the host waiting while a partition
+ * is written.
+ *
+ * @param cb - called now and then with a short message, NULL to remove
+ */
+void fb_set_progress(void (*cb)(const char *msg));
+
+/* Report progress from a long running command */
+void fb_progress(const char *msg);
+
+#endif /* _FB_COMMAND_H_ */
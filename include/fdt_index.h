@@ -0,0 +1,84 @@
+/*
+ * Device tree lookup index
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __FDT_INDEX_H
+#define __FDT_INDEX_H
+
+/*
+ * libfdt finds a node by walking the tree from the start each time. An
+ * index records, in one pass, each node of a tree by its parent and name,
+ * by phandle and by compatible string. While it is valid,
+ * fdt_subnode_offset(), fdt_path_offset(), fdt_node_offset_by_phandle()
+ * and fdt_node_offset_by_compatible() use it instead.
+ *
+ * One tree is indexed at a time. The index is dropped when libfdt changes
+ * the tree. A tree which is overwritten by other means, e.g. loaded again
+ * at the same address, must be indexed again.
+ */
+
+struct fdt_index;
+
+#if defined(CONFIG_FDT_INDEX) && !defined(USE_HOSTCC)
+/**
+ * fdt_index_build() - Index a device tree, replacing any earlier index
+ *
+ * Before relocation the index must fit in half of the pre-relocation
+ * malloc() space that is left, so that drivers still have room.
+ *
+ * @fdt:	Device tree to index
+ * @return 0 if ok, -ENOSPC if there is not enough memory, -EINVAL if the
+ * tree is not valid
+ */
+int fdt_index_build(const void *fdt);
+
+/* Drop the index if it is for this tree, called when it is changed */
+void fdt_index_invalidate(const void *fdt);
+
+/* Returns the index for a tree, or NULL if it has none */
+const struct fdt_index *fdt_index_get(const void *fdt);
+
+/*
+ * Lookups, as for the libfdt functions of the same names. These return
+ * the same results as walking the tree would, except that they return
+ * -FDT_ERR_BADOFFSET for any starting offset that is not a node.
+ */
+int fdt_index_subnode(const struct fdt_index *idx, int parentoffset,
+		      const char *name, int namelen);
+int fdt_index_phandle(const struct fdt_index *idx, uint32_t phandle);
+int fdt_index_compatible(const struct fdt_index *idx, int startoffset,
+			 const char *compatible);
+#else
+static inline void fdt_index_invalidate(const void *fdt)
+{
+}
+
+static inline const struct fdt_index *fdt_index_get(const void *fdt)
+{
+	return NULL;
+}
+
+/* Never called, since there is no index */
+static inline int fdt_index_subnode(const struct fdt_index *idx,
+				    int parentoffset, const char *name,
+				    int namelen)
+{
+	return -1;
+}
+
+static inline int fdt_index_phandle(const struct fdt_index *idx,
+				    uint32_t phandle)
+{
+	return -1;
+}
+
+static inline int fdt_index_compatible(const struct fdt_index *idx,
+				       int startoffset, const char *compatible)
+{
+	return -1;
+}
+#endif
+
+#endif /* __FDT_INDEX_H */
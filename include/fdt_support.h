@@ -66,6 +66,114 @@ int fdt_pci_dma_ranges(void *blob, int phb_off, struct pci_controller *hose);
 
 int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name);
 
+/*
+ * Each libfdt call that changes the size of a tree moves the rest of it
+ * along, so a series of fixups moves most of the tree many times. A batch
+ * records changes against the unchanged tree and then makes them all at
+ * once, moving each part of the tree at most once.
+ *
+ * Node offsets found before fdt_batch_apply() are not valid afterwards.
+ * Names and values passed to a batch must stay valid, and must not point
+ * into the tree, until the batch is applied.
+ */
+#define FDT_BATCH_MAX		32
+#define FDT_BATCH_BUF_SIZE	256
+
+/**
+ * struct fdt_batch_edit - A change to a range of the tree
+ *
+ * @offset: Offset in the tree of the bytes to replace
+ * @remove: Number of bytes to remove
+ * @len: Number of bytes to insert, including the header for a property
+ * @nameoff: Offset of the name in the strings block, for a property or
+ *	a new name, else -1
+ * @prop: non-zero if this inserts a property
+ * @shift: Change in size of the tree before @offset, set when applied
+ * @data: Bytes to insert, or the value for a property
+ * @data_len: Length of @data
+ */
+struct fdt_batch_edit {
+	int offset;
+	int remove;
+	int len;
+	int nameoff;
+	int prop;
+	int shift;
+	const void *data;
+	int data_len;
+};
+
+/**
+ * struct fdt_batch - Changes to a tree, to be made at once
+ *
+ * @fdt: The tree
+ * @count: Number of changes
+ * @strings_len: Size of the new names to add to the strings block
+ * @buf_used: Bytes used in @buf
+ * @edit: The changes
+ * @buf: Copies of small values
+ */
+struct fdt_batch {
+	void *fdt;
+	int count;
+	int strings_len;
+	int buf_used;
+	struct fdt_batch_edit edit[FDT_BATCH_MAX];
+	char buf[FDT_BATCH_BUF_SIZE];
+};
+
+/**
+ * fdt_batch_init() - Start a batch of changes to a tree
+ *
+ * @batch:	Batch to set up
+ * @fdt:	Tree to change, which needs room for the changes
+ * @return 0 if ok, or -FDT_ERR_... if the tree is not valid
+ */
+int fdt_batch_init(struct fdt_batch *batch, void *fdt);
+
+/**
+ * fdt_batch_setprop() - Set a property as part of a batch
+ *
+ * As with fdt_setprop(), a new property is added first in the node.
+ *
+ * @return 0 if ok, -FDT_ERR_NOSPACE if the batch is full, or other
+ * -FDT_ERR_... if the node is not valid
+ */
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len);
+
+/**
+ * fdt_batch_subnode() - Find a subnode, adding it if needed
+ *
+ * Adding a node cannot be batched, so the changes so far are applied
+ * first. Use this only with a parent whose offset they cannot change, such
+ * as the root node.
+ *
+ * @return offset of the subnode, or -FDT_ERR_... on error
+ */
+int fdt_batch_subnode(struct fdt_batch *batch, int parentoffset,
+		      const char *name);
+
+/* Add or delete a memory reservation, as with fdt_add/del_mem_rsv() */
+int fdt_batch_add_mem_rsv(struct fdt_batch *batch, uint64_t address,
+			  uint64_t size);
+int fdt_batch_del_mem_rsv(struct fdt_batch *batch, int n);
+
+/**
+ * fdt_batch_apply() - Make the changes in a batch
+ *
+ * The batch is then empty, and can be used for more changes.
+ *
+ * @return 0 if ok, or -FDT_ERR_NOSPACE if the tree is too small, in which
+ * case it is left unchanged
+ */
+int fdt_batch_apply(struct fdt_batch *batch);
+
+/* Batched versions of fdt_initrd() and fdt_fixup_ethernet() */
+int fdt_batch_initrd(struct fdt_batch *batch, ulong initrd_start,
+		     ulong initrd_end);
+void fdt_batch_fixup_ethernet(struct fdt_batch *batch);
+
 /**
  * Add board-specific data to the FDT before booting the OS.
  *
@@ -4,6 +4,73 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
+#ifndef __INITCALL_H
+#define __INITCALL_H
+
 typedef int (*init_fnc_t)(void);
 
 int initcall_run_list(const init_fnc_t init_sequence[]);
+
+/**
+ * struct initcall_async - Init work that completes in the background
+ *
+ * Much of the time spent bringing up a device is waiting on the hardware.
+ * An async job kicks the hardware off and then only checks on it, which
+ * initcall_run_list() does between initcalls, so the other initcalls run
+ * in the meantime. Everything runs cooperatively on the boot CPU.
+ *
+ * Whatever needs a job to be done calls initcall_async_wait() first. All
+ * jobs are done once init_sequence_r is over.
+ *
+ * @name:	Name of the job, used by others to depend on it
+ * @deps:	NULL-terminated names of the jobs that must be done before this
+ *		one starts, or NULL for none
+ * @start:	Start the work, returns 0 if ok, -ve on error
+ * @poll:	Check on the work without waiting for it, returns -EBUSY while
+ *		it is still going, 0 when done, other -ve on error
+ */
+struct initcall_async {
+	const char *name;
+	const char *const *deps;
+	int (*start)(void);
+	int (*poll)(void);
+
+	/* private: */
+	struct initcall_async *next;
+	ulong start_us;
+	ulong span_start;
+	int ret;
+};
+
+#ifdef CONFIG_INITCALL_ASYNC
+/**
+ * initcall_async_start() - Start a job, once the jobs it depends on are done
+ *
+ * @job:	Job to start, which must stay around until it is done
+ * @return 0 if ok, -ve if it could not be started
+ */
+int initcall_async_start(struct initcall_async *job);
+
+/* Give all running jobs a chance to make progress */
+void initcall_async_poll(void);
+
+/**
+ * initcall_async_wait() - Wait for a job to be done
+ *
+ * @name:	Name of the job
+ * @return 0 if it completed ok (or was never started), -ve error otherwise
+ */
+int initcall_async_wait(const char *name);
+
+/* Wait for all jobs to be done, always returns 0 so it can be an initcall */
+int initcall_async_wait_all(void);
+#else
+static inline void initcall_async_poll(void) {}
+
+static inline int initcall_async_wait(const char *name)
+{
+	return 0;
+}
+#endif
+
+#endif /* __INITCALL_H */
@@ -227,6 +227,7 @@ struct vlan_ethernet_hdr {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -276,6 +277,36 @@ struct ip_udp_hdr {
 #define IP_UDP_HDR_SIZE		(sizeof(struct ip_udp_hdr))
 #define UDP_HDR_SIZE		(IP_UDP_HDR_SIZE - IP_HDR_SIZE)
 
+/*
+ *	Internet Protocol (IP) + TCP header (without options).
+ *	The 32 bit fields are not naturally aligned in a received
+ *	packet, use get/put_unaligned_be32() on them.
+ */
+struct ip_tcp_hdr {
+	uchar		ip_hl_v;	/* header length and version	*/
+	uchar		ip_tos;		/* type of service		*/
+	ushort		ip_len;		/* total length			*/
+	ushort		ip_id;		/* identification		*/
+	ushort		ip_off;		/* fragment offset field	*/
+	uchar		ip_ttl;		/* time to live			*/
+	uchar		ip_p;		/* protocol			*/
+	ushort		ip_sum;		/* checksum			*/
+	IPaddr_t	ip_src;		/* Source IP address		*/
+	IPaddr_t	ip_dst;		/* Destination IP address	*/
+	ushort		tcp_src;	/* TCP source port		*/
+	ushort		tcp_dst;	/* TCP destination port		*/
+	uchar		tcp_seq[4];	/* Sequence number		*/
+	uchar		tcp_ack[4];	/* Acknowledgement number	*/
+	uchar		tcp_hlen;	/* Header length (words) << 4	*/
+	uchar		tcp_flags;	/* Control bits			*/
+	ushort		tcp_win;	/* Receive window		*/
+	ushort		tcp_xsum;	/* Checksum			*/
+	ushort		tcp_urg;	/* Urgent pointer		*/
+};
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -366,6 +397,11 @@ struct icmp_hdr {
 #define PKTSIZE_ALIGN		1536
 /*#define PKTSIZE		608*/
 
+/* Largest UDP payload put together from IP fragments */
+#if defined(CONFIG_IP_DEFRAG) && !defined(CONFIG_NET_MAXDEFRAG)
+#define CONFIG_NET_MAXDEFRAG	16384
+#endif
+
 /*
  * Maximum receive ring size; that is, the number of packets
  * we can buffer before overflow happens. Basically, this just
@@ -420,7 +456,7 @@ extern int		NetRestartWrap;		/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL
+	TFTPSRV, TFTPPUT, LINKLOCAL, WGET, FASTBOOT
 };
 
 /* from net/net.c */
@@ -485,6 +521,8 @@ extern void net_set_udp_header(uchar *pkt, IPaddr_t dest, int dport,
 /* Checksum */
 extern int	NetCksumOk(uchar *, int);	/* Return true if cksum OK */
 extern uint	NetCksum(uchar *, int);		/* Calculate the checksum */
+/* Checksum over the pseudo header and len bytes of UDP/TCP */
+extern uint	net_cksum_pseudo(struct ip_hdr *ip, int proto, unsigned len);
 
 /* Callbacks */
 extern rxhand_f *net_get_udp_handler(void);	/* Get UDP RX packet handler */
@@ -528,9 +566,29 @@ static inline void NetSendPacket(uchar *pkt, int len)
 extern int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit "NetTxPacket" with its IP packet already built, performing
+ * ARP request if needed (ether will be populated)
+ *
+ * @param ether Destination MAC address, or NetEtherNullAddr
+ * @param dest IP address to send the packet to
+ * @param len Length of the packet including all headers
+ */
+extern int net_send_ip_packet(uchar *ether, IPaddr_t dest, int len);
+
 /* Processes a received packet */
 extern void NetReceive(uchar *, int);
 
+/* Checksums found good by the MAC, passed to net_receive_csum() */
+#define NET_RX_CSUM_IP	0x01		/* IPv4 header */
+#define NET_RX_CSUM_L4	0x02		/* UDP or TCP, with pseudo header */
+
+/* The NET_RX_CSUM_* flags of the packet being processed */
+extern int net_rx_csum;
+
+/* Processes a received packet whose checksums the MAC checked */
+extern void net_receive_csum(uchar *inpkt, int len, int csum);
+
 #ifdef CONFIG_NETCONSOLE
 void NcStart(void);
 int nc_input_packet(uchar *pkt, IPaddr_t src_ip, unsigned dest_port,
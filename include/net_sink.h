@@ -0,0 +1,99 @@
+/*
+ * Stream network downloads straight into storage
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __NET_SINK_H__
+#define __NET_SINK_H__
+
+#include <part.h>
+
+/*
+ * A sink is armed by the 'netsink' command and used by the next TFTP or
+ * NFS download instead of load_addr. Data arrives in order; it is gathered
+ * into CONFIG_NET_SINK_CHUNK_SIZE chunks which are written out while the
+ * next packets are on their way.
+ */
+
+/**
+ * net_sink_arm_blk() - write the next download to a block device
+ *
+ * @param dev_desc - block device descriptor
+ * @param info - partition to write to (start 0 and size lba for the whole
+ *		 device)
+ * @param sparse - non-zero if the download is an Android sparse image
+ * @return 0 on success, -1 on error
+ */
+int net_sink_arm_blk(block_dev_desc_t *dev_desc, disk_partition_t *info,
+		     int sparse);
+
+/**
+ * net_sink_arm_store() - write the next download to a store partition
+ *
+ * @param part - partition name as known to store_write_ops()
+ * @param sparse - non-zero if the download is an Android sparse image
+ * @return 0 on success, -1 on error
+ */
+int net_sink_arm_store(const char *part, int sparse);
+
+/**
+ * net_sink_arm_ubi() - write the next download to a UBI volume
+ *
+ * The volume is updated in a single UBI update, so its final size has to
+ * be known up front.
+ *
+ * @param volume - volume name on the current UBI device
+ * @param size - size of the download in bytes
+ * @return 0 on success, -1 on error
+ */
+int net_sink_arm_ubi(const char *volume, ulong size);
+
+/* Forget about an armed sink */
+void net_sink_disarm(void);
+
+/* Print the armed sink, if any */
+void net_sink_print(void);
+
+/* Called by the protocols when a download (re)starts */
+void net_sink_start(void);
+
+/* Return non-zero if the running download goes to a sink */
+int net_sink_active(void);
+
+/**
+ * net_sink_store() - hand received data to the sink
+ *
+ * @param offset - offset of the data in the downloaded file
+ * @param src - data
+ * @param len - length of the data
+ * @return 0 on success, -1 on error
+ */
+int net_sink_store(ulong offset, const uchar *src, ulong len);
+
+/**
+ * net_sink_sync() - write out complete chunks
+ *
+ * Meant to be called right after the protocol asked for more data, so
+ * the write overlaps with the next packets coming in.
+ *
+ * @return 0 on success, -1 on error
+ */
+int net_sink_sync(void);
+
+/**
+ * net_sink_finish() - write out what is left at the end of the download
+ *
+ * @return 0 on success, -1 on error
+ */
+int net_sink_finish(void);
+
+/**
+ * net_sink_end() - tear down the sink after the network loop
+ *
+ * @return non-zero if the download went to a sink, so there is nothing
+ *	   in memory at load_addr
+ */
+int net_sink_end(void);
+
+#endif /* __NET_SINK_H__ */
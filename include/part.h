@@ -205,6 +205,16 @@ int get_partition_info_efi_by_name(block_dev_desc_t *dev_desc,
 void print_part_efi (block_dev_desc_t *dev_desc);
 int   test_part_efi (block_dev_desc_t *dev_desc);
 
+/**
+ * part_efi_invalidate_cache() - Drop the cached GPT of a device
+ *
+ * Must be called whenever the GPT on the device may have changed or the
+ * device itself was switched (rescan, hardware partition switch, ...).
+ *
+ * @param dev_desc - block device descriptor, NULL to drop all devices
+ */
+void part_efi_invalidate_cache(block_dev_desc_t *dev_desc);
+
 /**
  * write_gpt_table() - Write the GUID Partition Table to disk
  *
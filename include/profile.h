@@ -0,0 +1,94 @@
+/*
+ * Sampling profiler
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+/*
+ * A periodic timer interrupt records where the CPU is: the PC and, if
+ * the code keeps frame pointers, the return addresses of its callers.
+ * Unlike CONFIG_TRACE nothing is instrumented, so the code runs at full
+ * speed between samples.
+ *
+ * Addresses are kept as offsets from CONFIG_SYS_TEXT_BASE, the same as
+ * the function trace, so that a dump can be decoded with proftool. Each
+ * sample in the buffer is a 32-bit frame count followed by that many
+ * offsets, innermost first.
+ */
+
+#ifndef CONFIG_SAMPLE_PROFILE_HZ
+#define CONFIG_SAMPLE_PROFILE_HZ	1000
+#endif
+
+#ifndef CONFIG_SAMPLE_PROFILE_BUF_SIZE
+#define CONFIG_SAMPLE_PROFILE_BUF_SIZE	0x40000
+#endif
+
+/* Most frames recorded for one sample */
+#define PROFILE_MAX_DEPTH	32
+
+#ifdef CONFIG_SAMPLE_PROFILE
+
+/**
+ * profile_start() - Start taking samples
+ *
+ * Any samples from an earlier run are discarded.
+ *
+ * @hz:		Samples per second
+ * @depth:	Frames to record per sample, 1 for just the PC
+ * @return 0 if ok, -ve on error
+ */
+int profile_start(unsigned int hz, unsigned int depth);
+
+/* Stop taking samples, keeping those recorded so far */
+void profile_stop(void);
+
+/**
+ * profile_sample() - Record one sample, called from the timer interrupt
+ *
+ * @pc:		PC the interrupt was taken at
+ * @fp:		Frame pointer at that point
+ * @sp:		Stack pointer at that point
+ */
+void profile_sample(ulong pc, ulong fp, ulong sp);
+
+/* Print the number of samples taken and lost */
+void profile_print_stats(void);
+
+/*
+ * Print the samples as folded stacks, one "outer;...;inner count" line
+ * per distinct stack, which flame graph tools take as input
+ */
+void profile_report(void);
+
+/**
+ * profile_dump() - Write the samples to a buffer in proftool format
+ *
+ * @buff:	Buffer to write to
+ * @buff_size:	Size of buffer
+ * @needed:	Returns the number of bytes needed for all the samples
+ * @return 0 if ok, -ENOSPC if the buffer is too small
+ */
+int profile_dump(void *buff, size_t buff_size, size_t *needed);
+
+/*
+ * The timer used for sampling. Each call to profile_timer_start() must
+ * be balanced by profile_timer_stop(). The timer interrupt handler calls
+ * profile_sample().
+ */
+int profile_timer_start(unsigned int hz);
+void profile_timer_stop(void);
+
+struct pt_regs;
+
+/* Handle an interrupt, returns 0 if it was the profiling timer's */
+int profile_timer_irq(struct pt_regs *regs);
+
+#else
+static inline void profile_stop(void) {}
+#endif
+
+#endif /* __PROFILE_H */
@@ -14,6 +14,8 @@ struct serial_device {
 	int	(*tstc)(void);
 	void	(*putc)(const char c);
 	void	(*puts)(const char *s);
+	int	(*tx_space)(void);	/* optional, see serial_tx_space() */
+	void	(*flush)(void);		/* optional, see serial_flush() */
 #if CONFIG_POST & CONFIG_SYS_POST_UART
 	void	(*loop)(int);
 #endif
@@ -0,0 +1,369 @@
+/*
+ * Device tree lookup index, see include/fdt_index.h
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fdt_index.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Deepest node that can be indexed, the root being at depth 1 */
+#define FDT_INDEX_MAX_DEPTH	32
+
+/**
+ * struct fdt_index_node - A node in the tree
+ *
+ * @offset: Offset of the node
+ * @parent: Offset of its parent, -1 for the root node
+ * @phandle: Its phandle, 0 if none
+ * @next_name: Next node in the same name hash chain, or -1
+ * @next_phandle: Next node in the same phandle hash chain, or -1
+ */
+struct fdt_index_node {
+	int offset;
+	int parent;
+	uint32_t phandle;
+	int next_name;
+	int next_phandle;
+};
+
+/**
+ * struct fdt_index_compat - A compatible string of a node
+ *
+ * @str: The string, in the tree
+ * @node: Index of the node in struct fdt_index
+ * @next: Next string in the same hash chain, or -1
+ */
+struct fdt_index_compat {
+	const char *str;
+	int node;
+	int next;
+};
+
+/**
+ * struct fdt_index - Index of a tree
+ *
+ * Nodes are in the order they appear in the tree, which is order of
+ * offset, and so are the hash chains. So the first match in a chain is the
+ * one that a walk of the tree would find.
+ *
+ * @fdt: The tree, NULL once it has changed
+ * @totalsize: Size of the tree when indexed, to spot some changes
+ * @size_dt_struct: Size of its structure block when indexed
+ * @early: true if allocated before relocation
+ * @node_count: Number of nodes
+ * @node_mask: Number of name and phandle hash chains - 1
+ * @compat_mask: Number of compatible hash chains - 1
+ * @name_head: First node of each chain by parent and name (without unit
+ * address)
+ * @phandle_head: First node of each chain by phandle
+ * @compat_head: First string of each chain by compatible string
+ * @node: The nodes
+ * @compat: The compatible strings
+ */
+struct fdt_index {
+	const void *fdt;
+	uint32_t totalsize;
+	uint32_t size_dt_struct;
+	bool early;
+	int node_count;
+	uint node_mask;
+	uint compat_mask;
+	int *name_head;
+	int *phandle_head;
+	int *compat_head;
+	struct fdt_index_node *node;
+	struct fdt_index_compat *compat;
+};
+
+static uint fdt_index_hash(uint hash, const char *str, int len)
+{
+	while (len-- > 0 && *str)
+		hash = hash * 33 + (unsigned char)*str++;
+
+	return hash;
+}
+
+/* Hash a node name or the name part of a path, leaving out the address */
+static uint fdt_index_name_hash(int parent, const char *name, int len)
+{
+	const char *at = memchr(name, '@', len);
+
+	if (at)
+		len = at - name;
+
+	return fdt_index_hash(5381 + parent, name, len);
+}
+
+static uint fdt_index_phandle_hash(uint32_t phandle)
+{
+	return phandle * 0x9e3779b1;
+}
+
+/* Returns the number of chains to use for a number of entries */
+static uint fdt_index_chains(int count)
+{
+	uint size;
+
+	for (size = 1; size < count; size <<= 1)
+		;
+
+	return size;
+}
+
+/*
+ * Walk the tree, counting its nodes and compatible strings, and if "idx"
+ * is not NULL also record them
+ */
+static int fdt_index_scan(const void *fdt, struct fdt_index *idx,
+			  int *node_countp, int *compat_countp)
+{
+	int parents[FDT_INDEX_MAX_DEPTH + 1];
+	struct fdt_index_node *node;
+	struct fdt_index_compat *compat;
+	int node_count = 0, compat_count = 0;
+	const char *str, *end;
+	int offset, depth = 0;
+	int len;
+
+	for (offset = fdt_next_node(fdt, -1, &depth);
+	     offset >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		if (depth < 1 || depth > FDT_INDEX_MAX_DEPTH)
+			return -EINVAL;
+		parents[depth] = offset;
+		if (idx) {
+			node = &idx->node[node_count];
+			node->offset = offset;
+			node->parent = depth > 1 ? parents[depth - 1] : -1;
+			node->phandle = fdt_get_phandle(fdt, offset);
+		}
+
+		str = fdt_getprop(fdt, offset, "compatible", &len);
+		for (end = str + (str ? len : 0); str < end; str += len + 1) {
+			len = strnlen(str, end - str);
+			if (str + len == end)
+				break;
+			if (idx) {
+				compat = &idx->compat[compat_count];
+				compat->str = str;
+				compat->node = node_count;
+			}
+			compat_count++;
+		}
+		node_count++;
+	}
+	if (offset != -FDT_ERR_NOTFOUND)
+		return -EINVAL;
+
+	*node_countp = node_count;
+	*compat_countp = compat_count;
+
+	return 0;
+}
+
+int fdt_index_build(const void *fdt)
+{
+	struct fdt_index *idx = gd->fdt_index;
+	struct fdt_index_node *node;
+	struct fdt_index_compat *compat;
+	int node_count, compat_count;
+	uint node_chains, compat_chains, hash;
+	bool early;
+	size_t size;
+	int *head;
+	int i;
+
+	/* Memory allocated before relocation cannot be freed */
+	gd->fdt_index = NULL;
+	if (idx && !idx->early)
+		free(idx);
+
+	if (fdt_check_header(fdt) ||
+	    fdt_index_scan(fdt, NULL, &node_count, &compat_count))
+		return -EINVAL;
+	node_chains = fdt_index_chains(node_count);
+	compat_chains = fdt_index_chains(compat_count);
+	size = sizeof(*idx) + node_count * sizeof(*node) +
+		compat_count * sizeof(*compat) +
+		(2 * node_chains + compat_chains) * sizeof(int);
+
+	early = !(gd->flags & GD_FLG_FULL_MALLOC_INIT);
+	if (early) {
+#ifdef CONFIG_SYS_MALLOC_F_LEN
+		if (size > (gd->malloc_limit - gd->malloc_base -
+			    gd->malloc_ptr) / 2)
+			return -ENOSPC;
+#else
+		return -ENOSPC;
+#endif
+	}
+	idx = malloc(size);
+	if (!idx)
+		return -ENOSPC;
+
+	idx->fdt = fdt;
+	idx->totalsize = fdt_totalsize(fdt);
+	idx->size_dt_struct = fdt_size_dt_struct(fdt);
+	idx->early = early;
+	idx->node_count = node_count;
+	idx->node_mask = node_chains - 1;
+	idx->compat_mask = compat_chains - 1;
+	/* The compatible strings hold pointers, so they go first */
+	idx->compat = (struct fdt_index_compat *)(idx + 1);
+	idx->node = (struct fdt_index_node *)(idx->compat + compat_count);
+	head = (int *)(idx->node + node_count);
+	idx->name_head = head;
+	idx->phandle_head = head + node_chains;
+	idx->compat_head = head + 2 * node_chains;
+	memset(head, 0xff, (2 * node_chains + compat_chains) * sizeof(int));
+	fdt_index_scan(fdt, idx, &node_count, &compat_count);
+
+	/* Add last to first, so that each chain is in tree order */
+	for (i = node_count - 1; i >= 0; i--) {
+		const char *name;
+		int len;
+
+		node = &idx->node[i];
+		name = fdt_get_name(fdt, node->offset, &len);
+		hash = fdt_index_name_hash(node->parent, name, len);
+		node->next_name = idx->name_head[hash & idx->node_mask];
+		idx->name_head[hash & idx->node_mask] = i;
+
+		node->next_phandle = -1;
+		if (node->phandle && node->phandle != -1) {
+			hash = fdt_index_phandle_hash(node->phandle);
+			node->next_phandle =
+				idx->phandle_head[hash & idx->node_mask];
+			idx->phandle_head[hash & idx->node_mask] = i;
+		}
+	}
+	for (i = compat_count - 1; i >= 0; i--) {
+		compat = &idx->compat[i];
+		hash = fdt_index_hash(5381, compat->str, INT_MAX);
+		compat->next = idx->compat_head[hash & idx->compat_mask];
+		idx->compat_head[hash & idx->compat_mask] = i;
+	}
+	gd->fdt_index = idx;
+
+	return 0;
+}
+
+void fdt_index_invalidate(const void *fdt)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	if (idx && idx->fdt == fdt)
+		idx->fdt = NULL;
+}
+
+const struct fdt_index *fdt_index_get(const void *fdt)
+{
+	const struct fdt_index *idx = gd->fdt_index;
+
+	if (!idx || !fdt || idx->fdt != fdt)
+		return NULL;
+
+	/* The pre-relocation malloc() area may be reused after relocation */
+	if (idx->early && (gd->flags & GD_FLG_RELOC))
+		return NULL;
+	if (fdt_totalsize(fdt) != idx->totalsize ||
+	    fdt_size_dt_struct(fdt) != idx->size_dt_struct)
+		return NULL;
+
+	return idx;
+}
+
+/* Returns true if there is a node at this offset */
+static bool fdt_index_is_node(const struct fdt_index *idx, int offset)
+{
+	int low = 0, high = idx->node_count;
+	int mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (idx->node[mid].offset == offset)
+			return true;
+		if (idx->node[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return false;
+}
+
+int fdt_index_subnode(const struct fdt_index *idx, int parentoffset,
+		      const char *name, int namelen)
+{
+	const struct fdt_index_node *node;
+	const char *node_name;
+	uint hash;
+	int i;
+
+	if (!fdt_index_is_node(idx, parentoffset))
+		return -FDT_ERR_BADOFFSET;
+
+	hash = fdt_index_name_hash(parentoffset, name, namelen);
+	for (i = idx->name_head[hash & idx->node_mask]; i != -1;
+	     i = node->next_name) {
+		node = &idx->node[i];
+		if (node->parent != parentoffset)
+			continue;
+		node_name = fdt_get_name(idx->fdt, node->offset, NULL);
+		if (strncmp(node_name, name, namelen))
+			continue;
+
+		/* "name" without an address matches any address */
+		if (!node_name[namelen] ||
+		    (node_name[namelen] == '@' && !memchr(name, '@', namelen)))
+			return node->offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_index_phandle(const struct fdt_index *idx, uint32_t phandle)
+{
+	const struct fdt_index_node *node;
+	uint hash;
+	int i;
+
+	hash = fdt_index_phandle_hash(phandle);
+	for (i = idx->phandle_head[hash & idx->node_mask]; i != -1;
+	     i = node->next_phandle) {
+		node = &idx->node[i];
+		if (node->phandle == phandle)
+			return node->offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_index_compatible(const struct fdt_index *idx, int startoffset,
+			 const char *compatible)
+{
+	const struct fdt_index_compat *compat;
+	int offset;
+	uint hash;
+	int i;
+
+	if (startoffset >= 0 && !fdt_index_is_node(idx, startoffset))
+		return -FDT_ERR_BADOFFSET;
+
+	hash = fdt_index_hash(5381, compatible, INT_MAX);
+	for (i = idx->compat_head[hash & idx->compat_mask]; i != -1;
+	     i = compat->next) {
+		compat = &idx->compat[i];
+		offset = idx->node[compat->node].offset;
+		if (offset > startoffset && !strcmp(compat->str, compatible))
+			return offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
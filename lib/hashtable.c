@@ -58,10 +58,14 @@
  */
 
 typedef struct _ENTRY {
-	int used;
+	int used;	/* hash of the key, 0 if free, -1 if deleted */
+	int heap;	/* HEAP_KEY, HEAP_DATA: malloc()ed, else in an arena */
 	ENTRY entry;
 } _ENTRY;
 
+#define HEAP_KEY	(1 << 0)
+#define HEAP_DATA	(1 << 1)
+
 
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx);
@@ -70,29 +74,13 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
  * hcreate()
  */
 
-/*
- * For the used double hash method the table size has to be a prime. To
- * correct the user given table size we need a prime test.  This trivial
- * algorithm is adequate because
- * a)  the code is (most probably) called a few times per program run and
- * b)  the number is small because the table must fit in the core
- * */
-static int isprime(unsigned int number)
-{
-	/* no even number will be passed */
-	unsigned int div = 3;
-
-	while (div * div < number && number % div != 0)
-		div += 2;
-
-	return number % div != 0;
-}
-
 /*
  * Before using the hash table we must allocate memory for it.
- * Test for an existing table are done. We allocate one element
- * more as the found prime number says. This is done for more effective
- * indexing as explained in the comment for the hsearch function.
+ * Test for an existing table are done. The table is searched with
+ * linear probing, so neighbouring slots share cache lines, and its size
+ * is a power of two with some slack above the requested number of
+ * elements, so probe sequences stay short when it fills up. We allocate
+ * one element more, index 0 is never used (see hsearch_r()).
  * The contents of the table is zeroed, especially the field used
  * becomes zero.
  */
@@ -109,12 +97,9 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	if (htab->table != NULL)
 		return 0;
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
-
-	htab->size = nel;
+	htab->size = 2;
+	while (htab->size < nel + nel / 2)
+		htab->size <<= 1;
 	htab->filled = 0;
 
 	/* allocate memory and zero out */
@@ -151,12 +136,22 @@ void hdestroy_r(struct hsearch_data *htab)
 		if (htab->table[i].used > 0) {
 			ENTRY *ep = &htab->table[i].entry;
 
-			free((void *)ep->key);
-			free(ep->data);
+			if (htab->table[i].heap & HEAP_KEY)
+				free((void *)ep->key);
+			if (htab->table[i].heap & HEAP_DATA)
+				free(ep->data);
 		}
 	}
 	free(htab->table);
 
+	/* and the imported data the remaining entries pointed into */
+	while (htab->arena) {
+		void *next = *(void **)htab->arena;
+
+		free(htab->arena);
+		htab->arena = next;
+	}
+
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
 }
@@ -166,11 +161,11 @@ void hdestroy_r(struct hsearch_data *htab)
  */
 
 /*
- * This is the search function. It uses double hashing with open addressing.
+ * This is the search function. It uses linear probing with open addressing.
  * The argument item.key has to be a pointer to an zero terminated, most
  * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
+ * strings is simple but fast (djb2), and every character of the key
+ * contributes to it.
  *
  * We use an trick to speed up the lookup. The table is created by hcreate
  * with one more element available. This enables us to use the index zero
@@ -188,7 +183,9 @@ void hdestroy_r(struct hsearch_data *htab)
  *   works with NUL terminated strings only.
  * - Instead of storing just pointers to the original objects, we
  *   create local copies so the caller does not need to care about the
- *   data any more.
+ *   data any more. Entries created by himport_r() point into a copy
+ *   of the imported data instead, which saves an allocation for every
+ *   key and value. A value is overwritten in place if the new one fits.
  * - The standard implementation does not provide a way to update an
  *   existing entry.  This version will create a new entry or update an
  *   existing one when both "action == ENTER" and "item.data != NULL".
@@ -204,7 +201,7 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	unsigned int idx;
 	size_t key_len = strlen(match);
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
+	for (idx = last_idx + 1; idx <= htab->size; ++idx) {
 		if (htab->table[idx].used <= 0)
 			continue;
 		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
@@ -218,13 +215,47 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	return 0;
 }
 
+/*
+ * Store a new value for an entry: in place if it is not longer than the
+ * current one, else in a malloc()ed copy. With copy == 0 the value is
+ * kept where it is, in an arena.
+ */
+static int _hset_data(struct hsearch_data *htab, unsigned int idx,
+	char *data, int copy)
+{
+	_ENTRY *e = &htab->table[idx];
+	size_t len;
+
+	if (copy) {
+		len = strlen(data);
+		if (e->entry.data && len <= strlen(e->entry.data)) {
+			/* the new value may be part of the old one */
+			memmove(e->entry.data, data, len + 1);
+			return 0;
+		}
+
+		data = strdup(data);
+		if (data == NULL)
+			return -1;
+	}
+
+	if (e->heap & HEAP_DATA)
+		free(e->entry.data);
+	e->entry.data = data;
+	if (copy)
+		e->heap |= HEAP_DATA;
+	else
+		e->heap &= ~HEAP_DATA;
+	return 0;
+}
+
 /*
  * Compare an existing entry with the desired key, and overwrite if the action
  * is ENTER.  This is simply a helper function for hsearch_r().
  */
 static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	ENTRY **retval, struct hsearch_data *htab, int flag,
-	unsigned int hval, unsigned int idx)
+	unsigned int hval, unsigned int idx, int copy)
 {
 	if (htab->table[idx].used == hval
 	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
@@ -252,9 +283,7 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 				return 0;
 			}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
+			if (_hset_data(htab, idx, item.data, copy)) {
 				__set_errno(ENOMEM);
 				*retval = NULL;
 				return 0;
@@ -268,81 +297,51 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	return -1;
 }
 
-int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
-	      struct hsearch_data *htab, int flag)
+static unsigned int hash_key(const char *key)
+{
+	unsigned int hval = 5381;
+
+	while (*key)
+		hval = hval * 33 + (unsigned char)*key++;
+
+	/* 0 and -1 mark free and deleted slots, keep it positive */
+	hval &= 0x7fffffff;
+	return hval ? hval : 1;
+}
+
+static int _hsearch(ENTRY item, ACTION action, ENTRY **retval,
+	struct hsearch_data *htab, int flag, int copy)
 {
 	unsigned int hval;
 	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
+	hval = hash_key(item.key);
 
 	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
+	 * Probe the slots following the one the hash selects, until the
+	 * key or a never used slot shows up. Slots are numbered from 1.
 	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
-
-	/* The first index tried. */
-	idx = hval;
-
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
-
-		if (htab->table[idx].used == -1
-		    && !first_deleted)
-			first_deleted = idx;
-
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
-
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
-
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
-
+	idx = (hval & (htab->size - 1)) + 1;
+	for (count = 0; count < htab->size; ++count) {
+		if (!htab->table[idx].used)
+			break;
+
+		if (htab->table[idx].used == -1) {
+			if (!first_deleted)
+				first_deleted = idx;
+		} else {
 			/* If entry is found use it. */
 			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
+				htab, flag, hval, idx, copy);
 			if (ret != -1)
 				return ret;
 		}
-		while (htab->table[idx].used);
+
+		if (++idx > htab->size)
+			idx = 1;
 	}
 
 	/* An empty bucket has been found. */
@@ -351,7 +350,9 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * If table is full and another entry should be
 		 * entered return with error.
 		 */
-		if (htab->filled == htab->size) {
+		if (first_deleted)
+			idx = first_deleted;
+		if (htab->filled == htab->size || htab->table[idx].used > 0) {
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
@@ -359,20 +360,25 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 
 		/*
 		 * Create new entry;
-		 * create copies of item.key and item.data
+		 * create copies of item.key and item.data, unless they
+		 * are in an arena already
 		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
+		htab->table[idx].entry.key = item.key;
+		htab->table[idx].entry.data = NULL;
+		htab->table[idx].heap = 0;
+		if (copy) {
+			htab->table[idx].entry.key = strdup(item.key);
+			htab->table[idx].heap = HEAP_KEY;
+		}
 		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
+		    _hset_data(htab, idx, item.data, copy)) {
+			if (htab->table[idx].heap & HEAP_KEY)
+				free((void *)htab->table[idx].entry.key);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
+		htab->table[idx].used = hval;
 
 		++htab->filled;
 
@@ -414,6 +420,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	return 0;
 }
 
+int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
+	      struct hsearch_data *htab, int flag)
+{
+	return _hsearch(item, action, retval, htab, flag, 1);
+}
+
 
 /*
  * hdelete()
@@ -430,8 +442,12 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 {
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	if (htab->table[idx].heap & HEAP_KEY)
+		free((void *)ep->key);
+	if (htab->table[idx].heap & HEAP_DATA)
+		free(ep->data);
+	htab->table[idx].heap = 0;
+	ep->data = NULL;
 	ep->callback = NULL;
 	ep->flags = 0;
 	htab->table[idx].used = -1;
@@ -494,8 +510,9 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  * exporting the environment data as text file, including the option
  * for later re-import.
  *
- * The entries in the result list will be sorted by ascending key
- * values.
+ * With H_SORT in flag the entries in the result list will be sorted by
+ * ascending key values, else they come in hash table order, which
+ * saves sorting them where the order doesn't matter.
  *
  * If the separator character is different from NUL, then any
  * separator characters and backslash characters in the values will
@@ -652,7 +669,8 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 #endif
 
 	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
+	if (flag & H_SORT)
+		qsort(list, n, sizeof(ENTRY *), cmpkey);
 
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
@@ -780,6 +798,7 @@ int himport_r(struct hsearch_data *htab,
 {
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	void *arena;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -788,12 +807,17 @@ int himport_r(struct hsearch_data *htab,
 		return 0;
 	}
 
-	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size)) == NULL) {
+	/*
+	 * We allocate new space to make sure we can write to the array.
+	 * It becomes an arena of the table: the names and values are
+	 * parsed in place and the entries point to them there.
+	 */
+	if ((arena = malloc(sizeof(void *) + size)) == NULL) {
 		debug("himport_r: can't malloc %zu bytes\n", size);
 		__set_errno(ENOMEM);
 		return 0;
 	}
+	data = (char *)arena + sizeof(void *);
 	memcpy(data, env, size);
 	dp = data;
 
@@ -836,11 +860,15 @@ int himport_r(struct hsearch_data *htab,
 		debug("Create Hash Table: N=%d\n", nent);
 
 		if (hcreate_r(nent, htab) == 0) {
-			free(data);
+			free(arena);
 			return 0;
 		}
 	}
 
+	/* Lives as long as the table, freed by hdestroy_r() */
+	*(void **)arena = htab->arena;
+	htab->arena = arena;
+
 	if(!size)
 		return 1;		/* everything OK */
 	if(crlf_is_lf) {
@@ -917,7 +945,7 @@ int himport_r(struct hsearch_data *htab,
 		e.key = name;
 		e.data = value;
 
-		hsearch_r(e, ENTER, &rv, htab, flag);
+		_hsearch(e, ENTER, &rv, htab, flag, 0);
 		if (rv == NULL)
 			printf("himport_r: can't insert \"%s=%s\" into hash table\n",
 				name, value);
@@ -927,8 +955,6 @@ int himport_r(struct hsearch_data *htab,
 			rv, name, value);
 	} while ((dp < data + size) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
 
 	/* process variables which were not considered */
 	for (i = 0; i < nvars; i++) {
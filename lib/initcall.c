@@ -5,16 +5,140 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <initcall.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#ifdef CONFIG_INITCALL_ASYNC
+static struct initcall_async *async_list;
+
+/* Time the boot spent running or waiting for jobs, and the jobs took */
+static ulong async_wait_us;
+static ulong async_run_us;
+
+static struct initcall_async *async_find(const char *name)
+{
+	struct initcall_async *job;
+
+	for (job = async_list; job; job = job->next) {
+		if (!strcmp(job->name, name))
+			return job;
+	}
+
+	return NULL;
+}
+
+static void async_done(struct initcall_async *job, int ret)
+{
+	job->ret = ret;
+	async_run_us += timer_get_us() - job->start_us;
+	bootstage_span("async", job->name, 0, job->span_start);
+	if (ret)
+		printf("%s: init failed (err=%d)\n", job->name, ret);
+}
+
+/* Call the job's poll method, returns 0 once it is no longer running */
+static int async_poll_one(struct initcall_async *job)
+{
+	ulong start;
+	int ret;
+
+	if (job->ret != -EBUSY)
+		return 0;
+
+	start = timer_get_us();
+	ret = job->poll();
+	async_wait_us += timer_get_us() - start;
+	if (ret == -EBUSY)
+		return -EBUSY;
+	async_done(job, ret);
+
+	return 0;
+}
+
+int initcall_async_start(struct initcall_async *job)
+{
+	const char *const *dep;
+	ulong start;
+	int ret;
+
+	for (dep = job->deps; dep && *dep; dep++)
+		initcall_async_wait(*dep);
+
+	debug("initcall: async %s\n", job->name);
+	job->start_us = timer_get_us();
+	job->span_start = bootstage_span_start();
+	job->next = async_list;
+	async_list = job;
+
+	start = timer_get_us();
+	ret = job->start();
+	async_wait_us += timer_get_us() - start;
+	if (ret) {
+		async_done(job, ret);
+		return ret;
+	}
+	job->ret = -EBUSY;
+
+	return 0;
+}
+
+void initcall_async_poll(void)
+{
+	struct initcall_async *job;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+
+	for (job = async_list; job; job = job->next)
+		async_poll_one(job);
+}
+
+int initcall_async_wait(const char *name)
+{
+	struct initcall_async *job = async_find(name);
+
+	if (!job)
+		return 0;
+
+	while (async_poll_one(job))
+		;
+
+	return job->ret;
+}
+
+int initcall_async_wait_all(void)
+{
+	struct initcall_async *job;
+	ulong saved = 0;
+
+	for (job = async_list; job; job = job->next)
+		initcall_async_wait(job->name);
+
+	/* The jobs would have taken all their time if run one by one */
+	if (async_run_us > async_wait_us)
+		saved = async_run_us - async_wait_us;
+	debug("initcall: async jobs took %lu us, %lu us saved\n",
+	      async_run_us, saved);
+	bootstage_accum_time(BOOTSTAGE_ID_ACCUM_ASYNC_WAIT, "async_wait",
+			     async_wait_us);
+	bootstage_accum_time(BOOTSTAGE_ID_ACCUM_ASYNC_SAVED, "async_saved",
+			     saved);
+	async_wait_us = 0;
+	async_run_us = 0;
+
+	return 0;
+}
+#endif
+
 int initcall_run_list(const init_fnc_t init_sequence[])
 {
 	const init_fnc_t *init_fnc_ptr;
 
 	for (init_fnc_ptr = init_sequence; *init_fnc_ptr; ++init_fnc_ptr) {
 		unsigned long reloc_ofs = 0;
+		ulong start;
 		int ret;
 
 		if (gd->flags & GD_FLG_RELOC)
@@ -24,13 +148,17 @@ int initcall_run_list(const init_fnc_t init_sequence[])
 			debug(" (relocated to %p)\n", (char *)*init_fnc_ptr);
 		else
 			debug("\n");
+		start = bootstage_span_start();
 		ret = (*init_fnc_ptr)();
+		bootstage_span("initcall", NULL,
+			       (ulong)*init_fnc_ptr - reloc_ofs, start);
 		if (ret) {
 			printf("initcall sequence %p failed at call %p (err=%d)\n",
 			       init_sequence,
 			       (char *)*init_fnc_ptr - reloc_ofs, ret);
 			return -1;
 		}
+		initcall_async_poll();
 	}
 	return 0;
 }
@@ -204,6 +204,7 @@ int fdt_move(const void *fdt, void *buf, int bufsize)
 	if (fdt_totalsize(fdt) > bufsize)
 		return -FDT_ERR_NOSPACE;
 
+	fdt_index_invalidate(buf);
 	memmove(buf, fdt, fdt_totalsize(fdt));
 	return 0;
 }
@@ -91,10 +91,19 @@ static int _nextprop(const void *fdt, int offset)
 int fdt_subnode_offset_namelen(const void *fdt, int offset,
 			       const char *name, int namelen)
 {
-	int depth;
+	const struct fdt_index *idx;
+	int depth, ret;
 
 	FDT_CHECK_HEADER(fdt);
 
+	/* Let the walk below say what is wrong with a bad offset */
+	idx = fdt_index_get(fdt);
+	if (idx) {
+		ret = fdt_index_subnode(idx, offset, name, namelen);
+		if (ret != -FDT_ERR_BADOFFSET)
+			return ret;
+	}
+
 	for (depth = 0;
 	     (offset >= 0) && (depth >= 0);
 	     offset = fdt_next_node(fdt, offset, &depth))
@@ -451,6 +460,7 @@ int fdt_node_offset_by_prop_value(const void *fdt, int startoffset,
 
 int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
 {
+	const struct fdt_index *idx;
 	int offset;
 
 	if ((phandle == 0) || (phandle == -1))
@@ -458,6 +468,10 @@ int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
 
 	FDT_CHECK_HEADER(fdt);
 
+	idx = fdt_index_get(fdt);
+	if (idx)
+		return fdt_index_phandle(idx, phandle);
+
 	/* FIXME: The algorithm here is pretty horrible: we
 	 * potentially scan each property of a node in
 	 * fdt_get_phandle(), then if that didn't find what
@@ -585,10 +599,18 @@ int fdt_node_check_compatible(const void *fdt, int nodeoffset,
 int fdt_node_offset_by_compatible(const void *fdt, int startoffset,
 				  const char *compatible)
 {
+	const struct fdt_index *idx;
 	int offset, err;
 
 	FDT_CHECK_HEADER(fdt);
 
+	idx = fdt_index_get(fdt);
+	if (idx) {
+		offset = fdt_index_compatible(idx, startoffset, compatible);
+		if (offset != -FDT_ERR_BADOFFSET)
+			return offset;
+	}
+
 	/* FIXME: The algorithm here is pretty horrible: we scan each
 	 * property of a node in fdt_node_check_compatible(), then if
 	 * that didn't find what we want, we scan over them again
@@ -37,6 +37,7 @@ static int _fdt_rw_check_header(void *fdt)
 		return -FDT_ERR_BADLAYOUT;
 	if (fdt_version(fdt) > 17)
 		fdt_set_version(fdt, 17);
+	fdt_index_invalidate(fdt);
 
 	return 0;
 }
@@ -382,6 +383,7 @@ int fdt_open_into(const void *fdt, void *buf, int bufsize)
 	char *tmp;
 
 	FDT_CHECK_HEADER(fdt);
+	fdt_index_invalidate(buf);
 
 	mem_rsv_size = (fdt_num_mem_rsv(fdt)+1)
 		* sizeof(struct fdt_reserve_entry);
@@ -6,6 +6,7 @@
  * SPDX-License-Identifier:	GPL-2.0+ BSD-2-Clause
  */
 #include <fdt.h>
+#include <fdt_index.h>
 
 #define FDT_ALIGN(x, a)		(((x) + (a) - 1) & ~((a) - 1))
 #define FDT_TAGALIGN(x)		(FDT_ALIGN((x), FDT_TAGSIZE))
@@ -100,6 +100,7 @@ void udelay(unsigned long usec)
 
 	do {
 		WATCHDOG_RESET();
+		console_poll();
 		kv = usec > CONFIG_WD_PERIOD ? CONFIG_WD_PERIOD : usec;
 		__udelay (kv);
 		usec -= kv;
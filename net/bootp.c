@@ -452,6 +452,12 @@ static int DhcpExtended(u8 *e, int message_type, IPaddr_t ServerID,
 		*e++ = tmp >> 8;
 		*e++ = tmp & 0xff;
 	}
+#if defined(CONFIG_DHCP_RAPID_COMMIT)
+	if (message_type == DHCP_DISCOVER) {
+		*e++ = 80;	/* Rapid Commit (RFC 4039) */
+		*e++ = 0;
+	}
+#endif
 #if defined(CONFIG_BOOTP_SEND_HOSTNAME)
 	hostname = getenv("hostname");
 	if (hostname) {
@@ -643,6 +649,27 @@ static int BootpExtended(u8 *e)
 }
 #endif
 
+/*
+ *	Bootp ID is the lower 4 bytes of our ethernet address
+ *	plus the current time in ms.
+ */
+static uint bootp_new_id(void)
+{
+	uint id;
+
+	id = ((ulong)NetOurEther[2] << 24)
+		| ((ulong)NetOurEther[3] << 16)
+		| ((ulong)NetOurEther[4] << 8)
+		| (ulong)NetOurEther[5];
+	id += get_timer(0);
+
+	id = htonl(id);
+
+	bootp_add_id(id);
+
+	return id;
+}
+
 void BootpReset(void)
 {
 	bootp_num_ids = 0;
@@ -721,20 +748,7 @@ BootpRequest(void)
 	extlen = BootpExtended((u8 *)bp->bp_vend);
 #endif
 
-	/*
-	 *	Bootp ID is the lower 4 bytes of our ethernet address
-	 *	plus the current time in ms.
-	 */
-	BootpID = ((ulong)NetOurEther[2] << 24)
-		| ((ulong)NetOurEther[3] << 16)
-		| ((ulong)NetOurEther[4] << 8)
-		| (ulong)NetOurEther[5];
-	BootpID += get_timer(0);
-
-	BootpID = htonl(BootpID);
-
-	bootp_add_id(BootpID);
-
+	BootpID = bootp_new_id();
 	NetCopyLong(&bp->bp_id, &BootpID);
 
 	/*
@@ -875,13 +889,18 @@ static int DhcpMessageType(unsigned char *popt)
 	return -1;
 }
 
-static void DhcpSendRequestPkt(struct Bootp_t *bp_offer)
+/*
+ * Send a DHCPREQUEST for RequestedIP. It is either the answer to an OFFER
+ * from ServerID, or with no ServerID the INIT-REBOOT request that asks to
+ * keep using an address we had before.
+ */
+static void DhcpSendRequestPkt(uint id, IPaddr_t ServerID,
+			       IPaddr_t RequestedIP)
 {
 	uchar *pkt, *iphdr;
 	struct Bootp_t *bp;
 	int pktlen, iplen, extlen;
 	int eth_hdr_size;
-	IPaddr_t OfferedIP;
 
 	debug("DhcpSendRequestPkt: Sending DHCPREQUEST\n");
 	pkt = NetTxPacket;
@@ -910,20 +929,10 @@ static void DhcpSendRequestPkt(struct Bootp_t *bp_offer)
 
 	memcpy(bp->bp_chaddr, NetOurEther, 6);
 
-	/*
-	 * ID is the id of the OFFER packet
-	 */
+	NetCopyLong(&bp->bp_id, &id);
 
-	NetCopyLong(&bp->bp_id, &bp_offer->bp_id);
-
-	/*
-	 * Copy options from OFFER packet if present
-	 */
-
-	/* Copy offered IP into the parameters request list */
-	NetCopyIP(&OfferedIP, &bp_offer->bp_yiaddr);
 	extlen = DhcpExtended((u8 *)bp->bp_vend, DHCP_REQUEST,
-		NetDHCPServerIP, OfferedIP);
+		ServerID, RequestedIP);
 
 	iplen = BOOTP_HDR_SIZE - OPT_FIELD_SIZE + extlen;
 	pktlen = eth_hdr_size + IP_UDP_HDR_SIZE + iplen;
@@ -936,6 +945,138 @@ static void DhcpSendRequestPkt(struct Bootp_t *bp_offer)
 	NetSendPacket(NetTxPacket, pktlen);
 }
 
+#if defined(CONFIG_DHCP_LEASE_CACHE)
+/*
+ * The last lease, so the next 'dhcp' can ask for the same address right
+ * away (INIT-REBOOT, RFC 2131 section 3.2) instead of going through
+ * DISCOVER/OFFER, which servers often slow down by probing the address
+ * first. The server answers with a NAK if the lease is no good anymore.
+ *
+ * The lease is kept in RAM, in the "dhcplease" environment variable so a
+ * saveenv carries it over a power cycle, and at CONFIG_DHCP_LEASE_ADDR if
+ * the board has memory that survives a warm reset.
+ */
+#define DHCP_LEASE_MAGIC	0x4c454153	/* "LEAS" */
+#define DHCP_REBOOT_TRIES	3
+
+struct dhcp_lease {
+	u32		magic;
+	IPaddr_t	ip;
+	IPaddr_t	server;
+	u32		leasetime;	/* in seconds */
+	u32		crc;
+};
+
+#ifdef CONFIG_DHCP_LEASE_ADDR
+#define lease_cache	(*(struct dhcp_lease *)CONFIG_DHCP_LEASE_ADDR)
+#else
+static struct dhcp_lease lease_cache;
+#endif
+static ulong dhcp_bound_ms;	/* when we got the lease, if in this boot */
+static int dhcp_reboot_tries;
+
+static u32 dhcp_lease_crc(void)
+{
+	return crc32(0, (uchar *)&lease_cache,
+		     offsetof(struct dhcp_lease, crc));
+}
+
+static void dhcp_lease_save(void)
+{
+	char buf[48];
+
+	lease_cache.magic = DHCP_LEASE_MAGIC;
+	lease_cache.ip = NetOurIP;
+	lease_cache.server = NetDHCPServerIP;
+	lease_cache.leasetime = ntohl(dhcp_leasetime);
+	lease_cache.crc = dhcp_lease_crc();
+	dhcp_bound_ms = get_timer(0);
+
+	sprintf(buf, "%pI4 %pI4 %u", &lease_cache.ip, &lease_cache.server,
+		lease_cache.leasetime);
+	setenv("dhcplease", buf);
+}
+
+static void dhcp_lease_forget(void)
+{
+	memset(&lease_cache, 0, sizeof(lease_cache));
+	dhcp_bound_ms = 0;
+	setenv("dhcplease", NULL);
+}
+
+/* Return the address of a lease worth asking for again, or 0 */
+static IPaddr_t dhcp_lease_ip(void)
+{
+	char *s, *p;
+
+	if (lease_cache.magic == DHCP_LEASE_MAGIC &&
+	    lease_cache.crc == dhcp_lease_crc()) {
+		/* Without a bind time from this boot, let the server decide */
+		if (dhcp_bound_ms && lease_cache.leasetime &&
+		    get_timer(dhcp_bound_ms) / 1000 >= lease_cache.leasetime) {
+			dhcp_lease_forget();
+			return 0;
+		}
+		return lease_cache.ip;
+	}
+
+	/* "<address> <server> <lease time>" */
+	s = getenv("dhcplease");
+	if (!s)
+		return 0;
+	lease_cache.ip = string_to_ip(s);
+	p = strchr(s, ' ');
+	lease_cache.server = p ? string_to_ip(p + 1) : 0;
+	p = p ? strchr(p + 1, ' ') : NULL;
+	lease_cache.leasetime = p ? simple_strtoul(p + 1, NULL, 10) : 0;
+	if (!lease_cache.ip)
+		return 0;
+	lease_cache.magic = DHCP_LEASE_MAGIC;
+	lease_cache.crc = dhcp_lease_crc();
+
+	return lease_cache.ip;
+}
+
+static void DhcpSendRebootPkt(void)
+{
+	printf("DHCP INIT-REBOOT for %pI4 (try %d)\n", &lease_cache.ip,
+	       ++dhcp_reboot_tries);
+	dhcp_state = REBOOTING;
+	DhcpSendRequestPkt(bootp_new_id(), 0, lease_cache.ip);
+}
+
+static void DhcpRebootTimeout(void)
+{
+	if (dhcp_reboot_tries >= DHCP_REBOOT_TRIES) {
+		/* No answer, the server may not know us: start over */
+		bootp_timeout = 250;
+		BootpRequest();
+		return;
+	}
+	bootp_timeout *= 2;
+	NetSetTimeout(bootp_timeout, DhcpRebootTimeout);
+	DhcpSendRebootPkt();
+}
+#endif	/* CONFIG_DHCP_LEASE_CACHE */
+
+/* Take the address and parameters from a DHCPACK */
+static void DhcpBound(struct Bootp_t *bp)
+{
+	if (NetReadLong((uint *)&bp->bp_vend[0]) == htonl(BOOTP_VENDOR_MAGIC))
+		DhcpOptionsProcess((u8 *)&bp->bp_vend[4], bp);
+	/* Store net params from reply */
+	BootpCopyNetParams(bp);
+	dhcp_state = BOUND;
+	printf("DHCP client bound to address %pI4 (%lu ms)\n",
+		&NetOurIP, get_timer(bootp_start));
+#if defined(CONFIG_DHCP_LEASE_CACHE)
+	dhcp_lease_save();
+#endif
+	bootstage_mark_name(BOOTSTAGE_ID_BOOTP_STOP, "bootp_stop");
+
+	net_auto_load();
+}
+
 /*
  *	Handle DHCP received packets.
  */
@@ -944,6 +1085,8 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 	    unsigned len)
 {
 	struct Bootp_t *bp = (struct Bootp_t *)pkt;
+	IPaddr_t OfferedIP;
+	uint id;
 
 	debug("DHCPHandler: got packet: (src=%d, dst=%d, len=%d) state: %d\n",
 		src, dest, len, dhcp_state);
@@ -956,6 +1099,22 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		" %d\n", src, dest, len, dhcp_state);
 
 	switch (dhcp_state) {
+#if defined(CONFIG_DHCP_LEASE_CACHE)
+	case REBOOTING:
+		debug("DHCP State: REBOOTING\n");
+
+		switch (DhcpMessageType((u8 *)bp->bp_vend)) {
+		case DHCP_ACK:
+			DhcpBound(bp);
+			break;
+		case DHCP_NAK:
+			puts("DHCP: lease refused\n");
+			dhcp_lease_forget();
+			BootpRequest();
+			break;
+		}
+		break;
+#endif
 	case SELECTING:
 		/*
 		 * Wait an appropriate time for any potential DHCPOFFER packets
@@ -964,6 +1123,13 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		 * is a valid OFFER from a server we want.
 		 */
 		debug("DHCP: state=SELECTING bp_file: \"%s\"\n", bp->bp_file);
+#if defined(CONFIG_DHCP_RAPID_COMMIT)
+		/* An ACK right away means the server took our Rapid Commit */
+		if (DhcpMessageType((u8 *)bp->bp_vend) == DHCP_ACK) {
+			DhcpBound(bp);
+			return;
+		}
+#endif
 #ifdef CONFIG_SYS_BOOTFILE_PREFIX
 		if (strncmp(bp->bp_file,
 			    CONFIG_SYS_BOOTFILE_PREFIX,
@@ -978,7 +1144,9 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				DhcpOptionsProcess((u8 *)&bp->bp_vend[4], bp);
 
 			NetSetTimeout(5000, BootpTimeout);
-			DhcpSendRequestPkt(bp);
+			NetCopyLong(&id, &bp->bp_id);
+			NetCopyIP(&OfferedIP, &bp->bp_yiaddr);
+			DhcpSendRequestPkt(id, NetDHCPServerIP, OfferedIP);
 #ifdef CONFIG_SYS_BOOTFILE_PREFIX
 		}
 #endif	/* CONFIG_SYS_BOOTFILE_PREFIX */
@@ -989,18 +1157,7 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		debug("DHCP State: REQUESTING\n");
 
 		if (DhcpMessageType((u8 *)bp->bp_vend) == DHCP_ACK) {
-			if (NetReadLong((uint *)&bp->bp_vend[0]) ==
-						htonl(BOOTP_VENDOR_MAGIC))
-				DhcpOptionsProcess((u8 *)&bp->bp_vend[4], bp);
-			/* Store net params from reply */
-			BootpCopyNetParams(bp);
-			dhcp_state = BOUND;
-			printf("DHCP client bound to address %pI4 (%lu ms)\n",
-				&NetOurIP, get_timer(bootp_start));
-			bootstage_mark_name(BOOTSTAGE_ID_BOOTP_STOP,
-				"bootp_stop");
-
-			net_auto_load();
+			DhcpBound(bp);
 			return;
 		}
 		break;
@@ -1016,6 +1173,16 @@ DhcpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 
 void DhcpRequest(void)
 {
+#if defined(CONFIG_DHCP_LEASE_CACHE)
+	if (dhcp_lease_ip()) {
+		bootstage_mark_name(BOOTSTAGE_ID_BOOTP_START, "bootp_start");
+		dhcp_reboot_tries = 0;
+		NetSetTimeout(bootp_timeout, DhcpRebootTimeout);
+		net_set_udp_handler(DhcpHandler);
+		DhcpSendRebootPkt();
+		return;
+	}
+#endif
 	BootpRequest();
 }
 #endif	/* CONFIG_CMD_DHCP */
@@ -0,0 +1,243 @@
+/*
+ * Fastboot over UDP
+ *
+ * Every packet from the host starts with a four byte header: packet type,
+ * flags and a 16 bit sequence number. Each one is answered with a packet
+ * carrying the same sequence number, so the host can retransmit lost
+ * packets and we can answer a retransmission with a copy of our reply.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include <fb_command.h>
+#include "fastboot.h"
+
+/* Packet types */
+enum {
+	FB_UDP_ERROR = 0,
+	FB_UDP_QUERY = 1,
+	FB_UDP_INIT = 2,
+	FB_UDP_FASTBOOT = 3,
+};
+
+#define FB_UDP_VERSION		1
+#define FB_UDP_HDR_SIZE		4
+
+/* Longest a command can be */
+#define FB_UDP_CMD_LEN		64
+
+/* How often to tell the host we are still busy with a command */
+#define FB_UDP_INFO_MS		30000
+
+/*
+ * The largest packet we accept, negotiated with the host. With IP
+ * fragment reassembly a single round trip carries several frames worth
+ * of download data, which is what keeps this stop-and-wait protocol fast.
+ */
+#ifdef CONFIG_IP_DEFRAG
+#define FB_UDP_PACKET_SIZE	\
+	min_t(unsigned, CONFIG_NET_MAXDEFRAG - UDP_HDR_SIZE, 0xffff)
+#else
+#define FB_UDP_PACKET_SIZE	(1500 - IP_UDP_HDR_SIZE)
+#endif
+
+static IPaddr_t fb_remote_ip;
+static int fb_remote_port;
+static uchar fb_remote_ether[6];
+
+/* Sequence number of the next packet we expect */
+static ushort fb_seq;
+
+/* Our last reply, sent again when the host retransmits */
+static uchar fb_last[FB_UDP_HDR_SIZE + FASTBOOT_RESPONSE_LEN];
+static unsigned fb_last_len;
+
+/* Command received, run when the host asks for its response */
+static char fb_cmd[FB_UDP_CMD_LEN + 1];
+static int fb_pending;
+static int fb_downloading;
+static ulong fb_info_time;
+
+static void fb_udp_send(int id, ushort seq, const void *data, unsigned len)
+{
+	uchar *pkt = (uchar *)NetTxPacket + NetEthHdrSize() + IP_UDP_HDR_SIZE;
+
+	pkt[0] = id;
+	pkt[1] = 0;
+	pkt[2] = seq >> 8;
+	pkt[3] = seq;
+	memcpy(pkt + FB_UDP_HDR_SIZE, data, len);
+	len += FB_UDP_HDR_SIZE;
+
+	memcpy(fb_last, pkt, len);
+	fb_last_len = len;
+
+	NetSendUDPPacket(fb_remote_ether, fb_remote_ip, fb_remote_port,
+			 FASTBOOT_UDP_PORT, len);
+}
+
+static void fb_udp_resend(void)
+{
+	uchar *pkt = (uchar *)NetTxPacket + NetEthHdrSize() + IP_UDP_HDR_SIZE;
+
+	memcpy(pkt, fb_last, fb_last_len);
+	NetSendUDPPacket(fb_remote_ether, fb_remote_ip, fb_remote_port,
+			 FASTBOOT_UDP_PORT, fb_last_len);
+}
+
+/*
+ * Called by long running commands. The host gives up on a command after
+ * a while, an INFO packet (with the next sequence number) keeps it waiting.
+ */
+static void fb_udp_info(const char *msg)
+{
+	char buf[FASTBOOT_RESPONSE_LEN];
+
+	if (get_timer(fb_info_time) < FB_UDP_INFO_MS)
+		return;
+	fb_info_time = get_timer(0);
+
+	snprintf(buf, sizeof(buf), "INFO%s", msg);
+	fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, buf, strlen(buf));
+}
+
+static void fb_udp_command(void)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+	int action;
+
+	fb_pending = 0;
+	fb_info_time = get_timer(0);
+	action = fb_handle_command(fb_cmd, response);
+
+	/* fb_seq moved on if INFO packets were sent meanwhile */
+	fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, response, strlen(response));
+
+	switch (action) {
+	case FB_ACTION_DOWNLOAD:
+		fb_downloading = 1;
+		break;
+	case FB_ACTION_CONTINUE:
+		net_set_state(NETLOOP_SUCCESS);
+		break;
+	case FB_ACTION_BOOT:
+	case FB_ACTION_REBOOT:
+	case FB_ACTION_REBOOT_BOOTLOADER:
+		/* The response may still be queued, it must go out first */
+		eth_halt();
+		fb_do_action(action);
+		break;
+	}
+}
+
+static void fb_udp_fastboot(uchar *data, unsigned len)
+{
+	char response[FASTBOOT_RESPONSE_LEN];
+
+	if (fb_downloading) {
+		if (len) {
+			/* Let the host send the next packet while we copy */
+			fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, NULL, 0);
+			fb_download_data(data, len);
+		} else if (fb_download_remaining()) {
+			fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, NULL, 0);
+		} else {
+			fb_downloading = 0;
+			fb_download_complete(response);
+			fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, response,
+				    strlen(response));
+		}
+		return;
+	}
+
+	/* The command comes first, then an empty packet for the response */
+	if (fb_pending && !len) {
+		fb_udp_command();
+		return;
+	}
+
+	if (len) {
+		len = min_t(unsigned, len, FB_UDP_CMD_LEN);
+		memcpy(fb_cmd, data, len);
+		fb_cmd[len] = '\0';
+		fb_pending = 1;
+	}
+	fb_udp_send(FB_UDP_FASTBOOT, fb_seq++, NULL, 0);
+}
+
+static void fastboot_handler(uchar *pkt, unsigned dport, IPaddr_t sip,
+			     unsigned sport, unsigned len)
+{
+	static const char unknown[] = "unknown packet type";
+	uchar data[4];
+	ushort seq;
+	int id;
+
+	if (dport != FASTBOOT_UDP_PORT || len < FB_UDP_HDR_SIZE)
+		return;
+
+	if (sip != fb_remote_ip) {
+		fb_remote_ip = sip;
+		memset(fb_remote_ether, 0, 6);
+	}
+	fb_remote_port = sport;
+
+	id = pkt[0];
+	seq = (pkt[2] << 8) | pkt[3];
+	pkt += FB_UDP_HDR_SIZE;
+	len -= FB_UDP_HDR_SIZE;
+
+	switch (id) {
+	case FB_UDP_QUERY:
+		data[0] = fb_seq >> 8;
+		data[1] = fb_seq;
+		fb_udp_send(FB_UDP_QUERY, seq, data, 2);
+		return;
+	case FB_UDP_INIT:
+	case FB_UDP_FASTBOOT:
+		break;
+	default:
+		fb_udp_send(FB_UDP_ERROR, seq, unknown, sizeof(unknown) - 1);
+		return;
+	}
+
+	if (seq == (ushort)(fb_seq - 1)) {
+		fb_udp_resend();
+		return;
+	}
+	if (seq != fb_seq)
+		return;
+
+	if (id == FB_UDP_INIT) {
+		printf("fastboot host %pI4 connected\n", &fb_remote_ip);
+		fb_pending = 0;
+		fb_downloading = 0;
+		data[0] = 0;
+		data[1] = FB_UDP_VERSION;
+		data[2] = FB_UDP_PACKET_SIZE >> 8;
+		data[3] = FB_UDP_PACKET_SIZE & 0xff;
+		fb_udp_send(FB_UDP_INIT, fb_seq++, data, 4);
+		return;
+	}
+
+	fb_udp_fastboot(pkt, len);
+}
+
+void fastboot_start_server(void)
+{
+	printf("Using %s device\n", eth_get_name());
+	printf("Listening for fastboot on %pI4 port %d\n", &NetOurIP,
+	       FASTBOOT_UDP_PORT);
+
+	fb_remote_ip = 0;
+	memset(fb_remote_ether, 0, 6);
+	fb_seq = 0;
+	fb_last_len = 0;
+	fb_pending = 0;
+	fb_downloading = 0;
+
+	fb_set_progress(fb_udp_info);
+	net_set_udp_handler(fastboot_handler);
+}
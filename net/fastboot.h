@@ -0,0 +1,14 @@
+/*
+ * Fastboot over UDP
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __NET_FASTBOOT_H__
+#define __NET_FASTBOOT_H__
+
+#define FASTBOOT_UDP_PORT	5554
+
+extern void fastboot_start_server(void);	/* Wait for a fastboot host */
+
+#endif /* __NET_FASTBOOT_H__ */
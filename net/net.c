@@ -97,6 +97,9 @@
 #if defined(CONFIG_CMD_DNS)
 #include "dns.h"
 #endif
+#if defined(CONFIG_FASTBOOT_UDP)
+#include "fastboot.h"
+#endif
 #include "link_local.h"
 #include "nfs.h"
 #include "ping.h"
@@ -105,6 +108,10 @@
 #include "sntp.h"
 #endif
 #include "tftp.h"
+#if defined(CONFIG_CMD_WGET)
+#include "tcp.h"
+#include "wget.h"
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -149,6 +156,8 @@ IPaddr_t	NetServerIP;
 uchar *NetRxPacket;
 /* Current rx packet length */
 int		NetRxPacketLen;
+/* Checksums of the current rx packet verified by the MAC (NET_RX_CSUM_*) */
+int		net_rx_csum;
 /* IP packet ID */
 unsigned	NetIPID;
 /* Ethernet bcast address */
@@ -439,6 +448,16 @@ restart:
 		case LINKLOCAL:
 			link_local_start();
 			break;
+#endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
+#if defined(CONFIG_FASTBOOT_UDP)
+		case FASTBOOT:
+			fastboot_start_server();
+			break;
 #endif
 		default:
 			break;
@@ -721,6 +740,11 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 	net_set_udp_header(pkt, dest, dport, sport, payload_len);
 	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 
+	return net_send_ip_packet(ether, dest, pkt_hdr_size + payload_len);
+}
+
+int net_send_ip_packet(uchar *ether, IPaddr_t dest, int len)
+{
 	/* if MAC address was not discovered yet, do an ARP request */
 	if (memcmp(ether, NetEtherNullAddr, 6) == 0) {
 		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
@@ -730,7 +754,7 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		NetArpWaitPacketMAC = ether;
 
 		/* size of the waiting packet */
-		NetArpWaitTxPacketSize = pkt_hdr_size + payload_len;
+		NetArpWaitTxPacketSize = len;
 
 		/* and do the ARP request */
 		NetArpWaitTry = 1;
@@ -738,24 +762,34 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		ArpRequest();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
+		debug_cond(DEBUG_DEV_PKT, "sending IP to %pI4/%pM\n",
 			&dest, ether);
-		NetSendPacket(NetTxPacket, pkt_hdr_size + payload_len);
+		NetSendPacket(NetTxPacket, len);
 		return 0;	/* transmitted */
 	}
 }
 
 #ifdef CONFIG_IP_DEFRAG
 /*
- * This function collects fragments in a single packet, according
- * to the algorithm in RFC815. It returns NULL or the pointer to
- * a complete packet, in static storage
+ * This function collects fragments in a single packet. It returns NULL
+ * or the pointer to a complete packet, in static storage
+ *
+ * Several datagrams can be assembled at the same time (e.g. with a
+ * window of NFS READs outstanding), each in its own slot. Fragments are
+ * copied to their final offset in the slot, in whatever order they come,
+ * and a bitmap of the 8 byte units received tells when all are there.
+ * A slot is given up when its datagram does not complete within
+ * CONFIG_NET_DEFRAG_TIMEOUT ms, or reused for a new datagram when all
+ * slots are busy, oldest first.
  */
-#ifndef CONFIG_NET_MAXDEFRAG
-#define CONFIG_NET_MAXDEFRAG 16384
+#ifndef CONFIG_NET_DEFRAG_SLOTS
+#define CONFIG_NET_DEFRAG_SLOTS 4
+#endif
+#ifndef CONFIG_NET_DEFRAG_TIMEOUT
+#define CONFIG_NET_DEFRAG_TIMEOUT 2000
 #endif
 /*
- * MAXDEFRAG, above, is chosen in the config file and  is real data
+ * MAXDEFRAG, in net.h, is chosen in the config file and  is real data
  * so we need to add the NFS overhead, which is more than TFTP.
  * To use sizeof in the internal unnamed structures, we need a real
  * instance (can't do "sizeof(struct rpc_t.u.reply))", unfortunately).
@@ -764,137 +798,122 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 static struct rpc_t rpc_specimen;
 #define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG + sizeof(rpc_specimen.u.reply))
 
-#define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE)
+/* An IP datagram can't carry more */
+#define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE < 0xffff - IP_HDR_SIZE ? \
+		   IP_PKTSIZE - IP_HDR_SIZE : 0xffff - IP_HDR_SIZE)
 
-/*
- * this is the packet being assembled, either data or frag control.
- * Fragments go by 8 bytes, so this union must be 8 bytes long
- */
-struct hole {
-	/* first_byte is address of this structure */
-	u16 last_byte;	/* last byte in this hole + 1 (begin of next hole) */
-	u16 next_hole;	/* index of next (in 8-b blocks), 0 == none */
-	u16 prev_hole;	/* index of prev, 0 == none */
-	u16 unused;
+/* Fragments go by 8 bytes */
+#define IP_FRAG_UNITS ((IP_MAXUDP + 7) / 8)
+
+struct defrag_slot {
+	/* IP header of the first fragment received, then the payload */
+	uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
+	uchar map[(IP_FRAG_UNITS + 7) / 8];	/* units received */
+	u16 units;		/* number of units received */
+	u16 total_len;		/* 0: slot free, 0xffff: length not known */
+	ulong start;		/* get_timer() when the first fragment came */
 };
 
+static struct defrag_slot defrag_slots[CONFIG_NET_DEFRAG_SLOTS];
+
+/* Find the slot of the datagram ip belongs to, or start one */
+static struct defrag_slot *defrag_slot(struct ip_udp_hdr *ip)
+{
+	struct defrag_slot *slot, *victim = NULL;
+	struct ip_udp_hdr *localip;
+	int i;
+
+	for (i = 0; i < CONFIG_NET_DEFRAG_SLOTS; i++) {
+		slot = &defrag_slots[i];
+		localip = (struct ip_udp_hdr *)slot->pkt_buff;
+
+		if (slot->total_len &&
+		    get_timer(slot->start) > CONFIG_NET_DEFRAG_TIMEOUT) {
+			debug("defrag: dropped datagram %04x\n",
+			      ntohs(localip->ip_id));
+			slot->total_len = 0;
+		}
+
+		if (!slot->total_len) {
+			if (!victim || victim->total_len)
+				victim = slot;
+			continue;
+		}
+		if (localip->ip_id == ip->ip_id &&
+		    localip->ip_p == ip->ip_p &&
+		    NetReadIP(&localip->ip_src) == NetReadIP(&ip->ip_src))
+			return slot;
+		if (!victim || (victim->total_len &&
+				slot->start < victim->start))
+			victim = slot;
+	}
+
+	/* new packet, reset the slot */
+	slot = victim;
+	slot->total_len = 0xffff;
+	slot->units = 0;
+	slot->start = get_timer(0);
+	memset(slot->map, 0, sizeof(slot->map));
+	/* any IP header will work, copy the first we received */
+	memcpy(slot->pkt_buff, ip, IP_HDR_SIZE);
+
+	return slot;
+}
+
 static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 {
-	static uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
-	static u16 first_hole, total_len;
-	struct hole *payload, *thisfrag, *h, *newh;
-	struct ip_udp_hdr *localip = (struct ip_udp_hdr *)pkt_buff;
+	struct defrag_slot *slot;
+	struct ip_udp_hdr *localip;
 	uchar *indata = (uchar *)ip;
-	int offset8, start, len, done = 0;
+	int offset8, start, len, unit, last;
 	u16 ip_off = ntohs(ip->ip_off);
 
-	/* payload starts after IP header, this fragment is in there */
-	payload = (struct hole *)(pkt_buff + IP_HDR_SIZE);
 	offset8 =  (ip_off & IP_OFFS);
-	thisfrag = payload + offset8;
 	start = offset8 * 8;
 	len = ntohs(ip->ip_len) - IP_HDR_SIZE;
 
-	if (start + len > IP_MAXUDP) /* fragment extends too far */
+	if (len <= 0 || start + len > IP_MAXUDP) /* fragment extends too far */
+		return NULL;
+	if ((ip_off & IP_FLAGS_MFRAG) && (len & 7)) /* only the last is short */
 		return NULL;
 
-	if (!total_len || localip->ip_id != ip->ip_id) {
-		/* new (or different) packet, reset structs */
-		total_len = 0xffff;
-		payload[0].last_byte = ~0;
-		payload[0].next_hole = 0;
-		payload[0].prev_hole = 0;
-		first_hole = 0;
-		/* any IP header will work, copy the first we received */
-		memcpy(localip, ip, IP_HDR_SIZE);
-	}
-
-	/*
-	 * What follows is the reassembly algorithm. We use the payload
-	 * array as a linked list of hole descriptors, as each hole starts
-	 * at a multiple of 8 bytes. However, last byte can be whatever value,
-	 * so it is represented as byte count, not as 8-byte blocks.
-	 */
+	slot = defrag_slot(ip);
+	localip = (struct ip_udp_hdr *)slot->pkt_buff;
 
-	h = payload + first_hole;
-	while (h->last_byte < start) {
-		if (!h->next_hole) {
-			/* no hole that far away */
+	if (!(ip_off & IP_FLAGS_MFRAG)) {
+		/* no more fragments: now the length is known */
+		if (slot->total_len != 0xffff && slot->total_len != start + len)
 			return NULL;
+		last = (start + len + 7) / 8;
+		for (unit = last; unit < IP_FRAG_UNITS; unit++) {
+			if (slot->map[unit / 8] & (1 << (unit % 8))) {
+				/* a fragment claimed to be past the end */
+				slot->total_len = 0;
+				return NULL;
+			}
 		}
-		h = payload + h->next_hole;
-	}
-
-	/* last fragment may be 1..7 bytes, the "+7" forces acceptance */
-	if (offset8 + ((len + 7) / 8) <= h - payload) {
-		/* no overlap with holes (dup fragment?) */
+		slot->total_len = start + len;
+	} else if (start + len > slot->total_len) {
 		return NULL;
 	}
 
-	if (!(ip_off & IP_FLAGS_MFRAG)) {
-		/* no more fragmentss: truncate this (last) hole */
-		total_len = start + len;
-		h->last_byte = start + len;
-	}
-
-	/*
-	 * There is some overlap: fix the hole list. This code doesn't
-	 * deal with a fragment that overlaps with two different holes
-	 * (thus being a superset of a previously-received fragment).
-	 */
-
-	if ((h >= thisfrag) && (h->last_byte <= start + len)) {
-		/* complete overlap with hole: remove hole */
-		if (!h->prev_hole && !h->next_hole) {
-			/* last remaining hole */
-			done = 1;
-		} else if (!h->prev_hole) {
-			/* first hole */
-			first_hole = h->next_hole;
-			payload[h->next_hole].prev_hole = 0;
-		} else if (!h->next_hole) {
-			/* last hole */
-			payload[h->prev_hole].next_hole = 0;
-		} else {
-			/* in the middle of the list */
-			payload[h->next_hole].prev_hole = h->prev_hole;
-			payload[h->prev_hole].next_hole = h->next_hole;
+	memcpy(slot->pkt_buff + IP_HDR_SIZE + start, indata + IP_HDR_SIZE, len);
+	last = offset8 + (len + 7) / 8;
+	for (unit = offset8; unit < last; unit++) {
+		if (!(slot->map[unit / 8] & (1 << (unit % 8)))) {
+			slot->map[unit / 8] |= 1 << (unit % 8);
+			slot->units++;
 		}
-
-	} else if (h->last_byte <= start + len) {
-		/* overlaps with final part of the hole: shorten this hole */
-		h->last_byte = start;
-
-	} else if (h >= thisfrag) {
-		/* overlaps with initial part of the hole: move this hole */
-		newh = thisfrag + (len / 8);
-		*newh = *h;
-		h = newh;
-		if (h->next_hole)
-			payload[h->next_hole].prev_hole = (h - payload);
-		if (h->prev_hole)
-			payload[h->prev_hole].next_hole = (h - payload);
-		else
-			first_hole = (h - payload);
-
-	} else {
-		/* fragment sits in the middle: split the hole */
-		newh = thisfrag + (len / 8);
-		*newh = *h;
-		h->last_byte = start;
-		h->next_hole = (newh - payload);
-		newh->prev_hole = (h - payload);
-		if (newh->next_hole)
-			payload[newh->next_hole].prev_hole = (newh - payload);
 	}
 
-	/* finally copy this fragment and possibly return whole packet */
-	memcpy((uchar *)thisfrag, indata + IP_HDR_SIZE, len);
-	if (!done)
+	if (slot->total_len == 0xffff ||
+	    slot->units < (slot->total_len + 7) / 8)
 		return NULL;
 
-	localip->ip_len = htons(total_len);
-	*lenp = total_len + IP_HDR_SIZE;
+	/* the slot is free again, its data stays until the next datagram */
+	localip->ip_len = htons(slot->total_len + IP_HDR_SIZE);
+	*lenp = slot->total_len + IP_HDR_SIZE;
+	slot->total_len = 0;
 	return localip;
 }
 
@@ -949,6 +968,17 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
+/*
+ * For drivers whose MAC checks IP and UDP/TCP checksums: csum tells
+ * which ones were found good, the net core does not check them again.
+ */
+void net_receive_csum(uchar *inpkt, int len, int csum)
+{
+	net_rx_csum = csum;
+	NetReceive(inpkt, len);
+	net_rx_csum = 0;
+}
+
 void
 NetReceive(uchar *inpkt, int len)
 {
@@ -1085,8 +1115,9 @@ NetReceive(uchar *inpkt, int len)
 		/* Can't deal with IP options (headers != 20 bytes) */
 		if ((ip->ip_hl_v & 0x0f) > 0x05)
 			return;
-		/* Check the Checksum of the header */
-		if (!NetCksumOk((uchar *)ip, IP_HDR_SIZE / 2)) {
+		/* Check the Checksum of the header, unless the MAC did */
+		if (!(net_rx_csum & NET_RX_CSUM_IP) &&
+		    !NetCksumOk((uchar *)ip, IP_HDR_SIZE / 2)) {
 			debug("checksum bad\n");
 			return;
 		}
@@ -1100,6 +1131,9 @@ NetReceive(uchar *inpkt, int len)
 		}
 		/* Read source IP address for later use */
 		src_ip = NetReadIP(&ip->ip_src);
+		/* The MAC can only have checked a whole, unfragmented packet */
+		if (ip->ip_off & htons(IP_OFFS | IP_FLAGS_MFRAG))
+			net_rx_csum &= ~NET_RX_CSUM_L4;
 		/*
 		 * The function returns the unchanged packet if it's not
 		 * a fragment, and either the complete packet or NULL if
@@ -1132,6 +1166,11 @@ NetReceive(uchar *inpkt, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_CMD_WGET)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_tcp_hdr *)ip, len, src_ip);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1141,42 +1180,17 @@ NetReceive(uchar *inpkt, int len)
 			&dst_ip, &src_ip, len);
 
 #ifdef CONFIG_UDP_CHECKSUM
-		if (ip->udp_xsum != 0) {
-			ulong   xsum;
-			ushort *sumptr;
-			ushort  sumlen;
-
-			xsum  = ip->ip_p;
-			xsum += (ntohs(ip->udp_len));
-			xsum += (ntohl(ip->ip_src) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_src) >>  0) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst) >> 16) & 0x0000ffff;
-			xsum += (ntohl(ip->ip_dst) >>  0) & 0x0000ffff;
-
-			sumlen = ntohs(ip->udp_len);
-			sumptr = (ushort *) &(ip->udp_src);
-
-			while (sumlen > 1) {
-				ushort sumdata;
-
-				sumdata = *sumptr++;
-				xsum += ntohs(sumdata);
-				sumlen -= 2;
-			}
-			if (sumlen > 0) {
-				ushort sumdata;
+		if (ip->udp_xsum != 0 && !(net_rx_csum & NET_RX_CSUM_L4)) {
+			unsigned udp_len = ntohs(ip->udp_len);
+			unsigned xsum;
 
-				sumdata = *(unsigned char *) sumptr;
-				sumdata = (sumdata << 8) & 0xff00;
-				xsum += sumdata;
-			}
-			while ((xsum >> 16) != 0) {
-				xsum = (xsum & 0x0000ffff) +
-				       ((xsum >> 16) & 0x0000ffff);
-			}
-			if ((xsum != 0x00000000) && (xsum != 0x0000ffff)) {
-				printf(" UDP wrong checksum %08lx %08x\n",
-					xsum, ntohs(ip->udp_xsum));
+			if (udp_len > len - IP_HDR_SIZE)
+				return;
+			xsum = net_cksum_pseudo((struct ip_hdr *)ip,
+						IPPROTO_UDP, udp_len);
+			if ((xsum + 1) & 0xfffe) {
+				printf(" UDP wrong checksum %04x %04x\n",
+				       xsum, ntohs(ip->udp_xsum));
 				return;
 			}
 		}
@@ -1250,6 +1264,8 @@ common:
 
 	case NETCONS:
 	case TFTPSRV:
+	case WGET:
+	case FASTBOOT:
 		if (NetOurIP == 0) {
 			puts("*** ERROR: `ipaddr' not set\n");
 			return 1;
@@ -1297,20 +1313,61 @@ NetCksumOk(uchar *ptr, int len)
 }
 
 
+/*
+ * Ones' complement sum of len 16 bit words. The words are summed as 32
+ * bit loads into a 64 bit accumulator, which needs no carry handling
+ * until the end; the folded result is the same.
+ */
 unsigned
 NetCksum(uchar *ptr, int len)
 {
-	ulong	xsum;
-	ushort *p = (ushort *)ptr;
+	u64	xsum = 0;
+	u32	*p;
+
+	/* Packets are 16 bit aligned, get to a 32 bit boundary first */
+	if (len > 0 && ((ulong)ptr & 2)) {
+		xsum = *(ushort *)ptr;
+		ptr += 2;
+		len--;
+	}
 
-	xsum = 0;
-	while (len-- > 0)
+	p = (u32 *)ptr;
+	for (; len >= 8; len -= 8, p += 4)
+		xsum += (u64)p[0] + p[1] + p[2] + p[3];
+	for (; len >= 2; len -= 2)
 		xsum += *p++;
+	if (len > 0)
+		xsum += *(ushort *)p;
+
+	xsum = (xsum & 0xffffffff) + (xsum >> 32);
+	xsum = (xsum & 0xffffffff) + (xsum >> 32);
 	xsum = (xsum & 0xffff) + (xsum >> 16);
 	xsum = (xsum & 0xffff) + (xsum >> 16);
 	return xsum & 0xffff;
 }
 
+/*
+ * Ones' complement sum over the pseudo header and the len bytes of
+ * UDP or TCP that follow the IP header, in the byte order of the packet.
+ * A valid packet sums up to 0xffff.
+ */
+unsigned
+net_cksum_pseudo(struct ip_hdr *ip, int proto, unsigned len)
+{
+	uchar *data = (uchar *)ip + IP_HDR_SIZE;
+	ulong sum;
+
+	sum = NetCksum((uchar *)&ip->ip_src, 4);
+	sum += htons(proto) + htons(len);
+	sum += NetCksum(data, len / 2);
+	if (len & 1)
+		sum += htons(data[len - 1] << 8);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return sum;
+}
+
 int
 NetEthHdrSize(void)
 {
@@ -1432,7 +1489,8 @@ void copy_filename(char *dst, const char *src, int size)
 
 #if	defined(CONFIG_CMD_NFS)		|| \
 	defined(CONFIG_CMD_SNTP)	|| \
-	defined(CONFIG_CMD_DNS)
+	defined(CONFIG_CMD_DNS)		|| \
+	defined(CONFIG_CMD_WGET)
 /*
  * make port a little random (1024-17407)
  * This keeps the math somewhat trivial to compute, and seems to work with
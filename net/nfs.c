@@ -28,6 +28,9 @@
 #include <malloc.h>
 #include "nfs.h"
 #include "bootp.h"
+#ifdef CONFIG_NET_SINK
+#include <net_sink.h>
+#endif
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
@@ -42,12 +45,32 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
-
-static char dirfh[NFS_FHSIZE];	/* file handle of directory */
-static char filefh[NFS_FHSIZE]; /* file handle of kernel image */
+static int nfs_version;		/* NFS protocol version in use, 2 or 3 */
+
+static char dirfh[NFS3_FHSIZE];	/* file handle of directory */
+static int dirfh_len;
+static char filefh[NFS3_FHSIZE]; /* file handle of kernel image */
+static int filefh_len;
+
+/* READ requests in flight */
+static struct nfs_read {
+	unsigned long xid;	/* 0: not waiting for a reply */
+	int busy;		/* slot in use (possibly complete) */
+	u64 offset;
+	unsigned len;		/* bytes requested */
+	unsigned filled;	/* bytes received so far */
+} nfs_reads[NFS_READ_WINDOW];
+static u64 nfs_read_next;	/* next offset to request */
+static u64 nfs_filesize;	/* file size, as far as we know it */
+static u64 nfs_received;
+static u64 nfs_next_hash;
+static int nfs_hashes;
+#ifdef CONFIG_NET_SINK
+/* The sink wants the file in order, early replies wait here */
+static uchar nfs_read_buf[NFS_READ_WINDOW][NFS_READ_SIZE];
+static u64 nfs_stored;		/* offset handed to the sink so far */
+#endif
 
 static enum net_loop_state nfs_download_state;
 static IPaddr_t NfsServerIP;
@@ -70,7 +93,7 @@ static char *nfs_path;
 static char nfs_path_buff[2048];
 
 static inline int
-store_block(uchar *src, unsigned offset, unsigned len)
+store_block(uchar *src, ulong offset, unsigned len)
 {
 	ulong newsize = offset + len;
 #ifdef CONFIG_SYS_DIRECT_FLASH_NFS
@@ -92,6 +115,12 @@ store_block(uchar *src, unsigned offset, unsigned len)
 		}
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_NFS */
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		if (net_sink_store(offset, src, len))
+			return -1;
+	} else
+#endif
 	{
 		(void)memcpy((void *)(load_addr + offset), src, len);
 	}
@@ -172,9 +201,23 @@ static long *rpc_add_credentials(long *p)
 }
 
 /**************************************************************************
-RPC_LOOKUP - Lookup RPC Port numbers
+RPC_ADD_FH - Add a file handle, encoded for the NFS version in use
 **************************************************************************/
-static void
+static uint32_t *rpc_add_fh(uint32_t *p, const char *fh, int fhlen)
+{
+	if (nfs_version == 3)
+		*p++ = htonl(fhlen);
+	if (fhlen & 3)
+		*(p + fhlen / 4) = 0;
+	memcpy(p, fh, fhlen);
+
+	return p + (fhlen + 3) / 4;
+}
+
+/**************************************************************************
+RPC_REQ - Send an RPC call, return its transaction id
+**************************************************************************/
+static unsigned long
 rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 {
 	struct rpc_t pkt;
@@ -182,13 +225,21 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 	uint32_t *p;
 	int pktlen;
 	int sport;
+	int vers;
+
+	if (rpc_prog == PROG_PORTMAP)
+		vers = 2;		/* portmapper is version 2 */
+	else if (rpc_prog == PROG_MOUNT)
+		vers = nfs_version == 3 ? 3 : 2;
+	else
+		vers = nfs_version;
 
 	id = ++rpc_id;
 	pkt.u.call.id = htonl(id);
 	pkt.u.call.type = htonl(MSG_CALL);
 	pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
 	pkt.u.call.prog = htonl(rpc_prog);
-	pkt.u.call.vers = htonl(2);	/* portmapper is version 2 */
+	pkt.u.call.vers = htonl(vers);
 	pkt.u.call.proc = htonl(rpc_proc);
 	p = (uint32_t *)&(pkt.u.call.data);
 
@@ -209,6 +260,8 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	NetSendUDPPacket(NetServerEther, NfsServerIP, sport, NfsOurPort,
 		pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -295,8 +348,7 @@ nfs_readlink_req(void)
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, filefh, filefh_len);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
@@ -319,8 +371,7 @@ nfs_lookup_req(char *fname)
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, dirfh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, dirfh, dirfh_len);
 	*p++ = htonl(fnamelen);
 	if (fnamelen & 3)
 		*(p + fnamelen / 4) = 0;
@@ -336,24 +387,41 @@ nfs_lookup_req(char *fname)
 NFS_READ - Read File on NFS Server
 **************************************************************************/
 static void
-nfs_read_req(int offset, int readlen)
+nfs_read_req(struct nfs_read *rd)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
+	u64 offset = rd->offset + rd->filled;
 
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
-	*p++ = htonl(offset);
-	*p++ = htonl(readlen);
-	*p++ = 0;
+	p = rpc_add_fh(p, filefh, filefh_len);
+	if (nfs_version == 3) {
+		*p++ = htonl(offset >> 32);
+		*p++ = htonl(offset);
+		*p++ = htonl(rd->len - rd->filled);
+	} else {
+		*p++ = htonl(offset);
+		*p++ = htonl(rd->len - rd->filled);
+		*p++ = 0;		/* totalcount, unused */
+	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	rd->xid = rpc_req(PROG_NFS, NFS_READ, data, len);
+}
+
+/* (Re)send the READ requests that have no reply yet */
+static void
+nfs_read_resend(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++)
+		if (nfs_reads[i].xid)
+			nfs_read_req(&nfs_reads[i]);
 }
 
 /**************************************************************************
@@ -367,10 +435,10 @@ NfsSend(void)
 
 	switch (NfsState) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
-		rpc_lookup_req(PROG_MOUNT, 1);
+		rpc_lookup_req(PROG_MOUNT, nfs_version == 3 ? 3 : 1);
 		break;
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
-		rpc_lookup_req(PROG_NFS, 2);
+		rpc_lookup_req(PROG_NFS, nfs_version);
 		break;
 	case STATE_MOUNT_REQ:
 		nfs_mount_req(nfs_path);
@@ -382,7 +450,7 @@ NfsSend(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -399,7 +467,8 @@ rpc_lookup_reply(int prog, uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	memcpy((unsigned char *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt)));
 
 	debug("%s\n", __func__);
 
@@ -432,7 +501,8 @@ nfs_mount_reply(uchar *pkt, unsigned len)
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	memcpy((unsigned char *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt)));
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
@@ -445,8 +515,16 @@ nfs_mount_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
+	if (nfs_version == 3) {
+		dirfh_len = ntohl(rpc_pkt.u.reply.data[1]);
+		if (dirfh_len > NFS3_FHSIZE)
+			return -1;
+		memcpy(dirfh, rpc_pkt.u.reply.data + 2, dirfh_len);
+	} else {
+		dirfh_len = NFS_FHSIZE;
+		memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	}
 	fs_mounted = 1;
-	memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
 
 	return 0;
 }
@@ -458,7 +536,8 @@ nfs_umountall_reply(uchar *pkt, unsigned len)
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	memcpy((unsigned char *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt)));
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
@@ -480,10 +559,12 @@ static int
 nfs_lookup_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint32_t *data;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	memcpy((unsigned char *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt)));
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
@@ -496,7 +577,24 @@ nfs_lookup_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	memcpy(filefh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	/* Take the file size from the attributes, if there are any */
+	data = rpc_pkt.u.reply.data + 1;
+	nfs_filesize = ~0ULL;
+	if (nfs_version == 3) {
+		filefh_len = ntohl(*data++);
+		if (filefh_len > NFS3_FHSIZE)
+			return -1;
+		memcpy(filefh, data, filefh_len);
+		data += (filefh_len + 3) / 4;
+		if (ntohl(*data++))
+			nfs_filesize = (u64)ntohl(data[NFS3_FATTR_SIZE]) << 32 |
+				       ntohl(data[NFS3_FATTR_SIZE + 1]);
+	} else {
+		filefh_len = NFS_FHSIZE;
+		memcpy(filefh, data, NFS_FHSIZE);
+		data += NFS_FHSIZE / 4;
+		nfs_filesize = ntohl(data[NFS_FATTR_SIZE]);
+	}
 
 	return 0;
 }
@@ -505,11 +603,14 @@ static int
 nfs_readlink_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint32_t *data;
+	char *path;
 	int rlen;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	memcpy((unsigned char *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt)));
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
@@ -522,36 +623,89 @@ nfs_readlink_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[1]); /* new path length */
+	data = rpc_pkt.u.reply.data + 1;
+	if (nfs_version == 3 && ntohl(*data++))
+		data += NFS3_FATTR_WORDS;	/* symlink attributes */
+	rlen = ntohl(*data++); /* new path length */
+	path = (char *)data;
 
-	if (*((char *)&(rpc_pkt.u.reply.data[2])) != '/') {
+	if (*path != '/') {
 		int pathlen;
 		strcat(nfs_path, "/");
 		pathlen = strlen(nfs_path);
-		memcpy(nfs_path + pathlen, (uchar *)&(rpc_pkt.u.reply.data[2]),
-			rlen);
+		memcpy(nfs_path + pathlen, path, rlen);
 		nfs_path[pathlen + rlen] = 0;
 	} else {
-		memcpy(nfs_path, (uchar *)&(rpc_pkt.u.reply.data[2]), rlen);
+		memcpy(nfs_path, path, rlen);
 		nfs_path[rlen] = 0;
 	}
 	return 0;
 }
 
+static struct nfs_read *
+nfs_read_find(unsigned long xid)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++)
+		if (nfs_reads[i].xid && nfs_reads[i].xid == xid)
+			return &nfs_reads[i];
+	return NULL;
+}
+
+static int
+nfs_read_store(struct nfs_read *rd, uchar *src, unsigned rlen, int eof)
+{
+	u64 pos = rd->offset + rd->filled;
+
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active())
+		memcpy(nfs_read_buf[rd - nfs_reads] + rd->filled, src, rlen);
+	else
+#endif
+	if (store_block(src, pos, rlen))
+		return -1;
+	rd->filled += rlen;
+
+	nfs_received += rlen;
+	while (nfs_received >= nfs_next_hash) {
+		putc('#');
+		if (!(++nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		nfs_next_hash += NFS_READ_SIZE / 2 * 10;
+	}
+
+	if (eof) {
+		if (nfs_filesize > pos + rlen)
+			nfs_filesize = pos + rlen;
+	} else if (rd->filled < rd->len) {
+		/* NFSv3 may return less than asked for, fetch the rest */
+		nfs_read_req(rd);
+	}
+
+	return 0;
+}
+
 static int
 nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
+	struct nfs_read *rd;
+	uint32_t *data;
+	unsigned off;
+	int rlen, eof;
 
 	debug("%s\n", __func__);
 
-	memcpy((uchar *)&rpc_pkt, pkt, sizeof(rpc_pkt.u.reply));
+	/* Enough for the largest (NFSv3) reply header */
+	memcpy((uchar *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt.u.reply) +
+				    NFS3_FATTR_WORDS * sizeof(uint32_t)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	rd = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!rd)
 		return -NFS_RPC_DROP;
+	rd->xid = 0;
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -564,20 +718,99 @@ nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
+	data = rpc_pkt.u.reply.data + 1;
+	if (nfs_version == 3) {
+		if (ntohl(*data++))
+			data += NFS3_FATTR_WORDS;
+		data++;				/* count */
+		eof = ntohl(*data++);
+	} else {
+		data += NFS_FATTR_WORDS;
+		eof = 0;
+	}
+	rlen = ntohl(*data++);
+	off = (uchar *)data - (uchar *)&rpc_pkt;
+	if (rlen > rd->len - rd->filled || off + rlen > len)
+		return -9999;
+
+	/* For NFSv2, a short read is the end of the file */
+	if (!rlen || (nfs_version == 2 && rd->filled + rlen < rd->len))
+		eof = 1;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[18]);
-	if (store_block((uchar *)pkt + sizeof(rpc_pkt.u.reply),
-			nfs_offset, rlen))
+	if (nfs_read_store(rd, pkt + off, rlen, eof))
 		return -9999;
 
 	return rlen;
 }
 
+/*
+ * Retire the completed reads (in file order when writing to a sink) and
+ * keep the window full. Returns 1 once the whole file is in, -1 on a
+ * storage error.
+ */
+static int
+nfs_read_more(void)
+{
+	struct nfs_read *rd;
+	int i, busy = 0;
+	int in_order = 0;
+
+#ifdef CONFIG_NET_SINK
+	in_order = net_sink_active();
+	for (i = 0; in_order && i < NFS_READ_WINDOW; i++) {
+		rd = &nfs_reads[i];
+		/* A slot is complete when it no longer waits for a reply */
+		if (!rd->busy || rd->xid || rd->offset != nfs_stored)
+			continue;
+		if (store_block(nfs_read_buf[i], rd->offset, rd->filled))
+			return -1;
+		nfs_stored += rd->filled;
+		rd->busy = 0;
+		i = -1;			/* look for the next one */
+	}
+#endif
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		rd = &nfs_reads[i];
+		/* Complete, or beyond the end of the file */
+		if (rd->busy && ((!rd->xid && !in_order) ||
+				 rd->offset >= nfs_filesize)) {
+			rd->busy = 0;
+			rd->xid = 0;
+		}
+		if (!rd->busy && nfs_read_next < nfs_filesize) {
+			rd->busy = 1;
+			rd->offset = nfs_read_next;
+			rd->len = NFS_READ_SIZE;
+			rd->filled = 0;
+			nfs_read_next += NFS_READ_SIZE;
+			nfs_read_req(rd);
+		}
+		busy |= rd->busy;
+	}
+
+	return !busy;
+}
+
+static void
+nfs_read_start(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		nfs_reads[i].busy = 0;
+		nfs_reads[i].xid = 0;
+	}
+	nfs_read_next = 0;
+	nfs_received = 0;
+	nfs_next_hash = 0;
+	nfs_hashes = 0;
+#ifdef CONFIG_NET_SINK
+	nfs_stored = 0;
+#endif
+	nfs_read_more();
+}
+
 /**************************************************************************
 Interfaces of U-BOOT
 **************************************************************************/
@@ -601,6 +834,7 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 {
 	int rlen;
 	int reply;
+	int done;
 
 	debug("%s\n", __func__);
 
@@ -616,9 +850,20 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 		break;
 
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
-		if (rpc_lookup_reply(PROG_NFS, pkt, len) == -NFS_RPC_DROP)
+		reply = rpc_lookup_reply(PROG_NFS, pkt, len);
+		if (reply == -NFS_RPC_DROP)
 			break;
-		NfsState = STATE_MOUNT_REQ;
+		if (nfs_version == 3 &&
+		    (reply || NfsSrvMountPort <= 0 || NfsSrvNfsPort <= 0)) {
+			/* No NFSv3 on the server, use NFSv2 */
+			debug("NFSv3 not available, trying NFSv2\n");
+			nfs_version = 2;
+			NfsSrvMountPort = 0;
+			NfsSrvNfsPort = 0;
+			NfsState = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+		} else {
+			NfsState = STATE_MOUNT_REQ;
+		}
 		NfsSend();
 		break;
 
@@ -660,9 +905,7 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 			NfsSend();
 		} else {
 			NfsState = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			NfsSend();
+			nfs_read_start();
 		}
 		break;
 
@@ -686,17 +929,30 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		NetSetTimeout(nfs_timeout, NfsTimeout);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			NfsSend();
+		done = rlen >= 0 ? nfs_read_more() : 0;
+		if (rlen >= 0 && !done) {
+			NfsTimeoutCount = 0;
+#ifdef CONFIG_NET_SINK
+			/* Write out full chunks while the next reply comes in */
+			if (net_sink_active() && net_sink_sync()) {
+				net_set_state(NETLOOP_FAIL);
+				break;
+			}
+#endif
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			NfsState = STATE_READLINK_REQ;
 			NfsSend();
 		} else {
-			if (!rlen)
+			if (done > 0)
 				nfs_download_state = NETLOOP_SUCCESS;
+#ifdef CONFIG_NET_SINK
+			if (done > 0 && net_sink_active() && net_sink_finish())
+				nfs_download_state = NETLOOP_FAIL;
+#endif
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend();
 		}
@@ -767,7 +1023,11 @@ NfsStart(void)
 		printf(" Size is 0x%x Bytes = ", NetBootFileSize<<9);
 		print_size(NetBootFileSize<<9, "");
 	}
-	printf("\nLoad address: 0x%lx\n"
+	putc('\n');
+#ifdef CONFIG_NET_SINK
+	net_sink_start();
+#endif
+	printf("Load address: 0x%lx\n"
 		"Loading: *\b", load_addr);
 
 	NetSetTimeout(nfs_timeout, NfsTimeout);
@@ -775,6 +1035,9 @@ NfsStart(void)
 
 	NfsTimeoutCount = 0;
 	NfsState = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+	nfs_version = 3;
+	NfsSrvMountPort = 0;
+	NfsSrvNfsPort = 0;
 
 	/*NfsOurPort = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
@@ -26,6 +26,14 @@
 #define NFS_READ        6
 
 #define NFS_FHSIZE      32
+#define NFS3_FHSIZE     64
+
+/* fattr3 is 21 words; the file size is the 64 bit value at word 5 */
+#define NFS3_FATTR_WORDS 21
+#define NFS3_FATTR_SIZE  5
+/* fattr (v2) is 17 words; the file size is word 5 */
+#define NFS_FATTR_WORDS  17
+#define NFS_FATTR_SIZE   5
 
 #define NFSERR_PERM     1
 #define NFSERR_NOENT    2
@@ -40,10 +48,22 @@
  */
 #ifdef CONFIG_NFS_READ_SIZE
 #define NFS_READ_SIZE CONFIG_NFS_READ_SIZE
+#elif defined(CONFIG_IP_DEFRAG)
+#define NFS_READ_SIZE 8192 /* NFSv2 maximum, fits the default defrag size */
 #else
 #define NFS_READ_SIZE 1024 /* biggest power of two that fits Ether frame */
 #endif
 
+/*
+ * Number of READ requests kept in flight. Replies are placed at their
+ * offsets in whatever order they arrive.
+ */
+#ifdef CONFIG_NFS_READ_WINDOW
+#define NFS_READ_WINDOW CONFIG_NFS_READ_WINDOW
+#else
+#define NFS_READ_WINDOW 4
+#endif
+
 #define NFS_MAXLINKDEPTH 16
 
 struct rpc_t {
@@ -0,0 +1,514 @@
+/*
+ * Stream network downloads straight into storage
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <net.h>
+#include <asm/unaligned.h>
+#include <net_sink.h>
+#include <sparse_format.h>
+#ifdef CONFIG_STORE_COMPATIBLE
+#include <amlogic/storage_if.h>
+#endif
+#ifdef CONFIG_CMD_UBI
+#include <ubi_uboot.h>
+#endif
+
+#ifndef CONFIG_NET_SINK_CHUNK_SIZE
+#define CONFIG_NET_SINK_CHUNK_SIZE	(1 << 20)
+#endif
+
+/* The buffer holds a chunk being filled while the previous one waits */
+#define SINK_BUF_SIZE		(2 * CONFIG_NET_SINK_CHUNK_SIZE)
+
+enum {
+	SINK_NONE,
+	SINK_BLK,
+	SINK_STORE,
+	SINK_UBI,
+};
+
+enum {
+	SPARSE_HEADER,
+	SPARSE_CHUNK_HEADER,
+	SPARSE_RAW,
+	SPARSE_FILL,
+	SPARSE_SKIP,
+	SPARSE_DONE,
+};
+
+/* What the 'netsink' command set up */
+static int sink_type;
+static int sink_sparse;
+static block_dev_desc_t *sink_dev;
+static disk_partition_t sink_part;
+static char sink_name[32];
+static ulong sink_size;
+
+/* State of the running download */
+static int sink_used;		/* a download started on the sink */
+static int sink_running;
+static int sink_err;
+static uchar *sink_buf;
+static ulong sink_len;		/* bytes waiting in sink_buf */
+static u64 sink_out;		/* output offset of sink_buf[0] */
+static ulong sink_in;		/* bytes of the download consumed */
+static ulong sink_write_ms;	/* time spent writing */
+
+/* Android sparse image decoder */
+static struct {
+	int state;
+	uchar hdr[64];
+	unsigned hdr_len;
+	unsigned hdr_need;
+	u64 remain;
+	u32 blk_sz;
+	u32 chunk_hdr_sz;
+	u32 chunks;
+	u32 chunk_blocks;
+} sp;
+
+static int sink_fail(const char *msg)
+{
+	printf("\nnetsink: %s\n", msg);
+	sink_err = 1;
+	return -1;
+}
+
+/*
+ * Output side: write @len bytes of sink_buf at output offset sink_out
+ */
+static int sink_write(ulong len)
+{
+	ulong start = get_timer(0);
+	int ret = 0;
+
+	switch (sink_type) {
+	case SINK_BLK: {
+		lbaint_t blk = sink_out / sink_dev->blksz;
+		lbaint_t cnt = len / sink_dev->blksz;
+
+		if (blk + cnt > sink_part.size)
+			return sink_fail("image does not fit the partition");
+		if (sink_dev->block_write(sink_dev->dev, sink_part.start + blk,
+					  cnt, sink_buf) != cnt)
+			ret = -1;
+		break;
+	}
+#ifdef CONFIG_STORE_COMPATIBLE
+	case SINK_STORE:
+		ret = store_write_ops((unsigned char *)sink_name, sink_buf,
+				      sink_out, len);
+		break;
+#endif
+#ifdef CONFIG_CMD_UBI
+	case SINK_UBI:
+		if (sink_out + len > sink_size)
+			return sink_fail("download larger than given size");
+		if (sink_out == 0)
+			ret = ubi_volume_begin_write(sink_name, sink_buf, len,
+						     sink_size);
+		else
+			ret = ubi_volume_continue_write(sink_name, sink_buf,
+							len);
+		break;
+#endif
+	default:
+		ret = -1;
+		break;
+	}
+
+	sink_write_ms += get_timer(start);
+	if (ret)
+		return sink_fail("write failed");
+
+	return 0;
+}
+
+/*
+ * Write out the complete chunks in sink_buf, or everything if @final
+ */
+static int sink_flush(int final)
+{
+	ulong len;
+
+	if (final) {
+		len = sink_len;
+		if (sink_type == SINK_BLK)
+			len = roundup(len, sink_dev->blksz);
+	} else {
+		len = sink_len - sink_len % CONFIG_NET_SINK_CHUNK_SIZE;
+	}
+
+	if (!len)
+		return 0;
+	if (sink_write(len))
+		return -1;
+
+	sink_out += len;
+	sink_len = final ? 0 : sink_len - len;
+	if (sink_len)
+		memmove(sink_buf, sink_buf + len, sink_len);
+
+	return 0;
+}
+
+static int sink_append(const uchar *src, ulong len)
+{
+	ulong n;
+
+	while (len) {
+		if (sink_len == SINK_BUF_SIZE && sink_flush(0))
+			return -1;
+		n = min(len, SINK_BUF_SIZE - sink_len);
+		memcpy(sink_buf + sink_len, src, n);
+		sink_len += n;
+		src += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int sink_fill(u32 val, u64 len)
+{
+	ulong i, n;
+
+	/* Chunks are blk_sz multiples, so sink_len stays 4 byte aligned */
+	while (len) {
+		if (sink_len == SINK_BUF_SIZE && sink_flush(0))
+			return -1;
+		n = min_t(u64, len, SINK_BUF_SIZE - sink_len);
+		for (i = 0; i < n; i += 4)
+			*(u32 *)(sink_buf + sink_len + i) = val;
+		sink_len += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Continue the output at @pos, leaving a hole */
+static int sink_seek(u64 pos)
+{
+	if (sink_type == SINK_UBI)
+		return sink_fail("cannot seek in a UBI volume");
+	if (sink_flush(1))
+		return -1;
+	if (sink_type == SINK_BLK && pos % sink_dev->blksz)
+		return sink_fail("sparse block size not a multiple of the device block size");
+	sink_out = pos;
+
+	return 0;
+}
+
+/*
+ * Input side: Android sparse image, decoded as it streams in
+ */
+static void sparse_next_chunk(void)
+{
+	if (!sp.chunks) {
+		sp.state = SPARSE_DONE;
+	} else {
+		sp.state = SPARSE_CHUNK_HEADER;
+		sp.hdr_len = 0;
+		sp.hdr_need = sp.chunk_hdr_sz;
+	}
+}
+
+static int sparse_parse_header(void)
+{
+	sparse_header_t *sh = (sparse_header_t *)sp.hdr;
+
+	if (le32_to_cpu(sh->magic) != SPARSE_HEADER_MAGIC)
+		return sink_fail("not a sparse image");
+	if (le16_to_cpu(sh->major_version) != 1)
+		return sink_fail("unsupported sparse image version");
+
+	sp.blk_sz = le32_to_cpu(sh->blk_sz);
+	sp.chunk_hdr_sz = le16_to_cpu(sh->chunk_hdr_sz);
+	sp.chunks = le32_to_cpu(sh->total_chunks);
+	if (!sp.blk_sz || sp.blk_sz % 4 ||
+	    (sink_type == SINK_BLK && sp.blk_sz % sink_dev->blksz))
+		return sink_fail("bad sparse block size");
+	if (sp.chunk_hdr_sz < sizeof(chunk_header_t) ||
+	    sp.chunk_hdr_sz > sizeof(sp.hdr))
+		return sink_fail("bad sparse chunk header size");
+
+	sparse_next_chunk();
+	return 0;
+}
+
+static int sparse_parse_chunk(void)
+{
+	chunk_header_t *ch = (chunk_header_t *)sp.hdr;
+	u64 out_sz, data_sz;
+
+	sp.chunks--;
+	sp.chunk_blocks = le32_to_cpu(ch->chunk_sz);
+	out_sz = (u64)sp.chunk_blocks * sp.blk_sz;
+	data_sz = le32_to_cpu(ch->total_sz) - sp.chunk_hdr_sz;
+
+	switch (le16_to_cpu(ch->chunk_type)) {
+	case CHUNK_TYPE_RAW:
+		if (data_sz != out_sz)
+			return sink_fail("bad sparse raw chunk");
+		sp.state = SPARSE_RAW;
+		sp.remain = data_sz;
+		break;
+	case CHUNK_TYPE_FILL:
+		if (data_sz != sizeof(u32))
+			return sink_fail("bad sparse fill chunk");
+		sp.state = SPARSE_FILL;
+		sp.hdr_len = 0;
+		sp.hdr_need = sizeof(u32);
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		if (sink_seek(sink_out + sink_len + out_sz))
+			return -1;
+		/* fall through */
+	case CHUNK_TYPE_CRC32:
+		sp.state = SPARSE_SKIP;
+		sp.remain = data_sz;
+		break;
+	default:
+		return sink_fail("unknown sparse chunk type");
+	}
+
+	if ((sp.state == SPARSE_RAW || sp.state == SPARSE_SKIP) && !sp.remain)
+		sparse_next_chunk();
+
+	return 0;
+}
+
+static int sparse_feed(const uchar *src, ulong len)
+{
+	ulong n;
+	int ret = 0;
+
+	while (len && !ret) {
+		switch (sp.state) {
+		case SPARSE_HEADER:
+		case SPARSE_CHUNK_HEADER:
+		case SPARSE_FILL:
+			n = min_t(ulong, len, sp.hdr_need - sp.hdr_len);
+			memcpy(sp.hdr + sp.hdr_len, src, n);
+			sp.hdr_len += n;
+			if (sp.hdr_len < sp.hdr_need)
+				break;
+			if (sp.state == SPARSE_HEADER) {
+				ret = sparse_parse_header();
+			} else if (sp.state == SPARSE_CHUNK_HEADER) {
+				ret = sparse_parse_chunk();
+			} else {
+				ret = sink_fill(get_unaligned((u32 *)sp.hdr),
+						(u64)sp.chunk_blocks *
+						sp.blk_sz);
+				sparse_next_chunk();
+			}
+			break;
+		case SPARSE_RAW:
+		case SPARSE_SKIP:
+			n = min_t(u64, len, sp.remain);
+			if (sp.state == SPARSE_RAW)
+				ret = sink_append(src, n);
+			sp.remain -= n;
+			if (!sp.remain)
+				sparse_next_chunk();
+			break;
+		default:
+			/* Trailing bytes after the last chunk */
+			n = len;
+			break;
+		}
+		src += n;
+		len -= n;
+	}
+
+	return ret;
+}
+
+/*
+ * Interface to the protocols
+ */
+void net_sink_start(void)
+{
+	if (sink_type == SINK_NONE)
+		return;
+
+	if (!sink_buf) {
+		sink_buf = memalign(ARCH_DMA_MINALIGN, SINK_BUF_SIZE);
+		if (!sink_buf) {
+			puts("netsink: out of memory, downloading to RAM\n");
+			net_sink_disarm();
+			return;
+		}
+	}
+
+	sink_used = 1;
+	sink_running = 1;
+	sink_err = 0;
+	sink_len = 0;
+	sink_out = 0;
+	sink_in = 0;
+	sink_write_ms = 0;
+	memset(&sp, 0, sizeof(sp));
+	sp.state = SPARSE_HEADER;
+	sp.hdr_need = sizeof(sparse_header_t);
+
+	net_sink_print();
+}
+
+int net_sink_active(void)
+{
+	return sink_running;
+}
+
+int net_sink_store(ulong offset, const uchar *src, ulong len)
+{
+	if (sink_err)
+		return -1;
+
+	/* Drop what we already have, e.g. a late reply to a resent request */
+	if (offset < sink_in) {
+		if (offset + len <= sink_in)
+			return 0;
+		src += sink_in - offset;
+		len -= sink_in - offset;
+		offset = sink_in;
+	}
+	if (offset != sink_in)
+		return sink_fail("data out of order");
+	sink_in += len;
+
+	if (sink_sparse)
+		return sparse_feed(src, len);
+
+	return sink_append(src, len);
+}
+
+int net_sink_sync(void)
+{
+	if (sink_err)
+		return -1;
+	if (sink_len < CONFIG_NET_SINK_CHUNK_SIZE)
+		return 0;
+
+	return sink_flush(0);
+}
+
+int net_sink_finish(void)
+{
+	if (sink_err)
+		return -1;
+	if (sink_sparse && sp.state != SPARSE_DONE)
+		return sink_fail("sparse image is truncated");
+	/* Block devices (and NAND behind store) round up to whole blocks */
+	memset(sink_buf + sink_len, 0, SINK_BUF_SIZE - sink_len);
+	if (sink_flush(1))
+		return -1;
+	if (sink_type == SINK_UBI && sink_out < sink_size)
+		return sink_fail("download smaller than given size");
+
+	printf("netsink: %lu bytes in, %llu bytes written (%lu ms writing)\n",
+	       sink_in, sink_out, sink_write_ms);
+	sink_running = 0;
+
+	return 0;
+}
+
+int net_sink_end(void)
+{
+	/* Stay armed if the network command did not download anything */
+	if (!sink_used)
+		return 0;
+
+	if (sink_running) {
+		puts("netsink: download did not complete, target left partially written\n");
+		sink_running = 0;
+	}
+	free(sink_buf);
+	sink_buf = NULL;
+	sink_used = 0;
+	net_sink_disarm();
+
+	return 1;
+}
+
+/*
+ * Interface to the 'netsink' command
+ */
+int net_sink_arm_blk(block_dev_desc_t *dev_desc, disk_partition_t *info,
+		     int sparse)
+{
+	net_sink_disarm();
+	sink_dev = dev_desc;
+	sink_part = *info;
+	sink_sparse = sparse;
+	sink_type = SINK_BLK;
+
+	return 0;
+}
+
+int net_sink_arm_store(const char *part, int sparse)
+{
+#ifdef CONFIG_STORE_COMPATIBLE
+	net_sink_disarm();
+	strncpy(sink_name, part, sizeof(sink_name) - 1);
+	sink_sparse = sparse;
+	sink_type = SINK_STORE;
+
+	return 0;
+#else
+	puts("netsink: store support not enabled\n");
+	return -1;
+#endif
+}
+
+int net_sink_arm_ubi(const char *volume, ulong size)
+{
+#ifdef CONFIG_CMD_UBI
+	net_sink_disarm();
+	strncpy(sink_name, volume, sizeof(sink_name) - 1);
+	sink_size = size;
+	sink_type = SINK_UBI;
+
+	return 0;
+#else
+	puts("netsink: UBI support not enabled\n");
+	return -1;
+#endif
+}
+
+void net_sink_disarm(void)
+{
+	sink_type = SINK_NONE;
+	sink_sparse = 0;
+	sink_dev = NULL;
+	memset(sink_name, 0, sizeof(sink_name));
+	sink_size = 0;
+}
+
+void net_sink_print(void)
+{
+	switch (sink_type) {
+	case SINK_BLK:
+		printf("netsink: writing to device %d, blocks " LBAF "+" LBAF,
+		       sink_dev->dev, sink_part.start, sink_part.size);
+		break;
+	case SINK_STORE:
+		printf("netsink: writing to store partition '%s'", sink_name);
+		break;
+	case SINK_UBI:
+		printf("netsink: writing %lu bytes to UBI volume '%s'",
+		       sink_size, sink_name);
+		break;
+	default:
+		puts("netsink: off\n");
+		return;
+	}
+	puts(sink_sparse ? " (sparse)\n" : "\n");
+}
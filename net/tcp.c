@@ -0,0 +1,521 @@
+/*
+ * Minimal TCP client, enough to pull large files over routed links
+ *
+ * One connection at a time. Received data is handed to the user as soon
+ * as it is in order, so the receive window does not need a buffer behind
+ * it and can be large (with window scaling). Segments that arrive ahead
+ * of a hole are kept in a small queue and answered with duplicate ACKs,
+ * which makes the sender fast-retransmit just the missing segment.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include <asm/unaligned.h>
+#include "tcp.h"
+
+/* Receive window we advertise */
+#ifndef CONFIG_TCP_WINDOW
+#define CONFIG_TCP_WINDOW	(256 * 1024)
+#endif
+
+/* Number of out-of-order segments we keep */
+#ifndef CONFIG_TCP_OOO_SEGS
+#define CONFIG_TCP_OOO_SEGS	16
+#endif
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+#define TCP_OPT_EOL	0
+#define TCP_OPT_NOP	1
+#define TCP_OPT_MSS	2
+#define TCP_OPT_WSCALE	3
+
+#define TCP_TICK_MS	10		/* timer resolution */
+#define TCP_DELACK_MS	20		/* delayed ACK */
+#define TCP_RTO_INIT	1000		/* initial retransmit timeout */
+#define TCP_RTO_MAX	8000
+#define TCP_RETRIES	8
+#define TCP_IDLE_MS	30000		/* give up on a silent peer */
+#define TCP_DUPACKS	3		/* fast retransmit threshold */
+
+#define SEQ_LT(a, b)	((int)((a) - (b)) < 0)
+#define SEQ_LE(a, b)	((int)((a) - (b)) <= 0)
+#define SEQ_GT(a, b)	((int)((a) - (b)) > 0)
+
+enum {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSE_WAIT,		/* got the peer's FIN */
+};
+
+static int tcp_state;
+static tcp_event_f *tcp_event_handler;
+static tcp_rx_f *tcp_rx_handler;
+
+static IPaddr_t tcp_remote_ip;
+static uchar tcp_remote_ether[6];
+static int tcp_remote_port;
+static int tcp_local_port;
+
+/* Send side: unacknowledged data starts at snd_una */
+static u32 snd_una;
+static u32 snd_nxt;
+static unsigned snd_mss;
+static uchar tx_buf[TCP_MSS];
+static unsigned tx_len;
+static int dupacks;
+static ulong rto;
+static ulong rto_start;
+static int retries;
+
+/* Receive side */
+static u32 rcv_nxt;
+static int rcv_wscale;
+static int ack_pending;		/* segments received but not acked */
+static ulong ack_start;
+static ulong last_rx;
+
+/* Segments received ahead of rcv_nxt */
+static struct tcp_ooo {
+	u32 seq;
+	unsigned len;		/* 0: free slot */
+	int fin;
+	uchar data[TCP_MSS];
+} ooo[CONFIG_TCP_OOO_SEGS];
+static int ooo_count;
+
+static void tcp_send_segment(int flags, u32 seq, const uchar *data,
+			     unsigned len)
+{
+	struct ip_tcp_hdr *ip;
+	uchar *opt;
+	int eth_hdr_size;
+	unsigned hlen = TCP_HDR_SIZE;
+	ulong win = CONFIG_TCP_WINDOW;
+
+	eth_hdr_size = NetSetEther(NetTxPacket, tcp_remote_ether, PROT_IP);
+	ip = (struct ip_tcp_hdr *)(NetTxPacket + eth_hdr_size);
+
+	if (flags & TCP_SYN) {
+		opt = (uchar *)ip + IP_TCP_HDR_SIZE;
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCP_OPT_NOP;
+		opt[5] = TCP_OPT_WSCALE;
+		opt[6] = 3;
+		opt[7] = rcv_wscale;
+		hlen += 8;
+		/* The window in a SYN is never scaled */
+		win = min_t(ulong, win, 0xffff);
+	} else {
+		win >>= rcv_wscale;
+	}
+	if (len)
+		memcpy((uchar *)ip + IP_HDR_SIZE + hlen, data, len);
+
+	net_set_ip_header((uchar *)ip, tcp_remote_ip, NetOurIP);
+	ip->ip_len = htons(IP_HDR_SIZE + hlen + len);
+	ip->ip_p = IPPROTO_TCP;
+	ip->ip_sum = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
+
+	if (tcp_state != TCP_SYN_SENT)
+		flags |= TCP_ACK;
+	ip->tcp_src = htons(tcp_local_port);
+	ip->tcp_dst = htons(tcp_remote_port);
+	put_unaligned_be32(seq, ip->tcp_seq);
+	put_unaligned_be32(flags & TCP_ACK ? rcv_nxt : 0, ip->tcp_ack);
+	ip->tcp_hlen = (hlen / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(min_t(ulong, win, 0xffff));
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = 0;
+	ip->tcp_xsum = ~net_cksum_pseudo((struct ip_hdr *)ip, IPPROTO_TCP,
+					 hlen + len);
+
+	/* Every segment carries the latest ACK */
+	ack_pending = 0;
+
+	net_send_ip_packet(tcp_remote_ether, tcp_remote_ip,
+			   eth_hdr_size + IP_HDR_SIZE + hlen + len);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(0, snd_nxt, NULL, 0);
+}
+
+/* Send the queued data from @seq on */
+static void tcp_output(u32 seq)
+{
+	unsigned off = seq - snd_una;
+	unsigned len;
+
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_send_segment(TCP_SYN, snd_una, NULL, 0);
+		return;
+	}
+
+	while (off < tx_len) {
+		len = min(tx_len - off, snd_mss);
+		tcp_send_segment(off + len == tx_len ? TCP_PSH : 0,
+				 snd_una + off, tx_buf + off, len);
+		off += len;
+	}
+	if (SEQ_GT(snd_una + tx_len, snd_nxt))
+		snd_nxt = snd_una + tx_len;
+}
+
+static void tcp_closed(enum tcp_event ev)
+{
+	tcp_state = TCP_CLOSED;
+	NetSetTimeout(0, NULL);
+	tcp_event_handler(ev);
+}
+
+void tcp_abort(void)
+{
+	if (tcp_state == TCP_CLOSED)
+		return;
+	tcp_send_segment(TCP_RST, snd_nxt, NULL, 0);
+	tcp_state = TCP_CLOSED;
+	NetSetTimeout(0, NULL);
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_CLOSED)
+		return;
+	/*
+	 * Nothing is left to send at this point; the FIN is not retried,
+	 * the peer gets rid of the connection on its own.
+	 */
+	tcp_send_segment(TCP_FIN, snd_nxt, NULL, 0);
+	tcp_state = TCP_CLOSED;
+	NetSetTimeout(0, NULL);
+}
+
+int tcp_send(const uchar *data, unsigned len)
+{
+	if (tcp_state != TCP_ESTABLISHED || tx_len + len > sizeof(tx_buf))
+		return -1;
+
+	memcpy(tx_buf + tx_len, data, len);
+	tx_len += len;
+	if (snd_una == snd_nxt) {
+		rto_start = get_timer(0);
+		retries = 0;
+	}
+	tcp_output(snd_nxt);
+
+	return 0;
+}
+
+static void tcp_timer(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (now - last_rx > TCP_IDLE_MS) {
+		puts("\nTCP: connection timed out\n");
+		tcp_abort();
+		tcp_event_handler(TCP_EV_ABORTED);
+		return;
+	}
+
+	if (snd_una != snd_nxt && now - rto_start > rto) {
+		if (++retries > TCP_RETRIES) {
+			puts("\nTCP: retry count exceeded\n");
+			tcp_abort();
+			tcp_event_handler(TCP_EV_ABORTED);
+			return;
+		}
+		rto = min_t(ulong, rto * 2, TCP_RTO_MAX);
+		rto_start = now;
+		tcp_output(snd_una);
+	}
+
+	if (ack_pending && now - ack_start > TCP_DELACK_MS)
+		tcp_send_ack();
+
+	NetSetTimeout(TCP_TICK_MS, tcp_timer);
+}
+
+void tcp_start(IPaddr_t dest, int dport, tcp_event_f *event, tcp_rx_f *rx)
+{
+	int i;
+
+	tcp_event_handler = event;
+	tcp_rx_handler = rx;
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	tcp_local_port = random_port();
+	memcpy(tcp_remote_ether, NetEtherNullAddr, 6);
+
+	rcv_wscale = 0;
+	while ((CONFIG_TCP_WINDOW >> rcv_wscale) > 0xffff)
+		rcv_wscale++;
+	snd_mss = 536;
+
+	snd_una = get_ticks();
+	snd_nxt = snd_una + 1;		/* the SYN */
+	tx_len = 0;
+	dupacks = 0;
+	retries = 0;
+	rto = TCP_RTO_INIT;
+	rto_start = get_timer(0);
+	last_rx = rto_start;
+	rcv_nxt = 0;
+	ack_pending = 0;
+	for (i = 0; i < CONFIG_TCP_OOO_SEGS; i++)
+		ooo[i].len = 0;
+	ooo_count = 0;
+
+	tcp_state = TCP_SYN_SENT;
+	tcp_output(snd_una);
+	NetSetTimeout(TCP_TICK_MS, tcp_timer);
+}
+
+static void tcp_parse_options(const uchar *opt, int len)
+{
+	int wscale = -1;
+
+	while (len > 0 && opt[0] != TCP_OPT_EOL) {
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		if (opt[0] == TCP_OPT_MSS && opt[1] == 4)
+			snd_mss = min_t(unsigned, get_unaligned_be16(opt + 2),
+					TCP_MSS);
+		else if (opt[0] == TCP_OPT_WSCALE && opt[1] == 3)
+			wscale = opt[2];
+		len -= opt[1];
+		opt += opt[1];
+	}
+
+	/*
+	 * Window scaling is only on if both sides ask for it. We never
+	 * have more than one segment in flight, so the peer's window
+	 * itself does not matter.
+	 */
+	if (wscale < 0)
+		rcv_wscale = 0;
+}
+
+static void tcp_process_ack(u32 ack, int flags, unsigned len)
+{
+	u32 acked;
+
+	if (SEQ_GT(ack, snd_una) && SEQ_LE(ack, snd_nxt)) {
+		acked = min(ack - snd_una, tx_len);
+		tx_len -= acked;
+		memmove(tx_buf, tx_buf + acked, tx_len);
+		snd_una = ack;
+		dupacks = 0;
+		retries = 0;
+		rto = TCP_RTO_INIT;
+		rto_start = get_timer(0);
+	} else if (ack == snd_una && snd_una != snd_nxt && !len &&
+		   !(flags & (TCP_SYN | TCP_FIN))) {
+		/* The peer is missing what we sent first */
+		if (++dupacks == TCP_DUPACKS)
+			tcp_output(snd_una);
+	}
+}
+
+static void tcp_ooo_add(u32 seq, const uchar *data, unsigned len, int fin)
+{
+	struct tcp_ooo *free_slot = NULL;
+	int i;
+
+	for (i = 0; i < CONFIG_TCP_OOO_SEGS; i++) {
+		if (!ooo[i].len) {
+			if (!free_slot)
+				free_slot = &ooo[i];
+		} else if (ooo[i].seq == seq) {
+			return;		/* already have it */
+		}
+	}
+	if (!free_slot || !len || len > TCP_MSS)
+		return;
+
+	free_slot->seq = seq;
+	free_slot->len = len;
+	free_slot->fin = fin;
+	memcpy(free_slot->data, data, len);
+	ooo_count++;
+}
+
+/*
+ * Walk the queued segments that continue the stream at @pos. Without
+ * @deliver, only return the sequence number right after them; with it,
+ * hand them to the user and free them. *@fin is set if the stream ends.
+ */
+static u32 tcp_ooo_walk(u32 pos, int deliver, int *fin)
+{
+	struct tcp_ooo *seg;
+	unsigned skip;
+	int i, found;
+
+	do {
+		found = 0;
+		for (i = 0; i < CONFIG_TCP_OOO_SEGS && !*fin; i++) {
+			seg = &ooo[i];
+			if (!seg->len || SEQ_GT(seg->seq, pos))
+				continue;
+			if (SEQ_GT(seg->seq + seg->len, pos)) {
+				skip = pos - seg->seq;
+				if (deliver && tcp_state != TCP_CLOSED &&
+				    tcp_rx_handler(seg->data + skip,
+						   seg->len - skip))
+					tcp_abort();
+				pos = seg->seq + seg->len;
+				*fin = seg->fin;
+				found = 1;
+			}
+			if (deliver) {
+				seg->len = 0;
+				ooo_count--;
+			}
+		}
+	} while (found);
+
+	return pos;
+}
+
+static void tcp_process_data(u32 seq, const uchar *data, unsigned len,
+			     int fin)
+{
+	u32 skip, end;
+	int peer_fin = fin;
+	int ooo_fin = 0;
+
+	/* Trim what we have already seen */
+	if (SEQ_LT(seq, rcv_nxt)) {
+		skip = rcv_nxt - seq;
+		if (skip >= len + fin) {
+			/* A retransmission, our ACK may have been lost */
+			tcp_send_ack();
+			return;
+		}
+		data += skip;
+		len -= skip;
+		seq = rcv_nxt;
+	}
+
+	if (seq != rcv_nxt) {
+		/* Ahead of a hole: keep it, and tell the peer right away */
+		tcp_ooo_add(seq, data, len, fin);
+		tcp_send_ack();
+		return;
+	}
+
+	/*
+	 * Acknowledge before handing the data over, so the peer keeps
+	 * sending while the user deals with it (e.g. writes to storage).
+	 */
+	end = seq + len;
+	rcv_nxt = end;
+	if (ooo_count && !peer_fin)
+		rcv_nxt = tcp_ooo_walk(rcv_nxt, 0, &peer_fin);
+	if (peer_fin)
+		rcv_nxt++;
+
+	if (ooo_count || peer_fin || ++ack_pending >= 2) {
+		tcp_send_ack();
+	} else if (ack_pending == 1) {
+		ack_start = get_timer(0);
+	}
+
+	if (len && tcp_rx_handler(data, len)) {
+		tcp_abort();
+		return;
+	}
+	if (ooo_count && !fin)
+		tcp_ooo_walk(end, 1, &ooo_fin);
+	if (peer_fin && tcp_state == TCP_ESTABLISHED) {
+		tcp_state = TCP_CLOSE_WAIT;
+		tcp_event_handler(TCP_EV_CLOSED);
+	}
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len, IPaddr_t src_ip)
+{
+	unsigned hlen, dlen;
+	u32 seq, ack;
+	int flags;
+	uchar *data;
+
+	if (tcp_state == TCP_CLOSED || len < IP_TCP_HDR_SIZE)
+		return;
+	if (src_ip != tcp_remote_ip ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    ntohs(ip->tcp_dst) != tcp_local_port)
+		return;
+
+	hlen = (ip->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || IP_HDR_SIZE + hlen > len)
+		return;
+	if (!(net_rx_csum & NET_RX_CSUM_L4) &&
+	    net_cksum_pseudo((struct ip_hdr *)ip, IPPROTO_TCP,
+			     len - IP_HDR_SIZE) != 0xffff) {
+		debug("TCP checksum bad\n");
+		return;
+	}
+
+	seq = get_unaligned_be32(ip->tcp_seq);
+	ack = get_unaligned_be32(ip->tcp_ack);
+	flags = ip->tcp_flags;
+	data = (uchar *)ip + IP_HDR_SIZE + hlen;
+	dlen = len - IP_HDR_SIZE - hlen;
+	last_rx = get_timer(0);
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != snd_nxt)
+			return;
+		if (flags & TCP_RST) {
+			tcp_closed(TCP_EV_ABORTED);
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+
+		tcp_parse_options((uchar *)ip + IP_TCP_HDR_SIZE,
+				  hlen - TCP_HDR_SIZE);
+		snd_una = ack;
+		rcv_nxt = seq + 1;
+		retries = 0;
+		rto = TCP_RTO_INIT;
+		tcp_state = TCP_ESTABLISHED;
+		tcp_send_ack();
+		tcp_event_handler(TCP_EV_CONNECTED);
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset that is inside the window */
+		if (SEQ_LE(rcv_nxt, seq) &&
+		    SEQ_LT(seq, rcv_nxt + CONFIG_TCP_WINDOW))
+			tcp_closed(TCP_EV_ABORTED);
+		return;
+	}
+
+	if (flags & TCP_ACK)
+		tcp_process_ack(ack, flags, dlen);
+
+	if ((dlen || (flags & TCP_FIN)) && tcp_state == TCP_ESTABLISHED)
+		tcp_process_data(seq, data, dlen, flags & TCP_FIN);
+}
@@ -0,0 +1,59 @@
+/*
+ * Minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/* Largest segment on a 1500 byte MTU link */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/* Connection events reported to the user of the connection */
+enum tcp_event {
+	TCP_EV_CONNECTED,	/* handshake done, tcp_send() can be used */
+	TCP_EV_CLOSED,		/* peer closed after sending all its data */
+	TCP_EV_ABORTED,		/* reset by the peer or timed out */
+};
+
+typedef void tcp_event_f(enum tcp_event ev);
+
+/*
+ * Called with the received data, in order. Returning non-zero resets
+ * the connection.
+ */
+typedef int tcp_rx_f(const uchar *data, unsigned len);
+
+/**
+ * tcp_start() - open a connection
+ *
+ * There is a single connection, which takes over the NetLoop timeout
+ * handler until it is closed.
+ *
+ * @param dest - server IP address
+ * @param dport - server port
+ * @param event - called on connection events
+ * @param rx - called with received data
+ */
+void tcp_start(IPaddr_t dest, int dport, tcp_event_f *event, tcp_rx_f *rx);
+
+/**
+ * tcp_send() - queue data for sending
+ *
+ * @param data - data to send
+ * @param len - length of the data, at most TCP_MSS bytes can be in flight
+ * @return 0 on success, -1 if not connected or the data does not fit
+ */
+int tcp_send(const uchar *data, unsigned len);
+
+/* Send a FIN and forget about the connection */
+void tcp_close(void);
+
+/* Send a RST and forget about the connection */
+void tcp_abort(void);
+
+/* Process a received TCP packet (called from NetReceive) */
+void tcp_receive(struct ip_tcp_hdr *ip, int len, IPaddr_t src_ip);
+
+#endif /* __TCP_H__ */
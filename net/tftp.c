@@ -8,12 +8,16 @@
 
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <net.h>
 #include "tftp.h"
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 #include <flash.h>
 #endif
+#ifdef CONFIG_NET_SINK
+#include <net_sink.h>
+#endif
 
 /* Well known TFTP port # */
 #define WELL_KNOWN_PORT	69
@@ -130,17 +134,60 @@ static char tftp_filename[MAX_LEN];
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 lets the server send a whole window of blocks before waiting
+ * for an ACK, instead of running lock-step. Only the last block of each
+ * window is ACKed; a gap makes us ACK the last block received in order,
+ * which is where the server restarts the window from.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+/* blocks received since the last ACK */
+static unsigned short TftpWindowCount;
+/* set once the last in-order block has been re-ACKed after a gap */
+static int TftpWindowReAcked;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
-static unsigned *Bitmap;
-static int PrevBitmapHole, Mapsize = MTFTP_BITMAPSIZE;
+/*
+ * With a netsink, blocks ahead of the first missing one wait in a ring of
+ * this size at load_addr, since the sink takes its data in order. Blocks
+ * that do not fit are dropped and repaired later.
+ */
+#ifndef CONFIG_MCAST_TFTP_STAGE_SIZE
+#define CONFIG_MCAST_TFTP_STAGE_SIZE	(32 << 20)
+#endif
+/* One bit per block, bit n is block n + 1 */
+static uchar *Bitmap;
+static ulong MapBits;
+/* First block we do not have, the same as the number of blocks in order */
+static ulong PrevBitmapHole;
 static uchar ProhibitMcast, MasterClient;
 static uchar Multicast;
 static int Mcast_port;
-static ulong TftpEndingBlock; /* can get 'last' block before done..*/
+static int TftpServerPort;		/* where to send an RRQ to rejoin */
+static ulong TftpEndingBlock;		/* last block, 0 if not seen yet */
+static unsigned McastLastLen;		/* length of the last block */
+static ulong McastBlocks;		/* blocks in the file, 0 if unknown */
+static ulong McastRef;			/* recent block, to undo wraps */
+static ulong McastMaxBlock;		/* highest block received */
+static ulong McastReceived;		/* blocks received */
+static ulong McastMissed;		/* of those, filled into a gap */
+static ulong McastDups;			/* blocks received twice */
+#ifdef CONFIG_NET_SINK
+static ulong McastSunk;			/* blocks handed to the sink */
+static ulong McastStageBlocks;		/* blocks in the staging ring */
+#endif
 
 static void parse_multicast_oack(char *pkt, int len);
+static void mcast_report(void);
 
 static void
 mcast_cleanup(void)
@@ -151,7 +198,7 @@ mcast_cleanup(void)
 		free(Bitmap);
 	Bitmap = NULL;
 	Mcast_addr = Multicast = Mcast_port = 0;
-	TftpEndingBlock = -1;
+	TftpEndingBlock = 0;
 }
 
 #endif	/* CONFIG_MCAST_TFTP */
@@ -183,13 +230,17 @@ store_block(int block, uchar *src, unsigned len)
 		}
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		if (net_sink_store(offset, src, len)) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+	} else
+#endif
 	{
 		(void)memcpy((void *)(load_addr + offset), src, len);
 	}
-#ifdef CONFIG_MCAST_TFTP
-	if (Multicast)
-		ext2_set_bit(block, Bitmap);
-#endif
 
 	if (NetBootFileXferSize < newsize)
 		NetBootFileXferSize = newsize;
@@ -201,6 +252,8 @@ static void new_transfer(void)
 	TftpLastBlock = 0;
 	TftpBlockWrap = 0;
 	TftpBlockWrapOffset = 0;
+	TftpWindowCount = 0;
+	TftpWindowReAcked = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	TftpFinalBlock = 0;
 #endif
@@ -236,9 +289,16 @@ static void TftpTimeout(void);
 
 static void show_block_marker(void)
 {
+	ulong block = TftpBlock;
+
+#ifdef CONFIG_MCAST_TFTP
+	/* Blocks come in any order, count the ones we have */
+	if (Multicast)
+		block = McastReceived;
+#endif
 #ifdef CONFIG_TFTP_TSIZE
 	if (TftpTsize) {
-		ulong pos = TftpBlock * TftpBlkSize + TftpBlockWrapOffset;
+		ulong pos = block * TftpBlkSize + TftpBlockWrapOffset;
 
 		while (TftpNumchars < pos * 50 / TftpTsize) {
 			putc('#');
@@ -247,9 +307,9 @@ static void show_block_marker(void)
 	} else
 #endif
 	{
-		if (((TftpBlock - 1) % 10) == 0)
+		if (((block - 1) % 10) == 0)
 			putc('#');
-		else if ((TftpBlock % (10 * HASHES_PER_LINE)) == 0)
+		else if ((block % (10 * HASHES_PER_LINE)) == 0)
 			puts("\n\t ");
 	}
 }
@@ -301,17 +361,209 @@ static void tftp_complete(void)
 	}
 	puts("  ");
 	print_size(TftpTsize, "");
+#endif
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		putc('\n');
+		if (net_sink_finish()) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+	}
 #endif
 	time_start = get_timer(time_start);
 	if (time_start > 0) {
 		puts("\n\t ");	/* Line up with "Loading: " */
-		print_size(NetBootFileXferSize /
-			time_start * 1000, "/s");
+		print_size(lldiv((unsigned long long)NetBootFileXferSize *
+				 1000, time_start), "/s");
+		printf(" (%lu ms", time_start);
+		if (TftpWindowSize > 1)
+			printf(", window %d", TftpWindowSize);
+		putc(')');
 	}
+#ifdef CONFIG_MCAST_TFTP
+	if (Multicast)
+		mcast_report();
+#endif
 	puts("\ndone\n");
 	net_set_state(NETLOOP_SUCCESS);
 }
 
+#ifdef CONFIG_MCAST_TFTP
+/*
+ * Turn a 16 bit block number into the block it stands for. The counter
+ * wraps on files of more than 65535 blocks, where we go for the wrap that
+ * is closest to a block we have seen. Returns 0 if it cannot be placed.
+ */
+static ulong mcast_block(ushort block)
+{
+	long nr;
+
+	if (McastBlocks && McastBlocks < TFTP_SEQUENCE_SIZE)
+		return block;
+	/*
+	 * Unless the file is known to fit in one wrap, a block could be from
+	 * any of them. Wait for a hint: our first ACK as master client.
+	 */
+	if (!McastRef)
+		return 0;
+
+	nr = (long)McastRef + (short)(block - (ushort)McastRef);
+
+	return nr > 0 ? nr : 0;
+}
+
+static int mcast_grow(ulong bits)
+{
+	ulong newbits = max(MapBits * 2, roundup(bits, 8));
+	uchar *map;
+
+	map = realloc(Bitmap, newbits / 8);
+	if (!map) {
+		puts("\nMulticast: no memory for the block bitmap\n");
+		return -1;
+	}
+	memset(map + MapBits / 8, 0, (newbits - MapBits) / 8);
+	Bitmap = map;
+	MapBits = newbits;
+
+	return 0;
+}
+
+/* Move PrevBitmapHole up to the first block we do not have */
+static void mcast_find_hole(void)
+{
+	ulong i = PrevBitmapHole;
+
+	while (i < MapBits) {
+		if (!(i & 7) && Bitmap[i / 8] == 0xff)
+			i += 8;
+		else if (ext2_test_bit(i, Bitmap))
+			i++;
+		else
+			break;
+	}
+	PrevBitmapHole = i;
+}
+
+#ifdef CONFIG_NET_SINK
+/* Hand the blocks that are now in order from the ring to the sink */
+static int mcast_sink_feed(void)
+{
+	ulong slot, len;
+
+	while (McastSunk < PrevBitmapHole) {
+		slot = McastSunk % McastStageBlocks;
+		len = McastSunk + 1 == TftpEndingBlock ? McastLastLen :
+							 TftpBlkSize;
+		if (net_sink_store(McastSunk * TftpBlkSize,
+				   (uchar *)(load_addr + slot * TftpBlkSize),
+				   len))
+			return -1;
+		McastSunk++;
+	}
+
+	return net_sink_sync();
+}
+#endif
+
+static int mcast_store(ulong block, uchar *src, unsigned len)
+{
+	ulong idx = block - 1;
+
+	if (idx >= MapBits && mcast_grow(idx + 1))
+		return -1;
+	if (ext2_test_bit(idx, Bitmap)) {
+		McastDups++;
+		return 0;
+	}
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		ulong slot = idx % McastStageBlocks;
+
+		/* No room in the ring yet, it gets repaired later */
+		if (idx >= McastSunk + McastStageBlocks)
+			return 0;
+		memcpy((void *)(load_addr + slot * TftpBlkSize), src, len);
+		if (NetBootFileXferSize < idx * TftpBlkSize + len)
+			NetBootFileXferSize = idx * TftpBlkSize + len;
+	} else
+#endif
+	{
+		store_block(idx, src, len);
+	}
+	ext2_set_bit(idx, Bitmap);
+
+	/* Anything below the highest block so far fills a gap */
+	if (block < McastMaxBlock)
+		McastMissed++;
+	else
+		McastMaxBlock = block;
+	McastRef = block;
+	McastReceived++;
+	show_block_marker();
+	mcast_find_hole();
+
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active())
+		return mcast_sink_feed();
+#endif
+	return 0;
+}
+
+static void mcast_report(void)
+{
+	ulong permille = 0;
+
+	if (McastReceived)
+		permille = lldiv((u64)McastMissed * 1000, McastReceived);
+	printf("\n\t Multicast (%s): %lu blocks, %lu missed (%lu.%lu%%), "
+	       "%lu duplicates", MasterClient ? "master" : "passive",
+	       McastReceived, McastMissed, permille / 10, permille % 10,
+	       McastDups);
+}
+
+/*
+ * A block arrived on the group (or directly, while we are the master
+ * client). The master ACKs the first block it misses after each one, so
+ * the server repairs its gaps before going on; everyone else listens.
+ */
+static void mcast_data(uchar *pkt, unsigned len, unsigned src)
+{
+	ulong block = mcast_block(TftpBlock);
+
+	/* Anything from the session means it is alive */
+	TftpTimeoutCount = 0;
+	TftpTimeoutCountMax = TIMEOUT_COUNT;
+	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
+	if (TftpState != STATE_DATA) {
+		/* First block, or the session went on while we rejoined */
+		TftpState = STATE_DATA;
+		TftpRemotePort = src;
+	}
+
+	if (!block || (TftpEndingBlock && block > TftpEndingBlock))
+		return;
+	if (len < TftpBlkSize) {
+		TftpEndingBlock = block;
+		McastLastLen = len;
+	}
+	if (mcast_store(block, pkt, len)) {
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	if (TftpEndingBlock && PrevBitmapHole >= TftpEndingBlock) {
+		/* The final ACK also tells the server a passive client is done */
+		TftpSend();
+		tftp_complete();
+		mcast_cleanup();
+	} else if (MasterClient) {
+		TftpSend();
+	}
+}
+#endif /* CONFIG_MCAST_TFTP */
+
 static void
 TftpSend(void)
 {
@@ -321,10 +573,14 @@ TftpSend(void)
 	ushort *s;
 
 #ifdef CONFIG_MCAST_TFTP
-	/* Multicast TFTP.. non-MasterClients do not ACK data. */
+	/*
+	 * Multicast TFTP.. non-MasterClients do not ACK data, until they
+	 * have all of it.
+	 */
 	if (Multicast
 	 && (TftpState == STATE_DATA)
-	 && (MasterClient == 0))
+	 && (MasterClient == 0)
+	 && (!TftpEndingBlock || PrevBitmapHole < TftpEndingBlock))
 		return;
 #endif
 	/*
@@ -361,32 +617,31 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		/* and for more than one block in flight */
+		if (TftpState == STATE_SEND_RRQ && TftpWindowSizeOption > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
-		if (!ProhibitMcast) {
-			Bitmap = malloc(Mapsize);
-			if (Bitmap && eth_get_dev()->mcast) {
-				free(Bitmap);
-				Bitmap = NULL;
-				pkt += sprintf((char *)pkt, "multicast%c%c",
-					0, 0);
-			}
-		}
+		if (!ProhibitMcast && eth_get_dev()->mcast)
+			pkt += sprintf((char *)pkt, "multicast%c%c", 0, 0);
 #endif /* CONFIG_MCAST_TFTP */
 		len = pkt - xp;
 		break;
 
 	case STATE_OACK:
-#ifdef CONFIG_MCAST_TFTP
-		/* My turn!  Start at where I need blocks I missed.*/
-		if (Multicast)
-			TftpBlock = ext2_find_next_zero_bit(Bitmap,
-							    (Mapsize*8), 0);
-		/*..falling..*/
-#endif
-
 	case STATE_RECV_WRQ:
 	case STATE_DATA:
+#ifdef CONFIG_MCAST_TFTP
+		/*
+		 * ACK the blocks we have in order, so the server goes on
+		 * with the first one we miss.
+		 */
+		if (Multicast) {
+			TftpBlock = PrevBitmapHole & 0xffff;
+			McastRef = PrevBitmapHole + 1;
+		}
+#endif
 		xp = pkt;
 		s = (ushort *)pkt;
 		s[0] = htons(TFTP_ACK);
@@ -530,6 +785,16 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				debug("Blocksize ack: %s, %d\n",
 					(char *)pkt+i+8, TftpBlkSize);
 			}
+			if (i + 11 < len &&
+			    strcmp((char *)pkt+i, "windowsize") == 0) {
+				TftpWindowSize = (unsigned short)
+					simple_strtoul((char *)pkt+i+11, NULL,
+						       10);
+				if (TftpWindowSize < 1)
+					TftpWindowSize = 1;
+				debug("Windowsize ack: %s, %d\n",
+					(char *)pkt+i+11, TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				TftpTsize = simple_strtoul((char *)pkt+i+6,
@@ -541,6 +806,9 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len-1);
+		/* Multicast tracks blocks in its bitmap, ACK each one */
+		if (Multicast)
+			TftpWindowSize = 1;
 		if ((Multicast) && (!MasterClient))
 			TftpState = STATE_DATA;	/* passive.. */
 		else
@@ -560,7 +828,12 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		len -= 2;
 		TftpBlock = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
+#ifdef CONFIG_MCAST_TFTP
+		if (Multicast) {
+			mcast_data(pkt + 2, len, src);
+			break;
+		}
+#endif
 
 		if (TftpState == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
@@ -572,11 +845,6 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			TftpRemotePort = src;
 			new_transfer();
 
-#ifdef CONFIG_MCAST_TFTP
-			if (Multicast) { /* start!=1 common if mcast */
-				TftpLastBlock = TftpBlock - 1;
-			} else
-#endif
 			if (TftpBlock != 1) {	/* Assertion */
 				printf("\nTFTP error: "
 				       "First block is not block 1 (%ld)\n"
@@ -594,52 +862,51 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			break;
 		}
 
+		if (TftpBlock != ((TftpLastBlock + 1) & 0xffff)) {
+			/*
+			 *	A block of the window was lost or reordered.
+			 *	Drop everything up to the next expected one and
+			 *	ACK the last block we have, once, so that the
+			 *	server resends the window from there.
+			 */
+			debug("TFTP: got block %lu, expected %lu\n",
+			      TftpBlock, (TftpLastBlock + 1) & 0xffff);
+			TftpBlock = TftpLastBlock;
+			if (!TftpWindowReAcked) {
+				TftpWindowReAcked = 1;
+				TftpWindowCount = 0;
+				TftpSend();
+			}
+			break;
+		}
+
+		update_block_number();
+
 		TftpLastBlock = TftpBlock;
+		TftpWindowReAcked = 0;
 		TftpTimeoutCountMax = TIMEOUT_COUNT;
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
 		store_block(TftpBlock - 1, pkt + 2, len);
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
-		 */
-#ifdef CONFIG_MCAST_TFTP
-		/* if I am the MasterClient, actively calculate what my next
-		 * needed block is; else I'm passive; not ACKING
+		 *	Acknowledge the last block of each window, and the last
+		 *	block of the file, which will prompt the remote for the
+		 *	next window.
 		 */
-		if (Multicast) {
-			if (len < TftpBlkSize)  {
-				TftpEndingBlock = TftpBlock;
-			} else if (MasterClient) {
-				TftpBlock = PrevBitmapHole =
-					ext2_find_next_zero_bit(
-						Bitmap,
-						(Mapsize*8),
-						PrevBitmapHole);
-				if (TftpBlock > ((Mapsize*8) - 1)) {
-					printf("tftpfile too big\n");
-					/* try to double it and retry */
-					Mapsize <<= 1;
-					mcast_cleanup();
-					NetStartAgain();
-					return;
-				}
-				TftpLastBlock = TftpBlock;
-			}
+		if (++TftpWindowCount >= TftpWindowSize || len < TftpBlkSize) {
+			TftpWindowCount = 0;
+			TftpSend();
+		}
+#ifdef CONFIG_NET_SINK
+		/* Write out full chunks while the next blocks come in */
+		if (net_sink_active() && len == TftpBlkSize &&
+		    net_sink_sync()) {
+			net_set_state(NETLOOP_FAIL);
+			break;
 		}
 #endif
-		TftpSend();
 
-#ifdef CONFIG_MCAST_TFTP
-		if (Multicast) {
-			if (MasterClient && (TftpBlock >= TftpEndingBlock)) {
-				puts("\nMulticast tftp done\n");
-				mcast_cleanup();
-				net_set_state(NETLOOP_SUCCESS);
-			}
-		} else
-#endif
 		if (len < TftpBlkSize)
 			tftp_complete();
 		break;
@@ -681,6 +948,17 @@ TftpTimeout(void)
 	} else {
 		puts("T ");
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
+#ifdef CONFIG_MCAST_TFTP
+		/*
+		 * A passive client hears nothing once the server lost track
+		 * of it. Ask to join the session again, which keeps the
+		 * blocks we already have.
+		 */
+		if (Multicast && !MasterClient && TftpState == STATE_DATA) {
+			TftpState = STATE_SEND_RRQ;
+			TftpRemotePort = TftpServerPort;
+		}
+#endif
 		if (TftpState != STATE_RECV_WRQ)
 			TftpSend();
 	}
@@ -703,6 +981,10 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+
 	if (TftpTimeoutMSecs < 1000) {
 		printf("TFTP timeout (%ld ms) too low, "
 			"set minimum = 1000 ms\n",
@@ -710,8 +992,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -779,6 +1061,9 @@ void TftpStart(enum proto_t protocol)
 	} else
 #endif
 	{
+#ifdef CONFIG_NET_SINK
+		net_sink_start();
+#endif
 		printf("Load address: 0x%lx\n", load_addr);
 		puts("Loading: *\b");
 		TftpState = STATE_SEND_RRQ;
@@ -804,13 +1089,17 @@ void TftpStart(enum proto_t protocol)
 	ep = getenv("tftpsrcp");
 	if (ep != NULL)
 		TftpOurPort = simple_strtol(ep, NULL, 10);
+#endif
+#ifdef CONFIG_MCAST_TFTP
+	TftpServerPort = TftpRemotePort;
 #endif
 	TftpBlock = 0;
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -839,8 +1128,9 @@ TftpStartServer(void)
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
 	TftpOurPort = WELL_KNOWN_PORT;
 
@@ -910,24 +1200,37 @@ static void parse_multicast_oack(char *pkt, int len)
 	}
 	/* ..I now accept packets destined for this MCAST addr, port */
 	if (!Multicast) {
-		if (Bitmap) {
-			printf("Internal failure! no mcast.\n");
-			free(Bitmap);
-			Bitmap = NULL;
-			ProhibitMcast = 1;
-			return ;
-		}
-		/* I malloc instead of pre-declare; so that if the file ends
-		 * up being too big for this bitmap I can retry
+		/* I malloc instead of pre-declare; so that the bitmap can be
+		 * sized for the file, or grown if we do not know its size
 		 */
-		Bitmap = malloc(Mapsize);
+		McastBlocks = 0;
+		MapBits = MTFTP_BITMAPSIZE * 8;
+#ifdef CONFIG_TFTP_TSIZE
+		if (TftpTsize > 0) {
+			McastBlocks = TftpTsize / TftpBlkSize + 1;
+			MapBits = roundup(McastBlocks, 8);
+		}
+#endif
+		Bitmap = malloc(MapBits / 8);
 		if (!Bitmap) {
 			printf("No Bitmap, no multicast. Sorry.\n");
 			ProhibitMcast = 1;
 			return;
 		}
-		memset(Bitmap, 0, Mapsize);
+		memset(Bitmap, 0, MapBits / 8);
 		PrevBitmapHole = 0;
+		TftpEndingBlock = 0;
+		McastRef = 0;
+		McastMaxBlock = 0;
+		McastReceived = 0;
+		McastMissed = 0;
+		McastDups = 0;
+#ifdef CONFIG_NET_SINK
+		McastSunk = 0;
+		McastStageBlocks = max(CONFIG_MCAST_TFTP_STAGE_SIZE /
+				       TftpBlkSize, 1);
+#endif
+		new_transfer();
 		Multicast = 1;
 	}
 	addr = string_to_ip(mc_adr);
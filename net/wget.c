@@ -0,0 +1,272 @@
+/*
+ * HTTP/1.1 download over the minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <div64.h>
+#include <net.h>
+#include "tcp.h"
+#include "wget.h"
+#ifdef CONFIG_NET_SINK
+#include <net_sink.h>
+#endif
+
+/* Largest response header we accept */
+#define WGET_HDR_MAX	2048
+
+/* One hash mark per this many bytes */
+#define WGET_HASH_BYTES	(64 * 1024)
+
+static IPaddr_t wget_server;
+static int wget_port;
+static char *wget_path;
+
+static char wget_hdr[WGET_HDR_MAX + 1];
+static unsigned wget_hdr_len;
+static int wget_in_body;
+static int wget_have_len;
+static ulong wget_content_len;
+static ulong wget_received;
+static ulong wget_next_mark;
+static int wget_marks;
+static ulong time_start;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget: %s\n", msg);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_done(void)
+{
+	ulong ms;
+
+	tcp_close();
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		putc('\n');
+		if (net_sink_finish()) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+	}
+#endif
+	ms = get_timer(time_start);
+	if (ms > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(lldiv((unsigned long long)wget_received * 1000, ms),
+			   "/s");
+		printf(" (%lu ms)", ms);
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_send_request(void)
+{
+	char req[64 + sizeof(BootFile) + 32];
+	int len;
+
+	len = sprintf(req, "GET %s HTTP/1.1\r\nHost: %pI4", wget_path,
+		      &wget_server);
+	if (wget_port != HTTP_PORT)
+		len += sprintf(req + len, ":%d", wget_port);
+	len += sprintf(req + len, "\r\nUser-Agent: U-Boot\r\n"
+		       "Connection: close\r\n\r\n");
+
+	if (tcp_send((uchar *)req, len)) {
+		wget_fail("request too long");
+		tcp_abort();
+	}
+}
+
+static int wget_parse_header(char *hdr)
+{
+	char *line, *next, *p;
+	int status;
+
+	next = strchr(hdr, '\n');
+	if (next)
+		*next++ = '\0';
+	p = strchr(hdr, '\r');
+	if (p)
+		*p = '\0';
+
+	p = strchr(hdr, ' ');
+	if (strncmp(hdr, "HTTP/1.", 7) || !p) {
+		wget_fail("bad HTTP response");
+		return -1;
+	}
+	status = simple_strtoul(p + 1, NULL, 10);
+	if (status != 200) {
+		printf("\nwget: server replied '%s'\n", hdr);
+		net_set_state(NETLOOP_FAIL);
+		return -1;
+	}
+
+	for (line = next; line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		for (p++; *p == ' ' || *p == '\t'; p++)
+			;
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			wget_content_len = simple_strtoul(p, NULL, 10);
+			wget_have_len = 1;
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18) &&
+			   strncasecmp(p, "identity", 8)) {
+			wget_fail("transfer encoding not supported");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int wget_store(const uchar *data, unsigned len)
+{
+	if (wget_have_len && len > wget_content_len - wget_received)
+		len = wget_content_len - wget_received;
+
+#ifdef CONFIG_NET_SINK
+	if (net_sink_active()) {
+		if (net_sink_store(wget_received, data, len) ||
+		    net_sink_sync()) {
+			net_set_state(NETLOOP_FAIL);
+			return -1;
+		}
+	} else
+#endif
+	{
+		(void)memcpy((void *)(load_addr + wget_received), data, len);
+	}
+	wget_received += len;
+	NetBootFileXferSize = wget_received;
+
+	while (wget_received >= wget_next_mark) {
+		putc('#');
+		if (++wget_marks % 65 == 0)
+			puts("\n\t ");
+		wget_next_mark += WGET_HASH_BYTES;
+	}
+
+	if (wget_have_len && wget_received == wget_content_len)
+		wget_done();
+
+	return 0;
+}
+
+static int wget_rx(const uchar *data, unsigned len)
+{
+	unsigned n, body;
+	char *end;
+
+	if (!wget_in_body) {
+		n = min(len, WGET_HDR_MAX - wget_hdr_len);
+		memcpy(wget_hdr + wget_hdr_len, data, n);
+		wget_hdr[wget_hdr_len + n] = '\0';
+
+		end = strstr(wget_hdr, "\r\n\r\n");
+		if (!end) {
+			wget_hdr_len += n;
+			if (wget_hdr_len < WGET_HDR_MAX)
+				return 0;
+			wget_fail("response header too long");
+			return -1;
+		}
+
+		/* Whatever follows the header is body */
+		body = end + 4 - wget_hdr - wget_hdr_len;
+		*end = '\0';
+		if (wget_parse_header(wget_hdr))
+			return -1;
+		wget_in_body = 1;
+		data += body;
+		len -= body;
+
+		if (wget_have_len && !wget_content_len) {
+			wget_done();
+			return 0;
+		}
+	}
+
+	return len ? wget_store(data, len) : 0;
+}
+
+static void wget_event(enum tcp_event ev)
+{
+	switch (ev) {
+	case TCP_EV_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_EV_CLOSED:
+		/* Without a length, the end of the connection ends the file */
+		if (!wget_in_body) {
+			wget_fail("connection closed before the response");
+		} else if (wget_have_len) {
+			printf("\nwget: connection closed after %lu of %lu bytes\n",
+			       wget_received, wget_content_len);
+			net_set_state(NETLOOP_FAIL);
+		} else {
+			wget_done();
+			return;
+		}
+		tcp_close();
+		break;
+	case TCP_EV_ABORTED:
+		wget_fail("connection refused, reset or timed out");
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	char *p;
+
+	wget_server = NetServerIP;
+	wget_path = BootFile;
+	p = strchr(BootFile, ':');
+	if (p && (!strchr(BootFile, '/') || p < strchr(BootFile, '/'))) {
+		wget_server = string_to_ip(BootFile);
+		wget_path = p + 1;
+	}
+	wget_port = getenv_ulong("httpdstp", 10, HTTP_PORT);
+
+	if (wget_path[0] != '/') {
+		puts("*** ERROR: no absolute path to download given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	if (!wget_server) {
+		puts("*** ERROR: `serverip' not set\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server, &NetOurIP);
+	printf("Filename '%s'.\n", wget_path);
+#ifdef CONFIG_NET_SINK
+	net_sink_start();
+#endif
+	printf("Load address: 0x%lx\nLoading: *\b", load_addr);
+
+	wget_hdr_len = 0;
+	wget_in_body = 0;
+	wget_have_len = 0;
+	wget_content_len = 0;
+	wget_received = 0;
+	wget_next_mark = WGET_HASH_BYTES;
+	wget_marks = 0;
+	time_start = get_timer(0);
+
+	tcp_start(wget_server, wget_port, wget_event, wget_rx);
+}
@@ -0,0 +1,14 @@
+/*
+ * HTTP download over the minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+#define HTTP_PORT	80
+
+extern void wget_start(void);	/* Begin HTTP download */
+
+#endif /* __WGET_H__ */
@@ -108,6 +108,76 @@ static int do_dm_dump_uclass(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#ifdef CONFIG_DM_PROBE_TIMES
+/* Count the devices under 'dev', adding those probed to 'list' if not NULL */
+static void dm_find_probed(struct udevice *dev, struct udevice **list,
+			   int *probed, int *total)
+{
+	struct udevice *child;
+
+	if (device_active(dev)) {
+		if (list)
+			list[*probed] = dev;
+		(*probed)++;
+	}
+	(*total)++;
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		dm_find_probed(child, list, probed, total);
+}
+
+static int h_cmp_probe_us(const void *v1, const void *v2)
+{
+	const struct udevice *dev1 = *(struct udevice * const *)v1;
+	const struct udevice *dev2 = *(struct udevice * const *)v2;
+
+	if (dev1->probe_us == dev2->probe_us)
+		return 0;
+
+	return dev1->probe_us < dev2->probe_us ? 1 : -1;
+}
+
+static int do_dm_probe_times(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	struct udevice **list, *root;
+	char class_name[12];
+	int probed, total;
+	ulong sum = 0;
+	int i;
+
+	root = dm_root();
+	if (!root)
+		return 0;
+
+	probed = total = 0;
+	dm_find_probed(root, NULL, &probed, &total);
+	list = calloc(probed, sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+	probed = total = 0;
+	dm_find_probed(root, list, &probed, &total);
+	qsort(list, probed, sizeof(*list), h_cmp_probe_us);
+
+	printf(" Time (us)  Class       Name\n");
+	printf("----------------------------------------\n");
+	for (i = 0; i < probed; i++) {
+		strlcpy(class_name, list[i]->uclass->uc_drv->name,
+			sizeof(class_name));
+		printf("%10lu  %-11s %s\n", list[i]->probe_us, class_name,
+		       list[i]->name);
+		sum += list[i]->probe_us;
+	}
+	printf("%10lu  total, %d of %d devices probed\n", sum, probed, total);
+	free(list);
+
+	return 0;
+}
+#define PROBE_TIMES_HELP "\ndm probe-times   Show the time taken to probe each device"
+#else
+#define PROBE_TIMES_HELP
+#endif
+
 #ifdef CONFIG_DM_TEST
 static int do_dm_test(cmd_tbl_t *cmdtp, int flag, int argc,
 			  char * const argv[])
@@ -122,6 +192,9 @@ static int do_dm_test(cmd_tbl_t *cmdtp, int flag, int argc,
 static cmd_tbl_t test_commands[] = {
 	U_BOOT_CMD_MKENT(tree, 0, 1, do_dm_dump_all, "", ""),
 	U_BOOT_CMD_MKENT(uclass, 1, 1, do_dm_dump_uclass, "", ""),
+#ifdef CONFIG_DM_PROBE_TIMES
+	U_BOOT_CMD_MKENT(probe-times, 0, 1, do_dm_probe_times, "", ""),
+#endif
 #ifdef CONFIG_DM_TEST
 	U_BOOT_CMD_MKENT(test, 1, 1, do_dm_test, "", ""),
 #endif
@@ -151,5 +224,6 @@ U_BOOT_CMD(
 	"Driver model low level access",
 	"tree         Dump driver model tree ('*' = activated)\n"
 	"dm uclass        Dump list of instances for each uclass"
+	PROBE_TIMES_HELP
 	TEST_HELP
 );
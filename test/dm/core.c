@@ -7,6 +7,7 @@
  */
 
 #include <common.h>
+#include <command.h>
 #include <errno.h>
 #include <dm.h>
 #include <fdtdec.h>
@@ -568,6 +569,54 @@ static int dm_test_children(struct dm_test_state *dms)
 }
 DM_TEST(dm_test_children, 0);
 
+#ifdef CONFIG_DM_PROBE_TIMES
+#define PROBE_DELAY_US	2000
+
+/* Test that each device is charged only for its own probe */
+static int dm_test_probe_times(struct dm_test_state *dms)
+{
+	struct udevice *top[2], *child[2], *dev;
+	ulong start, elapsed;
+
+	dms->skip_post_probe = 1;
+	dms->probe_delay_us = PROBE_DELAY_US;
+	ut_assertok(create_children(dms, dms->root, 2, 0, top));
+	ut_assertok(create_children(dms, top[0], 2, 10, child));
+
+	/* Probing the child probes its parent first */
+	start = timer_get_us();
+	ut_assertok(device_probe(child[1]));
+	elapsed = timer_get_us() - start;
+	ut_assert(device_active(top[0]));
+	ut_assert(top[0]->probe_us >= PROBE_DELAY_US);
+	ut_assert(child[1]->probe_us >= PROBE_DELAY_US);
+	ut_assert(top[0]->probe_us + child[1]->probe_us <= elapsed);
+
+	/* Devices not asked for are never probed */
+	ut_assert(!device_active(top[1]));
+	ut_assert(!device_active(child[0]));
+	ut_assertok(uclass_find_device(UCLASS_TEST, 1, &dev));
+	ut_asserteq_ptr(top[1], dev);
+	ut_assert(!device_active(dev));
+
+	/* A probe done from within another is left out of its time */
+	dms->probe_nested = child[0];
+	start = timer_get_us();
+	ut_assertok(device_probe(top[1]));
+	elapsed = timer_get_us() - start;
+	ut_assert(device_active(child[0]));
+	ut_assert(top[1]->probe_us >= PROBE_DELAY_US);
+	ut_assert(child[0]->probe_us >= PROBE_DELAY_US);
+	ut_assert(top[1]->probe_us + child[0]->probe_us <= elapsed);
+
+	/* The command must list what was probed without failing */
+	ut_assertok(run_command("dm probe-times", 0));
+
+	return 0;
+}
+DM_TEST(dm_test_probe_times, 0);
+#endif
+
 /* Test that pre-relocation devices work as expected */
 static int dm_test_pre_reloc(struct dm_test_state *dms)
 {
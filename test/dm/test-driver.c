@@ -114,7 +114,15 @@ static int test_manual_bind(struct udevice *dev)
 
 static int test_manual_probe(struct udevice *dev)
 {
+	struct udevice *nested = dms->probe_nested;
+
 	dm_testdrv_op_count[DM_TEST_OP_PROBE]++;
+	if (dms->probe_delay_us)
+		udelay(dms->probe_delay_us);
+	if (nested) {
+		dms->probe_nested = NULL;
+		ut_assertok(device_probe(nested));
+	}
 	if (!dms->force_fail_alloc)
 		dev->priv = calloc(1, sizeof(struct dm_test_priv));
 	if (!dev->priv)
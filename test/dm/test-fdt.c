@@ -10,6 +10,7 @@
 #include <fdtdec.h>
 #include <malloc.h>
 #include <asm/io.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <dm/root.h>
 #include <dm/ut.h>
@@ -258,3 +259,37 @@ static int dm_test_fdt_offset(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that lookups stay correct as devices are removed and unbound */
+static int dm_test_fdt_uclass_index(struct dm_test_state *dms)
+{
+	struct udevice *dev;
+	int node;
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_TEST_FDT, 6, &dev));
+	ut_asserteq_str("e-test", dev->name);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 6, false, &dev));
+	ut_assertok(device_remove(dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST_FDT, 6,
+						       false, &dev));
+
+	/* Once unbound it cannot be found by requested seq or node */
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 6, true, &dev));
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST_FDT, 6,
+						       true, &dev));
+	node = fdt_path_offset(gd->fdt_blob, "/e-test");
+	ut_assert(node > 0);
+	ut_asserteq(-ENODEV, uclass_get_device_by_of_offset(UCLASS_TEST_FDT,
+							    node, &dev));
+
+	/* b-test and d-test both request 3, and b-test was bound first */
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 3, true, &dev));
+	ut_asserteq_str("b-test", dev->name);
+	ut_assertok(device_unbind(dev));
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 3, true, &dev));
+	ut_asserteq_str("d-test", dev->name);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_uclass_index, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
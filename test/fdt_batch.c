@@ -0,0 +1,296 @@
+/*
+ * Tests for batched device tree changes
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fdt_support.h>
+#include <libfdt.h>
+
+#define TEST_FDT_SIZE	4096
+
+static char base_fdt[TEST_FDT_SIZE];
+static char batch_fdt[TEST_FDT_SIZE];
+static char plain_fdt[TEST_FDT_SIZE];
+static char copy_fdt[TEST_FDT_SIZE];
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s (line %d)\n", #statement, __LINE__); \
+	ret = 1; \
+	goto out; \
+}
+
+/* Build a small packed tree with two memory reservations */
+static int make_base_fdt(void)
+{
+	void *fdt = base_fdt;
+	int err = 0;
+
+	err |= fdt_create(fdt, TEST_FDT_SIZE);
+	err |= fdt_add_reservemap_entry(fdt, 0x1000, 0x100);
+	err |= fdt_add_reservemap_entry(fdt, 0x2000, 0x200);
+	err |= fdt_finish_reservemap(fdt);
+	err |= fdt_begin_node(fdt, "");
+	err |= fdt_begin_node(fdt, "a");
+	err |= fdt_property_string(fdt, "x", "a fairly long string");
+	err |= fdt_property_u32(fdt, "y", 1);
+	err |= fdt_end_node(fdt);
+	err |= fdt_begin_node(fdt, "b");
+	err |= fdt_end_node(fdt);
+	err |= fdt_begin_node(fdt, "chosen");
+	err |= fdt_property_string(fdt, "bootargs", "old");
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= fdt_finish(fdt);
+
+	return err;
+}
+
+/* Returns true if a memory reservation is in a tree */
+static bool has_mem_rsv(const void *fdt, uint64_t address, uint64_t size)
+{
+	uint64_t addr, sz;
+	int i;
+
+	for (i = 0; i < fdt_num_mem_rsv(fdt); i++) {
+		fdt_get_mem_rsv(fdt, i, &addr, &sz);
+		if (addr == address && sz == size)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if two trees have the same nodes, properties and memory
+ * reservations. The order of properties in a node may differ.
+ */
+static bool same_fdt(const void *a, const void *b)
+{
+	const void *va, *vb;
+	const char *name;
+	int oa, ob, pa, pb, la, lb;
+	int count;
+	uint64_t addr, size;
+	int i;
+
+	if (fdt_check_header(a) || fdt_check_header(b))
+		return false;
+	if (fdt_num_mem_rsv(a) != fdt_num_mem_rsv(b))
+		return false;
+	for (i = 0; i < fdt_num_mem_rsv(a); i++) {
+		fdt_get_mem_rsv(a, i, &addr, &size);
+		if (!has_mem_rsv(b, addr, size))
+			return false;
+	}
+
+	for (oa = 0, ob = 0; oa >= 0 && ob >= 0;
+	     oa = fdt_next_node(a, oa, NULL), ob = fdt_next_node(b, ob, NULL)) {
+		if (strcmp(fdt_get_name(a, oa, NULL), fdt_get_name(b, ob, NULL)))
+			return false;
+		count = 0;
+		for (pa = fdt_first_property_offset(a, oa); pa >= 0;
+		     pa = fdt_next_property_offset(a, pa)) {
+			va = fdt_getprop_by_offset(a, pa, &name, &la);
+			vb = fdt_getprop(b, ob, name, &lb);
+			if (!vb || la != lb || memcmp(va, vb, la))
+				return false;
+			count++;
+		}
+		for (pb = fdt_first_property_offset(b, ob); pb >= 0;
+		     pb = fdt_next_property_offset(b, pb))
+			count--;
+		if (count)
+			return false;
+	}
+
+	return oa == ob;
+}
+
+/* Set up two copies of the base tree, for a batch and for plain calls */
+static int open_copies(int batch_size)
+{
+	int err;
+
+	err = fdt_open_into(base_fdt, batch_fdt, batch_size);
+	if (!err)
+		err = fdt_open_into(base_fdt, plain_fdt, TEST_FDT_SIZE);
+
+	return err;
+}
+
+static int node(void *fdt, const char *path)
+{
+	return fdt_path_offset(fdt, path);
+}
+
+static int test_replace_same_size(void)
+{
+	struct fdt_batch batch;
+	fdt32_t val = cpu_to_fdt32(2);
+	int ret = 0;
+
+	errcheck(!open_copies(TEST_FDT_SIZE));
+	memcpy(copy_fdt, batch_fdt, TEST_FDT_SIZE);
+	errcheck(!fdt_batch_init(&batch, batch_fdt));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/a"), "y", &val,
+				    sizeof(val)));
+	errcheck(!fdt_batch_apply(&batch));
+	errcheck(!fdt_setprop_u32(plain_fdt, node(plain_fdt, "/a"), "y", 2));
+	errcheck(same_fdt(batch_fdt, plain_fdt));
+
+	/* Nothing but the value moves */
+	errcheck(fdt_size_dt_struct(batch_fdt) == fdt_size_dt_struct(copy_fdt));
+	errcheck(fdt_off_dt_strings(batch_fdt) == fdt_off_dt_strings(copy_fdt));
+	errcheck(fdt_getprop(batch_fdt, node(batch_fdt, "/a"), "y", NULL) ==
+		 fdt_getprop(copy_fdt, node(copy_fdt, "/a"), "y", NULL) -
+		 (void *)copy_fdt + (void *)batch_fdt);
+
+out:
+	return ret;
+}
+
+static int test_grow_and_shrink(void)
+{
+	static const char args[] = "console=ttyS0,115200 root=/dev/mmcblk0p2";
+	struct fdt_batch batch;
+	int ret = 0;
+
+	errcheck(!open_copies(TEST_FDT_SIZE));
+	errcheck(!fdt_batch_init(&batch, batch_fdt));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/chosen"),
+				    "bootargs", args, sizeof(args)));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/a"), "x", "s",
+				    2));
+	errcheck(!fdt_batch_apply(&batch));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/chosen"),
+				     "bootargs", args));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/a"), "x",
+				     "s"));
+	errcheck(same_fdt(batch_fdt, plain_fdt));
+
+out:
+	return ret;
+}
+
+static int test_new_names(void)
+{
+	struct fdt_batch batch;
+	int ret = 0;
+	int b;
+
+	errcheck(!open_copies(TEST_FDT_SIZE));
+	errcheck(!fdt_batch_init(&batch, batch_fdt));
+	b = node(batch_fdt, "/b");
+	/* A name already in the strings block, a new one, and a repeat */
+	errcheck(!fdt_batch_setprop(&batch, b, "x", "1", 2));
+	errcheck(!fdt_batch_setprop(&batch, b, "new-name", "2", 2));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/a"),
+				    "new-name", "3", 2));
+	errcheck(!fdt_batch_setprop(&batch, b, "other-name", "", 0));
+	/* A later change to the same property wins */
+	errcheck(!fdt_batch_setprop(&batch, b, "x", "4", 2));
+	errcheck(!fdt_batch_apply(&batch));
+
+	/* Each change here can move /b */
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/b"), "x",
+				     "4"));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/b"),
+				     "new-name", "2"));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/a"),
+				     "new-name", "3"));
+	errcheck(!fdt_setprop(plain_fdt, node(plain_fdt, "/b"), "other-name",
+			      "", 0));
+	errcheck(same_fdt(batch_fdt, plain_fdt));
+
+out:
+	return ret;
+}
+
+static int test_mem_rsv(void)
+{
+	struct fdt_batch batch;
+	int ret = 0;
+
+	errcheck(!open_copies(TEST_FDT_SIZE));
+	errcheck(!fdt_batch_init(&batch, batch_fdt));
+	errcheck(!fdt_batch_del_mem_rsv(&batch, 0));
+	errcheck(!fdt_batch_add_mem_rsv(&batch, 0x3000, 0x10));
+	errcheck(!fdt_batch_add_mem_rsv(&batch, 0x4000, 0x20));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/b"), "z", "5",
+				    2));
+	errcheck(fdt_batch_del_mem_rsv(&batch, 2) == -FDT_ERR_NOTFOUND);
+	errcheck(!fdt_batch_apply(&batch));
+
+	errcheck(!fdt_del_mem_rsv(plain_fdt, 0));
+	errcheck(!fdt_add_mem_rsv(plain_fdt, 0x3000, 0x10));
+	errcheck(!fdt_add_mem_rsv(plain_fdt, 0x4000, 0x20));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/b"), "z",
+				     "5"));
+	errcheck(same_fdt(batch_fdt, plain_fdt));
+	errcheck(!has_mem_rsv(batch_fdt, 0x1000, 0x100));
+
+out:
+	return ret;
+}
+
+static int test_nospace(void)
+{
+	static const char args[] =
+		"console=ttyS0,115200 root=/dev/mmcblk0p2 rootwait rw init=/sbin/init";
+	struct fdt_batch batch;
+	int ret = 0;
+	int size;
+
+	/* Room for the tree and a few bytes more */
+	size = fdt_totalsize(base_fdt) + 8;
+	errcheck(!open_copies(size));
+	memcpy(copy_fdt, batch_fdt, size);
+	errcheck(!fdt_batch_init(&batch, batch_fdt));
+	errcheck(!fdt_batch_del_mem_rsv(&batch, 1));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/a"), "x", "s",
+				    2));
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/chosen"),
+				    "bootargs", args, sizeof(args)));
+	errcheck(fdt_batch_apply(&batch) == -FDT_ERR_NOSPACE);
+	errcheck(!memcmp(copy_fdt, batch_fdt, size));
+
+	/* The batch is empty again and can be reused */
+	errcheck(!fdt_batch_setprop(&batch, node(batch_fdt, "/a"), "x", "s",
+				    2));
+	errcheck(!fdt_batch_apply(&batch));
+	errcheck(!fdt_setprop_string(plain_fdt, node(plain_fdt, "/a"), "x",
+				     "s"));
+	errcheck(same_fdt(batch_fdt, plain_fdt));
+
+out:
+	return ret;
+}
+
+static int do_ut_fdt_batch(cmd_tbl_t *cmdtp, int flag, int argc,
+			   char * const argv[])
+{
+	int err = 0;
+
+	if (make_base_fdt()) {
+		printf("Cannot create test tree\n");
+		return CMD_RET_FAILURE;
+	}
+
+	err += test_replace_same_size();
+	err += test_grow_and_shrink();
+	err += test_new_names();
+	err += test_mem_rsv();
+	err += test_nospace();
+
+	printf("ut_fdt_batch %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_fdt_batch,	1,	1,	do_ut_fdt_batch,
+	"Test batched device tree changes", ""
+);
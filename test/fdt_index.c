@@ -0,0 +1,223 @@
+/*
+ * Tests for the device tree lookup index
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fdt_index.h>
+#include <libfdt.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define TEST_FDT_SIZE	4096
+
+static char indexed_fdt[TEST_FDT_SIZE];
+static char plain_fdt[TEST_FDT_SIZE];
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s (line %d)\n", #statement, __LINE__); \
+	ret = 1; \
+	goto out; \
+}
+
+static const char *const test_compat[] = {
+	"vendor,bus", "vendor,dev", "simple-bus", "vendor,other",
+	"vendor,absent",
+};
+
+static const char *const test_names[] = {
+	"bus", "bus@1000", "bus@2000", "dev", "dev@0", "dev@1", "dev@10",
+	"child", "leaf", "absent", "absent@1", "",
+};
+
+static const char *const test_paths[] = {
+	"/", "/bus@1000", "/bus@2000/dev@1", "/bus@1000/dev@0/child",
+	"/bus@1000/dev@0/child/leaf", "/bus", "/bus@1000/dev", "/absent",
+	"/bus@1000/absent", "/bus@1000/", "dev", "serial", "serial/child",
+	"missing",
+};
+
+static int begin_node(void *fdt, const char *name, uint32_t phandle,
+		      const char *compat, int compat_len)
+{
+	int err;
+
+	err = fdt_begin_node(fdt, name);
+	if (!err && phandle)
+		err = fdt_property_u32(fdt, "phandle", phandle);
+	if (!err && compat)
+		err = fdt_property(fdt, "compatible", compat, compat_len);
+
+	return err;
+}
+
+/* Build a tree with repeated names, unit addresses and compatibles */
+static int make_fdt(void *fdt)
+{
+	static const char bus_compat[] = "vendor,bus\0simple-bus";
+	static const char dev_compat[] = "vendor,dev";
+	static const char other_compat[] = "vendor,other\0vendor,dev";
+	int err = 0;
+
+	err |= fdt_create(fdt, TEST_FDT_SIZE);
+	err |= fdt_finish_reservemap(fdt);
+	err |= begin_node(fdt, "", 0, NULL, 0);
+	err |= fdt_begin_node(fdt, "aliases");
+	err |= fdt_property_string(fdt, "serial", "/bus@1000/dev@0");
+	err |= fdt_end_node(fdt);
+	err |= begin_node(fdt, "bus@1000", 1, bus_compat, sizeof(bus_compat));
+	err |= begin_node(fdt, "dev@0", 2, dev_compat, sizeof(dev_compat));
+	err |= begin_node(fdt, "child", 3, NULL, 0);
+	err |= begin_node(fdt, "leaf", 0, dev_compat, sizeof(dev_compat));
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= begin_node(fdt, "dev@1", 4, other_compat, sizeof(other_compat));
+	err |= fdt_end_node(fdt);
+	err |= begin_node(fdt, "dev", 0, dev_compat, sizeof(dev_compat));
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= begin_node(fdt, "bus@2000", 0x10, bus_compat,
+			  sizeof(bus_compat));
+	err |= begin_node(fdt, "dev@1", 0, dev_compat, sizeof(dev_compat));
+	err |= fdt_end_node(fdt);
+	err |= begin_node(fdt, "dev@10", 0xffffffff, NULL, 0);
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= fdt_end_node(fdt);
+	err |= fdt_finish(fdt);
+
+	return err;
+}
+
+/* Compare lookups in a tree with an index and in a copy without one */
+static int test_lookups(void)
+{
+	const char *name;
+	uint32_t phandle;
+	int parent, node, found;
+	int a, b;
+	int ret = 0;
+	int i;
+
+	errcheck(fdt_index_get(indexed_fdt));
+	errcheck(!fdt_index_get(plain_fdt));
+
+	for (i = 0; i < ARRAY_SIZE(test_paths); i++) {
+		a = fdt_path_offset(indexed_fdt, test_paths[i]);
+		b = fdt_path_offset(plain_fdt, test_paths[i]);
+		errcheck(a == b);
+	}
+
+	/* Every node with every name, then with the name of each node */
+	found = 0;
+	for (parent = 0; parent >= 0;
+	     parent = fdt_next_node(plain_fdt, parent, NULL)) {
+		for (i = 0; i < ARRAY_SIZE(test_names); i++) {
+			a = fdt_subnode_offset(indexed_fdt, parent,
+					       test_names[i]);
+			b = fdt_subnode_offset(plain_fdt, parent,
+					       test_names[i]);
+			errcheck(a == b);
+			found += a >= 0;
+		}
+		for (node = 0; node >= 0;
+		     node = fdt_next_node(plain_fdt, node, NULL)) {
+			name = fdt_get_name(plain_fdt, node, NULL);
+			a = fdt_subnode_offset(indexed_fdt, parent, name);
+			b = fdt_subnode_offset(plain_fdt, parent, name);
+			errcheck(a == b);
+		}
+	}
+	/* Make sure that the names above found something */
+	errcheck(found > 5);
+
+	/* Offsets that are not nodes, for the walk to deal with */
+	for (i = -1; i < 16; i++) {
+		a = fdt_subnode_offset(indexed_fdt, i, "dev@0");
+		b = fdt_subnode_offset(plain_fdt, i, "dev@0");
+		errcheck(a == b);
+	}
+
+	for (phandle = 0; phandle <= 0x11; phandle++) {
+		a = fdt_node_offset_by_phandle(indexed_fdt, phandle);
+		b = fdt_node_offset_by_phandle(plain_fdt, phandle);
+		errcheck(a == b);
+	}
+	a = fdt_node_offset_by_phandle(indexed_fdt, 0xffffffff);
+	b = fdt_node_offset_by_phandle(plain_fdt, 0xffffffff);
+	errcheck(a == b);
+
+	for (i = 0; i < ARRAY_SIZE(test_compat); i++) {
+		a = b = -1;
+		do {
+			a = fdt_node_offset_by_compatible(indexed_fdt, a,
+							  test_compat[i]);
+			b = fdt_node_offset_by_compatible(plain_fdt, b,
+							  test_compat[i]);
+			errcheck(a == b);
+		} while (a >= 0);
+	}
+
+out:
+	return ret;
+}
+
+/* Check that changing the tree drops the index */
+static int test_invalidate(void)
+{
+	int ret = 0;
+
+	errcheck(!fdt_open_into(indexed_fdt, indexed_fdt, TEST_FDT_SIZE));
+	errcheck(!fdt_index_build(indexed_fdt));
+	errcheck(fdt_index_get(indexed_fdt));
+	errcheck(!fdt_setprop_u32(indexed_fdt, 0, "new", 1));
+	errcheck(!fdt_index_get(indexed_fdt));
+
+	errcheck(!fdt_index_build(indexed_fdt));
+	errcheck(fdt_index_get(indexed_fdt));
+	errcheck(!fdt_nop_node(indexed_fdt,
+			       fdt_path_offset(indexed_fdt, "/bus@2000")));
+	errcheck(!fdt_index_get(indexed_fdt));
+	errcheck(fdt_path_offset(indexed_fdt, "/bus@2000") ==
+		 -FDT_ERR_NOTFOUND);
+
+	errcheck(!fdt_index_build(indexed_fdt));
+	errcheck(fdt_index_get(indexed_fdt));
+	errcheck(!fdt_open_into(indexed_fdt, indexed_fdt, TEST_FDT_SIZE));
+	errcheck(!fdt_index_get(indexed_fdt));
+
+out:
+	return ret;
+}
+
+static int do_ut_fdt_index(cmd_tbl_t *cmdtp, int flag, int argc,
+			   char * const argv[])
+{
+	bool had_index = fdt_index_get(gd->fdt_blob) != NULL;
+	int err = 0;
+
+	if (make_fdt(indexed_fdt) || make_fdt(plain_fdt) ||
+	    fdt_index_build(indexed_fdt)) {
+		printf("Cannot create test tree\n");
+		return CMD_RET_FAILURE;
+	}
+
+	err += test_lookups();
+	err += test_invalidate();
+
+	/* Only one tree is indexed at a time, so put back the old one */
+	if (had_index)
+		fdt_index_build(gd->fdt_blob);
+
+	printf("ut_fdt_index %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_fdt_index,	1,	1,	do_ut_fdt_index,
+	"Test the device tree lookup index", ""
+);
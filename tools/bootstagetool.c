@@ -0,0 +1,265 @@
+/*
+ * Convert stashed U-Boot bootstage data into Chrome trace format
+ *
+ * Get the data with "bootstage stash" and save that memory to a file.
+ * The output can be loaded into chrome://tracing or a similar viewer:
+ * marks become instant events and spans become complete events, nested
+ * as they were recorded. Accumulated times are listed under "otherData".
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <compiler.h>
+#include <bootstage.h>
+
+struct sym {
+	unsigned long addr;
+	char *name;
+};
+
+static struct sym *syms;
+static int sym_count;
+static int swap;	/* data is in the other byte order */
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: bootstagetool [-m <map>] [-o <out>] <stash>\n"
+		"\n"
+		"Options:\n"
+		"   -m <map>\tSystem.map file to name code addresses\n"
+		"   -o <out>\tOutput file (default: standard output)\n");
+	exit(EXIT_FAILURE);
+}
+
+static uint32_t get32(uint32_t val)
+{
+	return swap ? __builtin_bswap32(val) : val;
+}
+
+static uint64_t get64(uint64_t val)
+{
+	return swap ? __builtin_bswap64(val) : val;
+}
+
+static int read_system_map(const char *fname)
+{
+	char line[500], name[500], type;
+	unsigned long addr;
+	FILE *fin;
+
+	fin = fopen(fname, "r");
+	if (!fin) {
+		fprintf(stderr, "Cannot open '%s': %s\n", fname,
+			strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fin)) {
+		if (sscanf(line, "%lx %c %499s", &addr, &type, name) != 3)
+			continue;
+		if (type != 'T' && type != 't')
+			continue;
+
+		syms = realloc(syms, (sym_count + 1) * sizeof(*syms));
+		if (!syms) {
+			fprintf(stderr, "Out of memory\n");
+			fclose(fin);
+			return -1;
+		}
+		syms[sym_count].addr = addr;
+		syms[sym_count].name = strdup(name);
+		sym_count++;
+	}
+	fclose(fin);
+
+	return 0;
+}
+
+static const char *lookup(unsigned long addr)
+{
+	int i;
+
+	for (i = 0; i < sym_count; i++) {
+		if (syms[i].addr == addr)
+			return syms[i].name;
+	}
+
+	return NULL;
+}
+
+/* Write a string as a JSON string */
+static void put_string(FILE *fout, const char *str)
+{
+	fputc('"', fout);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(fout, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			fprintf(fout, "\\u%04x", *str);
+		else
+			fputc(*str, fout);
+	}
+	fputc('"', fout);
+}
+
+static int write_trace(FILE *fout, const char *data, size_t size)
+{
+	const struct bootstage_hdr *hdr = (const void *)data;
+	const struct bootstage_stash_rec *srec;
+	const char *str, *name, *group, *end = data + size;
+	uint32_t count, flags, i;
+	uint64_t addr;
+	int first;
+
+	if (size < sizeof(*hdr))
+		goto bad;
+	if (hdr->magic != BOOTSTAGE_MAGIC) {
+		swap = 1;
+		if (get32(hdr->magic) != BOOTSTAGE_MAGIC)
+			goto bad;
+	}
+	if (get32(hdr->version) != BOOTSTAGE_VERSION) {
+		fprintf(stderr, "Bootstage data version %#x unrecognised\n",
+			get32(hdr->version));
+		return -1;
+	}
+
+	count = get32(hdr->count);
+	if (get32(hdr->size) > size ||
+	    count * sizeof(*srec) > size - sizeof(*hdr))
+		goto bad;
+	end = data + get32(hdr->size);
+
+	fprintf(fout, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+	srec = (const void *)(hdr + 1);
+	str = (const char *)(srec + count);
+	for (i = 0, first = 1; i < count; i++, srec++) {
+		name = str;
+		str += strnlen(str, end - str) + 1;
+		group = str;
+		str += strnlen(str, end - str) + 1;
+		if (str > end)
+			goto bad;
+
+		flags = get32(srec->flags);
+		addr = get64(srec->addr);
+		if (addr && lookup(addr))
+			name = lookup(addr);
+
+		/* Accumulated times have no place in time */
+		if (!(flags & BOOTSTAGEF_SPAN) && get32(srec->start_us))
+			continue;
+
+		fprintf(fout, "%s\n  {\"name\": ", first ? "" : ",");
+		put_string(fout, name);
+		fprintf(fout, ", \"cat\": ");
+		put_string(fout, *group ? group : "bootstage");
+		if (flags & BOOTSTAGEF_SPAN) {
+			fprintf(fout, ", \"ph\": \"X\", \"ts\": %u, \"dur\": %u",
+				get32(srec->start_us), get32(srec->time_us) -
+				get32(srec->start_us));
+		} else {
+			fprintf(fout, ", \"ph\": \"i\", \"s\": \"g\", \"ts\": %u",
+				get32(srec->time_us));
+		}
+		fprintf(fout, ", \"pid\": 0, \"tid\": 0}");
+		first = 0;
+	}
+
+	fprintf(fout, "\n], \"otherData\": {");
+	srec = (const void *)(hdr + 1);
+	str = (const char *)(srec + count);
+	for (i = 0, first = 1; i < count; i++, srec++) {
+		name = str;
+		str += strlen(str) + 1;
+		str += strlen(str) + 1;
+
+		flags = get32(srec->flags);
+		if ((flags & BOOTSTAGEF_SPAN) || !get32(srec->start_us))
+			continue;
+
+		fprintf(fout, "%s\n  ", first ? "" : ",");
+		put_string(fout, name);
+		fprintf(fout, ": %u", get32(srec->time_us));
+		first = 0;
+	}
+	fprintf(fout, "\n}}\n");
+
+	return 0;
+
+bad:
+	fprintf(stderr, "No valid bootstage data found\n");
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *map_fname = NULL;
+	const char *out_fname = NULL;
+	FILE *fin, *fout = stdout;
+	char *data = NULL;
+	size_t size = 0;
+	size_t n;
+	int ret, opt;
+
+	while ((opt = getopt(argc, argv, "m:o:")) != -1) {
+		switch (opt) {
+		case 'm':
+			map_fname = optarg;
+			break;
+
+		case 'o':
+			out_fname = optarg;
+			break;
+
+		default:
+			usage();
+		}
+	}
+	argc -= optind; argv += optind;
+	if (argc != 1)
+		usage();
+
+	if (map_fname && read_system_map(map_fname))
+		return EXIT_FAILURE;
+
+	fin = fopen(argv[0], "rb");
+	if (!fin) {
+		fprintf(stderr, "Cannot open '%s': %s\n", argv[0],
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+	do {
+		data = realloc(data, size + 4096);
+		if (!data) {
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+		n = fread(data + size, 1, 4096, fin);
+		size += n;
+	} while (n == 4096);
+	fclose(fin);
+
+	if (out_fname) {
+		fout = fopen(out_fname, "w");
+		if (!fout) {
+			fprintf(stderr, "Cannot open '%s': %s\n", out_fname,
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	ret = write_trace(fout, data, size);
+	if (fout != stdout)
+		fclose(fout);
+	free(data);
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -55,6 +55,8 @@ struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+uint32_t *sample_list;	/* depth, then that many offsets, innermost first */
+int sample_count;
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -85,6 +87,7 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-flamegraph\tDump out samples as folded stacks\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
@@ -202,6 +205,9 @@ static struct func_info *find_caller_by_offset(uint32_t offset)
 			return &func_list[mid];
 	}
 
+	if (high > low && h_cmp_offset(&key, &func_list[high]) >= 0)
+		return &func_list[high];
+
 	return low >= 0 ? &func_list[low] : NULL;
 }
 
@@ -226,6 +232,40 @@ static int read_calls(FILE *fin, int count)
 	return 0;
 }
 
+static int read_samples(FILE *fin, int count)
+{
+	size_t used = 0, alloced = 0;
+	uint32_t depth;
+	int i;
+
+	notice("sample count: %d\n", count);
+	for (i = 0; i < count; i++) {
+		if (read_data(fin, &depth, sizeof(depth)))
+			return 1;
+		if (!depth) {
+			error("Invalid sample %d\n", i);
+			return 1;
+		}
+		if (used + 1 + depth > alloced) {
+			alloced += 1 + depth + 4096;
+			sample_list = realloc(sample_list,
+					      alloced * sizeof(uint32_t));
+			if (!sample_list) {
+				error("Cannot allocate sample_list\n");
+				return -1;
+			}
+		}
+		sample_list[used] = depth;
+		if (read_data(fin, sample_list + used + 1,
+			      depth * sizeof(uint32_t)))
+			return 1;
+		used += 1 + depth;
+	}
+	sample_count = count;
+
+	return 0;
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
 	struct trace_output_hdr hdr;
@@ -249,6 +289,11 @@ static int read_profile(FILE *fin, int *not_found)
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -531,6 +576,73 @@ static int make_ftrace(void)
 	return 0;
 }
 
+static int h_cmp_string(const void *v1, const void *v2)
+{
+	return strcmp(*(char * const *)v1, *(char * const *)v2);
+}
+
+/*
+ * Folded stacks, as taken by flamegraph.pl and similar tools:
+ *
+ * board_init_r;run_main_loop;do_bootm;memmove 12
+ */
+static int make_flamegraph(void)
+{
+	struct func_info *func;
+	char **stacks, *str;
+	uint32_t *sample;
+	size_t len;
+	int i, j, run;
+
+	stacks = calloc(sample_count, sizeof(*stacks));
+	if (!stacks) {
+		error("Cannot allocate stacks\n");
+		return -1;
+	}
+
+	for (i = 0, sample = sample_list; i < sample_count;
+	     i++, sample += 1 + *sample) {
+		len = 0;
+		str = NULL;
+		for (j = *sample; j > 0; j--) {
+			char name[40];
+			const char *fname;
+
+			func = find_caller_by_offset(sample[j]);
+			if (func) {
+				fname = func->name;
+			} else {
+				snprintf(name, sizeof(name), "%lx",
+					 text_offset + sample[j]);
+				fname = name;
+			}
+			str = realloc(str, len + strlen(fname) + 2);
+			if (!str) {
+				error("Cannot allocate stack\n");
+				return -1;
+			}
+			len += sprintf(str + len, "%s%s", len ? ";" : "",
+				       fname);
+		}
+		stacks[i] = str;
+	}
+
+	qsort(stacks, sample_count, sizeof(*stacks), h_cmp_string);
+	for (i = 0; i < sample_count; i += run) {
+		for (run = 1; i + run < sample_count; run++) {
+			if (strcmp(stacks[i], stacks[i + run]))
+				break;
+		}
+		printf("%s %d\n", stacks[i], run);
+	}
+
+	for (i = 0; i < sample_count; i++)
+		free(stacks[i]);
+	free(stacks);
+
+	return 0;
+}
+
 static int prof_tool(int argc, char * const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
@@ -551,6 +663,8 @@ static int prof_tool(int argc, char * const argv[],
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (0 == strcmp(cmd, "dump-flamegraph"))
+			err = make_flamegraph();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}